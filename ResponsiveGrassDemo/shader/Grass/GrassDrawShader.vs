@@ -20,6 +20,10 @@ out vec4 vV2;
 out vec4 vDebug;
 out vec3 vBladeDir;
 out vec3 vBladeUp;
+flat out uint vShape; //0 uses the shape of the patch, otherwise BladeShape + 1
+
+//Whole turns in the direction angle, the first two belong to blades without an own shape
+const float bladeShapeTurn = 6.28318530717958f;
 
 void main()
 {
@@ -42,6 +46,9 @@ void main()
 	vDebug = debug;
 
 	float dir = position.w;
+	uint turns = uint(max(dir, 0.0f) / bladeShapeTurn);
+	vShape = (turns >= 2) ? turns - 1 : 0;
+
 	float sd = sin(dir);
 	float cd = cos(dir);
 	vec3 tmp = normalize(vec3(sd, sd + cd, cd));
@@ -0,0 +1,61 @@
+/**
+ * (c) Klemens Jahrmann
+ * klemens.jahrmann@net1220.at
+ */
+
+#version 430
+
+layout(std430, binding=POSITION_LOCATION) buffer grassPos { //xyz ground + dirAlpha
+    vec4 p[];
+};
+
+layout(std430, binding=V1_LOCATION) buffer grassV1 { //xyz v1 + height
+    vec4 bv1[];
+};
+
+layout(std430, binding=V2_LOCATION) buffer grassV2 { //xyz v2 + width
+    vec4 bv2[];
+};
+
+layout(std430, binding=ATTR_LOCATION) buffer grassAttr { //xyz bladeUp + bend
+    vec4 attr[];
+};
+
+layout(std430, binding=ANCHOR_LOCATION) readonly buffer grassAnchor { //xyz barycentric + face index bits
+    vec4 anchor[];
+};
+
+layout(std430, binding=FACE_LOCATION) readonly buffer faceData { //per face: 3 positions, 3 up directions
+    vec4 face[];
+};
+
+layout(local_size_x=MAX_WORK_GROUP_SIZE_X, local_size_y=1, local_size_z=1) in;
+
+uniform uint amountBlades;
+uniform uint amountFaces;
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x; //for grass blade
+
+    if(id < amountBlades)
+    {
+        vec3 barycentric = anchor[id].xyz;
+        uint faceIndex = floatBitsToUint(anchor[id].w);
+        if(faceIndex >= amountFaces)
+        {
+            return;
+        }
+
+        uint f = faceIndex * VEC4_PER_FACE;
+        vec3 groundPos = face[f].xyz * barycentric.x + face[f + 1].xyz * barycentric.y + face[f + 2].xyz * barycentric.z;
+        vec3 bladeUp = normalize(face[f + 3].xyz * barycentric.x + face[f + 4].xyz * barycentric.y + face[f + 5].xyz * barycentric.z);
+
+        //The force update rebuilds v1 and v2 from the ground and up vector, until then they move with the ground
+        vec3 delta = groundPos - p[id].xyz;
+        p[id].xyz = groundPos;
+        bv1[id].xyz += delta;
+        bv2[id].xyz += delta;
+        attr[id].xyz = bladeUp;
+    }
+}
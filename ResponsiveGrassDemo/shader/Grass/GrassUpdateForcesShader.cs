@@ -25,6 +25,10 @@ layout(std430, binding=DEBUG_LOCATION) buffer grassDebug {
     vec4 debug[];
 };
 
+layout(std430, binding=COLLIDER_LOCATION) readonly buffer grassCollider { //xyz center + radius, of all patches of the frame
+    vec4 sphereCollider[];
+};
+
 layout(local_size_x=MAX_WORK_GROUP_SIZE_X, local_size_y=1, local_size_z=1) in;
 
 //Pressure Map
@@ -37,7 +41,8 @@ uniform bool useHeightMap;
 uniform sampler2D heightMap;
 uniform vec4 heightMapBounds; //xMin zMin xLength zLength
 
-uniform uint amountBlades;
+uniform uint firstBlade;
+uniform uint amountBlades; //End of the dispatched blade range
 uniform float dt;
 uniform mat4 modelMatrix;
 uniform mat4 invModelMatrix;
@@ -50,7 +55,7 @@ uniform vec4 gravityVec;
 uniform vec4 gravityPoint;
 uniform float useGravityPoint;
 
-uniform vec4 sphereCollider[MAX_AMOUNT_SPHERE_COLLIDER];
+uniform uint firstSphereCollider;
 uniform uint amountSphereCollider;
 
 float invHeight;
@@ -90,7 +95,7 @@ void EnsureValidV2Pos(inout vec3 v2, in vec3 bladeUp)
 
 void main()
 {
-    uint id = gl_GlobalInvocationID.x; //for grass blade
+    uint id = firstBlade + gl_GlobalInvocationID.x; //for grass blade
 
     if(id < amountBlades)
     {
@@ -210,7 +215,7 @@ void main()
         //Collision detection
         //Collision with SphereColliders
         bool dataDirty = false;
-        for(uint colli = 0; colli < amountSphereCollider; colli++)
+        for(uint colli = firstSphereCollider; colli < firstSphereCollider + amountSphereCollider; colli++)
         {
             float r = sphereCollider[colli].w;
             vec3 cPos = sphereCollider[colli].xyz;
@@ -280,7 +285,7 @@ void main()
         //debug[id] = vec4(wtmp, wtmp, wtmp, 1.0f);
         //debug[id] = vec4(wDebug,0.0f,0.0f,1.0f);
         //debug[id] = vec4(float(dataDirty),0.0f,0.0f,1.0f);
-        //debug[id] = vec4(float(amountSphereCollider) / float(MAX_AMOUNT_SPHERE_COLLIDER),amountSphereCollider,0.0f,1.0f);
+        //debug[id] = vec4(float(firstSphereCollider),amountSphereCollider,0.0f,1.0f);
         //debug[id] = vec4(1.0f,0.0f,1.0f,1.0f);
         //debug[id] = vec4(bladeUp * 0.5f + 0.5f,1.0f);
         //debug[id] = vec4(((grav / mdt) / max(abs(grav.x), max(abs(grav.y),abs(grav.z)))) * 0.5f + 0.5f, wDebug);
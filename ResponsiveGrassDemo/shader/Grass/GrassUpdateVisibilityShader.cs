@@ -52,7 +52,8 @@ uniform sampler2DMS depthTexture;
 uniform vec2 widthHeight;
 
 //Misc
-uniform uint amountBlades;
+uniform uint firstBlade;
+uniform uint amountBlades; //End of the dispatched blade range
 uniform mat4 modelMatrix;
 uniform mat3 invTransModelMatrix;
 uniform mat4 vpMatrix;
@@ -66,14 +67,7 @@ uniform bool doOrientationCulling;
 
 void main()
 {
-    uint id = gl_GlobalInvocationID.x; //for grass blade
-
-    if(id == 0)
-    {
-        atomicExchange(indirect[0], 0);
-    }
-
-    barrier();
+    uint id = firstBlade + gl_GlobalInvocationID.x; //for grass blade, the count is reset before the dispatch
 
     if(id < amountBlades)
     {
@@ -0,0 +1,87 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "AliasTable.h"
+
+AliasTable::AliasTable() : probability(), alias(), sumWeights(0.0)
+{
+
+}
+
+AliasTable::AliasTable(const std::vector<float>& weights) : probability(), alias(), sumWeights(0.0)
+{
+	build(weights);
+}
+
+AliasTable::~AliasTable()
+{
+
+}
+
+void AliasTable::build(const std::vector<float>& weights)
+{
+	const unsigned int n = (unsigned int)weights.size();
+	probability.assign(n, 1.0f);
+	alias.resize(n);
+
+	sumWeights = 0.0;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		sumWeights += glm::max(weights[i], 0.0f);
+		alias[i] = i;
+	}
+
+	if (n == 0 || sumWeights <= 0.0)
+	{
+		return;
+	}
+
+	//Vose's method, scaled weights are kept in double to keep the table exact for millions of entries
+	std::vector<double> scaled(n);
+	std::vector<unsigned int> small;
+	std::vector<unsigned int> large;
+	small.reserve(n);
+	large.reserve(n);
+	const double scale = (double)n / sumWeights;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		scaled[i] = (double)glm::max(weights[i], 0.0f) * scale;
+		if (scaled[i] < 1.0)
+		{
+			small.push_back(i);
+		}
+		else
+		{
+			large.push_back(i);
+		}
+	}
+
+	while (!small.empty() && !large.empty())
+	{
+		unsigned int s = small.back();
+		small.pop_back();
+		unsigned int l = large.back();
+
+		probability[s] = (float)scaled[s];
+		alias[s] = l;
+
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		if (scaled[l] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	//Remaining entries are 1 up to rounding errors
+	for (unsigned int i = 0; i < large.size(); i++)
+	{
+		probability[large[i]] = 1.0f;
+	}
+	for (unsigned int i = 0; i < small.size(); i++)
+	{
+		probability[small[i]] = 1.0f;
+	}
+}
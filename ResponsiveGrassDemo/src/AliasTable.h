@@ -0,0 +1,41 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef ALIASTABLE_H
+#define ALIASTABLE_H
+
+#include <vector>
+#include "Common.h"
+
+/**
+*  Walker/Vose alias table for O(1) sampling of a discrete distribution.
+*  Built once from a list of non-negative weights (e.g. TriangleFace::area).
+*/
+class AliasTable
+{
+public:
+	AliasTable();
+	AliasTable(const std::vector<float>& weights);
+	~AliasTable();
+
+	void build(const std::vector<float>& weights);
+
+	//randomBits is a uniform 32 bit integer that selects the column, u a uniform float in [0,1) that selects between column and alias
+	inline unsigned int sample(const unsigned int randomBits, const float u) const
+	{
+		unsigned int column = (unsigned int)(((unsigned long long)randomBits * (unsigned long long)probability.size()) >> 32);
+		return (u < probability[column]) ? column : alias[column];
+	}
+
+	unsigned int size() const { return (unsigned int)probability.size(); }
+	double totalWeight() const { return sumWeights; }
+
+private:
+	std::vector<float> probability;
+	std::vector<unsigned int> alias;
+	double sumWeights;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "AttributeMap.h"
+
+#include <fstream>
+#include <iostream>
+#include "Texture2D.h"
+
+AttributeMap::AttributeMap(const unsigned int width, const unsigned int height, const std::vector<float>& values) : width(width), height(height), values(values)
+{
+	if (width == 0 || height == 0 || values.size() != width * height)
+	{
+		std::cout << "ERROR AttributeMap: Size does not match the values!" << std::endl;
+		this->width = 1;
+		this->height = 1;
+		this->values.assign(1, 1.0f);
+	}
+}
+
+AttributeMap::~AttributeMap()
+{
+
+}
+
+AttributeMap* AttributeMap::loadFromFile(const std::string& fileName, const unsigned int channel)
+{
+	std::ifstream ifile(fileName.c_str());
+	if (!ifile.good())
+	{
+		std::cout << "ERROR: Attribute map file not found. " << fileName << std::endl;
+		return 0;
+	}
+	ifile.close();
+
+	Texture2D::PNGOutput png = Texture2D::loadPNGFile(fileName, false);
+	if (png.info_ptr == 0 || png.image_data == 0)
+	{
+		std::cout << "ERROR: Attribute map could not be read. " << fileName << std::endl;
+		return 0;
+	}
+
+	unsigned int w = png.info_ptr->width;
+	unsigned int h = png.info_ptr->height;
+	unsigned int channels = png.info_ptr->channels;
+	unsigned int c = glm::min(channel, channels - 1);
+
+	std::vector<float> values(w * h);
+	for (unsigned int i = 0; i < w * h; i++)
+	{
+		values[i] = (float)png.image_data[i * channels + c] / 255.0f;
+	}
+	free(png.image_data);
+
+	return new AttributeMap(w, h, values);
+}
+
+float AttributeMap::sample(const glm::vec2& uv) const
+{
+	float x = uv.x * (float)width - 0.5f;
+	float y = uv.y * (float)height - 0.5f;
+	float fx = glm::floor(x);
+	float fy = glm::floor(y);
+	int ix = (int)fx;
+	int iy = (int)fy;
+	float tx = x - fx;
+	float ty = y - fy;
+
+	float bottom = glm::mix(texel(ix, iy), texel(ix + 1, iy), tx);
+	float top = glm::mix(texel(ix, iy + 1), texel(ix + 1, iy + 1), tx);
+	return glm::mix(bottom, top, ty);
+}
@@ -0,0 +1,46 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef ATTRIBUTEMAP_H
+#define ATTRIBUTEMAP_H
+
+#include <vector>
+#include <string>
+#include "Common.h"
+
+/**
+*  Single channel image kept on the CPU, used to drive blade generation through the UVs of the faces.
+*  Values are in [0,1], sampling is bilinear with repeat wrapping. Row 0 is v = 0, like the textures.
+*/
+class AttributeMap
+{
+public:
+	AttributeMap(const unsigned int width, const unsigned int height, const std::vector<float>& values);
+	~AttributeMap();
+
+	//Loads one channel of a png file, returns 0 if the file can not be read
+	static AttributeMap* loadFromFile(const std::string& fileName, const unsigned int channel = 0);
+
+	float sample(const glm::vec2& uv) const;
+
+	unsigned int Width() const { return width; }
+	unsigned int Height() const { return height; }
+	const float* Data() const { return values.data(); }
+
+private:
+	unsigned int width, height;
+	std::vector<float> values;
+
+	inline float texel(const int x, const int y) const
+	{
+		int wx = x % (int)width;
+		int wy = y % (int)height;
+		if (wx < 0) wx += width;
+		if (wy < 0) wy += height;
+		return values[wy * width + wx];
+	}
+};
+
+#endif
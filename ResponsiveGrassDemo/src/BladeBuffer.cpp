@@ -0,0 +1,197 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "BladeBuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+//Keeps every array aligned, BLADE_BUFFER_ALIGNMENT / sizeof(glm::vec4) blades
+#define BLADE_BUFFER_GRANULARITY (BLADE_BUFFER_ALIGNMENT / 16)
+
+glm::vec4* allocateAligned(const unsigned int amountVec4)
+{
+	size_t bytes = (size_t)amountVec4 * sizeof(glm::vec4);
+#ifdef _WIN32
+	return (glm::vec4*)_aligned_malloc(bytes, BLADE_BUFFER_ALIGNMENT);
+#else
+	void* ptr = 0;
+	if (posix_memalign(&ptr, BLADE_BUFFER_ALIGNMENT, bytes) != 0)
+	{
+		return 0;
+	}
+	return (glm::vec4*)ptr;
+#endif
+}
+
+void freeAligned(glm::vec4* ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+BladeBuffer::BladeBuffer() : memory(0), amountBlades(0), capacity(0), anchored(false)
+{
+	for (unsigned int a = 0; a <= AMOUNT_ATTRIBUTES; a++)
+	{
+		arrays[a] = 0;
+	}
+}
+
+BladeBuffer::BladeBuffer(const unsigned int capacity) : BladeBuffer()
+{
+	reserve(capacity);
+}
+
+BladeBuffer::BladeBuffer(BladeBuffer&& other) : memory(other.memory), amountBlades(other.amountBlades), capacity(other.capacity), anchored(other.anchored)
+{
+	for (unsigned int a = 0; a <= AMOUNT_ATTRIBUTES; a++)
+	{
+		arrays[a] = other.arrays[a];
+		other.arrays[a] = 0;
+	}
+	other.memory = 0;
+	other.amountBlades = 0;
+	other.capacity = 0;
+}
+
+BladeBuffer& BladeBuffer::operator=(BladeBuffer&& other)
+{
+	if (this != &other)
+	{
+		release();
+		memory = other.memory;
+		amountBlades = other.amountBlades;
+		capacity = other.capacity;
+		anchored = other.anchored;
+		for (unsigned int a = 0; a <= AMOUNT_ATTRIBUTES; a++)
+		{
+			arrays[a] = other.arrays[a];
+			other.arrays[a] = 0;
+		}
+		other.memory = 0;
+		other.amountBlades = 0;
+		other.capacity = 0;
+	}
+	return *this;
+}
+
+BladeBuffer::~BladeBuffer()
+{
+	release();
+}
+
+void BladeBuffer::reserve(const unsigned int newCapacity)
+{
+	if (newCapacity <= capacity)
+	{
+		return;
+	}
+	reallocate(newCapacity, amountArrays());
+}
+
+void BladeBuffer::reallocate(const unsigned int newCapacity, const unsigned int oldArrays)
+{
+	unsigned int alignedCapacity = (newCapacity + BLADE_BUFFER_GRANULARITY - 1) / BLADE_BUFFER_GRANULARITY * BLADE_BUFFER_GRANULARITY;
+	glm::vec4* newMemory = allocateAligned(alignedCapacity * amountArrays());
+	if (newMemory == 0)
+	{
+		//Like the std::vector it replaced, callers write every blade up to the requested size, so the buffer must never come up short
+		std::cout << "ERROR BladeBuffer: Could not allocate " << alignedCapacity << " blades!" << std::endl;
+		throw std::bad_alloc();
+	}
+
+	for (unsigned int a = 0; a < amountArrays(); a++)
+	{
+		glm::vec4* newArray = newMemory + (size_t)a * alignedCapacity;
+		if (amountBlades > 0 && a < oldArrays)
+		{
+			memcpy(newArray, arrays[a], amountBlades * sizeof(glm::vec4));
+		}
+		arrays[a] = newArray;
+	}
+
+	if (memory != 0)
+	{
+		freeAligned(memory);
+	}
+	memory = newMemory;
+	capacity = alignedCapacity;
+}
+
+void BladeBuffer::enableAnchors()
+{
+	if (anchored)
+	{
+		return;
+	}
+	anchored = true;
+	if (capacity > 0)
+	{
+		reallocate(capacity, AMOUNT_ATTRIBUTES);
+	}
+}
+
+void BladeBuffer::resize(const unsigned int size)
+{
+	reserve(size);
+	amountBlades = size;
+}
+
+void BladeBuffer::release()
+{
+	if (memory != 0)
+	{
+		freeAligned(memory);
+	}
+	memory = 0;
+	for (unsigned int a = 0; a <= AMOUNT_ATTRIBUTES; a++)
+	{
+		arrays[a] = 0;
+	}
+	amountBlades = 0;
+	capacity = 0;
+}
+
+void BladeBuffer::append(const BladeBuffer& other, const unsigned int first, const unsigned int count)
+{
+	if (other.anchored)
+	{
+		enableAnchors();
+	}
+	unsigned int offset = amountBlades;
+	resize(amountBlades + count);
+	for (unsigned int a = 0; a < other.amountArrays(); a++)
+	{
+		memcpy(arrays[a] + offset, other.arrays[a] + first, count * sizeof(glm::vec4));
+	}
+}
+
+void BladeBuffer::gather(const BladeBuffer& source, const unsigned int* indices, const unsigned int count)
+{
+	if (source.anchored)
+	{
+		enableAnchors();
+	}
+	resize(count);
+	for (unsigned int a = 0; a < source.amountArrays(); a++)
+	{
+		glm::vec4* dst = arrays[a];
+		const glm::vec4* src = source.arrays[a];
+		for (unsigned int i = 0; i < count; i++)
+		{
+			dst[i] = src[indices[i]];
+		}
+	}
+}
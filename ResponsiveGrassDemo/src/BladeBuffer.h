@@ -0,0 +1,108 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef BLADEBUFFER_H
+#define BLADEBUFFER_H
+
+#include "Common.h"
+
+#define BLADE_BUFFER_ALIGNMENT 64
+
+/**
+*  Structure of arrays for the blade attributes, laid out like the GPU buffers of a GrassPatch:
+*  position (xyz, direction angle), v1 (xyz, height), v2 (xyz, width) and attr (up, bend).
+*  All four arrays live in one allocation and start on a BLADE_BUFFER_ALIGNMENT boundary.
+*  Optionally every blade also has an anchor (barycentric xyz, face index bits in w) to re-project it onto a deforming mesh.
+*  The buffer can only be moved, blade data is never copied implicitly between the generation stages.
+*/
+class BladeBuffer
+{
+public:
+	enum Attribute
+	{
+		POSITION, V1, V2, ATTR, AMOUNT_ATTRIBUTES, ANCHOR = AMOUNT_ATTRIBUTES
+	};
+
+	BladeBuffer();
+	explicit BladeBuffer(const unsigned int capacity);
+	BladeBuffer(BladeBuffer&& other);
+	BladeBuffer& operator=(BladeBuffer&& other);
+	~BladeBuffer();
+
+	BladeBuffer(const BladeBuffer&) = delete;
+	BladeBuffer& operator=(const BladeBuffer&) = delete;
+
+	//Throws std::bad_alloc if the memory can not be allocated, the buffer is unchanged then
+	void reserve(const unsigned int capacity);
+	//New blades are uninitialized
+	void resize(const unsigned int size);
+	void clear() { amountBlades = 0; }
+	//Releases the memory, the buffer keeps its anchors setting
+	void release();
+
+	//Adds the anchor array, existing blades get uninitialized anchors
+	void enableAnchors();
+	bool hasAnchors() const { return anchored; }
+
+	inline void push_back(const glm::vec4& position, const glm::vec4& v1, const glm::vec4& v2, const glm::vec4& attr)
+	{
+		if (amountBlades == capacity)
+		{
+			reserve(glm::max(capacity * 2, 64u));
+		}
+		set(amountBlades++, position, v1, v2, attr);
+	}
+
+	inline void set(const unsigned int i, const glm::vec4& position, const glm::vec4& v1, const glm::vec4& v2, const glm::vec4& attr)
+	{
+		arrays[POSITION][i] = position;
+		arrays[V1][i] = v1;
+		arrays[V2][i] = v2;
+		arrays[ATTR][i] = attr;
+	}
+
+	inline void setAnchor(const unsigned int i, const unsigned int faceIndex, const glm::vec3& barycentric)
+	{
+		arrays[ANCHOR][i] = glm::vec4(barycentric, glm::uintBitsToFloat(faceIndex));
+	}
+
+	static inline unsigned int anchorFace(const glm::vec4& anchor) { return glm::floatBitsToUint(anchor.w); }
+
+	//Appends blades [first, first + count) of other
+	void append(const BladeBuffer& other, const unsigned int first, const unsigned int count);
+
+	//Replaces the content with source[indices[i]] for i in [0, count)
+	void gather(const BladeBuffer& source, const unsigned int* indices, const unsigned int count);
+
+	unsigned int size() const { return amountBlades; }
+	bool empty() const { return amountBlades == 0; }
+
+	glm::vec4* data(const Attribute a) { return arrays[a]; }
+	const glm::vec4* data(const Attribute a) const { return arrays[a]; }
+
+	glm::vec4* position() { return arrays[POSITION]; }
+	glm::vec4* v1() { return arrays[V1]; }
+	glm::vec4* v2() { return arrays[V2]; }
+	glm::vec4* attr() { return arrays[ATTR]; }
+	const glm::vec4* position() const { return arrays[POSITION]; }
+	const glm::vec4* v1() const { return arrays[V1]; }
+	const glm::vec4* v2() const { return arrays[V2]; }
+	const glm::vec4* attr() const { return arrays[ATTR]; }
+	//0 without anchors
+	glm::vec4* anchor() { return arrays[ANCHOR]; }
+	const glm::vec4* anchor() const { return arrays[ANCHOR]; }
+
+private:
+	glm::vec4* memory;
+	glm::vec4* arrays[AMOUNT_ATTRIBUTES + 1];
+	unsigned int amountBlades;
+	unsigned int capacity;
+	bool anchored;
+
+	unsigned int amountArrays() const { return AMOUNT_ATTRIBUTES + (anchored ? 1 : 0); }
+	void reallocate(const unsigned int newCapacity, const unsigned int oldArrays);
+};
+
+#endif
@@ -43,9 +43,4 @@ void fetchGLError();
 
 glm::vec3 closestPointOnTriangle(const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3, const glm::vec3& sourcePosition, float& s, float& t);
 
-inline float random()
-{
-	return ((float)rand() / (RAND_MAX));
-}
-
 #endif
\ No newline at end of file
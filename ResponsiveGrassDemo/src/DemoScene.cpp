@@ -666,6 +666,20 @@ void DemoScene::key_callback(GLFWwindow* window, int key, int scancode, int acti
 	{
 		OpenGLState::Instance().toggleWireframe();
 	}
+
+	if (key == GLFW_KEY_U && action == GLFW_PRESS)
+	{
+		bool cpu = false;
+		for (unsigned int i = 0; i < grassFields.size(); i++)
+		{
+			cpu = cpu || grassFields[i]->usesCpuForces();
+		}
+		for (unsigned int i = 0; i < grassFields.size(); i++)
+		{
+			grassFields[i]->setCpuForces(!cpu);
+		}
+		std::cout << "Grass forces are now simulated on the " << (cpu ? "GPU" : "CPU (" + toString(DetectForceIsa()) + ")") << std::endl;
+	}
 }
 
 void DemoScene::loadScene(unsigned int id)
@@ -0,0 +1,137 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "FaceExtractor.h"
+
+#include <algorithm>
+#include "Parallel.h"
+
+struct ExtractionNode
+{
+	const AssimpImporter::ImportModel* model;
+	glm::mat4 matrix;
+	glm::mat3 normalMatrix;
+};
+
+//Calls func(node, localIndex) for every index in [begin, end), offsets holds the first index of every node and the total count
+template<typename Func>
+inline void forEachInNodes(const std::vector<unsigned int>& offsets, const unsigned int begin, const unsigned int end, const Func& func)
+{
+	unsigned int n = (unsigned int)(std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin()) - 1;
+	for (unsigned int i = begin; i < end; i++)
+	{
+		while (i >= offsets[n + 1])
+		{
+			n++;
+		}
+		func(n, i - offsets[n]);
+	}
+}
+
+void FaceExtractor::extract(const AssimpImporter::ImportModel* model, const Params& params, std::vector<Geometry::TriangleFace>& faces, glm::vec3& min, glm::vec3& max)
+{
+	min = glm::vec3(FLT_MAX);
+	max = glm::vec3(-FLT_MAX);
+	if (model == 0)
+	{
+		return;
+	}
+
+	//Flatten the hierarchy, only nodes with triangles are kept
+	std::vector<ExtractionNode> nodes;
+	std::vector<unsigned int> vertexOffsets(1, 0);
+	std::vector<unsigned int> faceOffsets(1, 0);
+	std::vector<const AssimpImporter::ImportModel*> models;
+	std::vector<glm::mat4> modelMatrices;
+	models.push_back(model);
+	modelMatrices.push_back(params.rootMatrix);
+	for (unsigned int i = 0; i < models.size(); i++)
+	{
+		const AssimpImporter::ImportModel* m = models[i];
+		if (m->position.size() > 0 && m->index.size() >= 3)
+		{
+			ExtractionNode node;
+			node.model = m;
+			node.matrix = modelMatrices[i];
+			node.normalMatrix = params.transformNormals ? glm::inverse(glm::transpose(glm::mat3(node.matrix))) : glm::mat3(1.0f);
+			nodes.push_back(node);
+			vertexOffsets.push_back(vertexOffsets.back() + (unsigned int)m->position.size());
+			faceOffsets.push_back(faceOffsets.back() + (unsigned int)m->index.size() / 3);
+		}
+
+		for (unsigned int c = 0; c < m->children.size(); c++)
+		{
+			models.push_back(m->children[c]);
+			modelMatrices.push_back(m->children[c]->transform * modelMatrices[i]);
+		}
+	}
+
+	const unsigned int amountVertices = vertexOffsets.back();
+	const unsigned int amountFaces = faceOffsets.back();
+	if (amountFaces == 0)
+	{
+		return;
+	}
+
+	//Every vertex is transformed once, shared vertices are only gathered by the faces
+	std::vector<glm::vec3> positions(amountVertices);
+	std::vector<glm::vec3> normals(amountVertices);
+	std::vector<glm::vec3> tangents(amountVertices);
+	std::vector<glm::vec3> bitangents(amountVertices);
+	parallelFor(amountVertices, FACE_EXTRACTION_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		forEachInNodes(vertexOffsets, begin, end, [&](const unsigned int n, const unsigned int v)
+		{
+			const ExtractionNode& node = nodes[n];
+			const AssimpImporter::ImportModel* m = node.model;
+			const unsigned int i = vertexOffsets[n] + v;
+
+			positions[i] = glm::vec3(node.matrix * glm::vec4(m->position[v] * params.scale, 1.0f));
+			normals[i] = node.normalMatrix * m->normal[v];
+			tangents[i] = (m->tangent.size() > 0) ? node.normalMatrix * m->tangent[v] : glm::vec3(1.0f, 0.0f, 0.0f);
+			bitangents[i] = (m->bitangent.size() > 0) ? node.normalMatrix * m->bitangent[v] : glm::normalize(glm::cross(tangents[i], normals[i]));
+		});
+	});
+
+	const unsigned int firstFace = (unsigned int)faces.size();
+	faces.resize(firstFace + amountFaces);
+
+	const unsigned int amountChunks = (amountFaces + FACE_EXTRACTION_CHUNK_SIZE - 1) / FACE_EXTRACTION_CHUNK_SIZE;
+	std::vector<glm::vec3> chunkMin(amountChunks, glm::vec3(FLT_MAX));
+	std::vector<glm::vec3> chunkMax(amountChunks, glm::vec3(-FLT_MAX));
+	parallelFor(amountFaces, FACE_EXTRACTION_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int chunk)
+	{
+		glm::vec3 cMin(FLT_MAX);
+		glm::vec3 cMax(-FLT_MAX);
+		forEachInNodes(faceOffsets, begin, end, [&](const unsigned int n, const unsigned int f)
+		{
+			const AssimpImporter::ImportModel* m = nodes[n].model;
+			Geometry::TriangleFace& face = faces[firstFace + faceOffsets[n] + f];
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				const unsigned int local = m->index[f * 3 + k];
+				const unsigned int i = vertexOffsets[n] + local;
+				Geometry::Vertex& vertex = face.vertices[k];
+				vertex.position = positions[i];
+				vertex.normal = normals[i];
+				vertex.tangent = tangents[i];
+				vertex.bitangent = bitangents[i];
+				vertex.uv = (m->uv.size() > 0) ? m->uv[local] : glm::vec2(0.0f);
+
+				cMin = glm::min(cMin, vertex.position);
+				cMax = glm::max(cMax, vertex.position);
+			}
+			face.CalculateProperties();
+		});
+		chunkMin[chunk] = cMin;
+		chunkMax[chunk] = cMax;
+	});
+
+	for (unsigned int c = 0; c < amountChunks; c++)
+	{
+		min = glm::min(min, chunkMin[c]);
+		max = glm::max(max, chunkMax[c]);
+	}
+}
@@ -0,0 +1,36 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef FACEEXTRACTOR_H
+#define FACEEXTRACTOR_H
+
+#include <vector>
+#include "Common.h"
+#include "Geometry.h"
+#include "AssimpImporter.h"
+
+#define FACE_EXTRACTION_CHUNK_SIZE 8192
+
+/**
+*  Builds the triangle faces of an imported model hierarchy on all cores.
+*  The hierarchy is flattened into a node list first. Then every vertex is transformed once into flat arrays,
+*  and the faces are gathered from these arrays in chunks, straight into the preallocated face list.
+*  The bounds of the face vertices are reduced per chunk in the same pass.
+*/
+class FaceExtractor
+{
+public:
+	struct Params
+	{
+		glm::vec3 scale = glm::vec3(1.0f); //Applied to the positions before the node matrix
+		glm::mat4 rootMatrix = glm::mat4(1.0f); //Matrix of the root node, children are transformed relative to it
+		bool transformNormals = true; //Normals, tangents and bitangents are transformed by the inverse transpose of the node matrix
+	};
+
+	//Appends the faces of all nodes in hierarchy order, min and max receive the bounds of the appended faces
+	static void extract(const AssimpImporter::ImportModel* model, const Params& params, std::vector<Geometry::TriangleFace>& faces, glm::vec3& min, glm::vec3& max);
+};
+
+#endif
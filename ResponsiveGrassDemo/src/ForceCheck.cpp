@@ -0,0 +1,338 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "ForceCheck.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+
+#define FORCE_CHECK_MAGIC "ForceCheck"
+#define FORCE_CHECK_VERSION 2
+#define FORCE_CHECK_HEIGHT_FIELD_SIZE 4
+#define FORCE_CHECK_WIND_TYPES 3 //VECTOR, POINT and POINTWITHTANGENTIAL of WindGenerator, numbered like in the force shader
+#define FORCE_CHECK_SCENARIOS (FORCE_CHECK_WIND_TYPES + 1)
+
+int ForceCheck::run(const std::vector<std::string>& args)
+{
+	std::string goldenFile = RESSOURCEPATH + "ForceCheck/ForceReference.txt";
+	std::string writeFile;
+
+	for (unsigned int i = 0; i < args.size(); i++)
+	{
+		if (i + 1 >= args.size())
+		{
+			std::cout << "ERROR ForceCheck: Missing value for " << args[i] << std::endl;
+			return 1;
+		}
+		const std::string& value = args[++i];
+		const std::string& option = args[i - 1];
+		if (option == "--golden") { goldenFile = value; }
+		else if (option == "--write") { writeFile = value; }
+		else
+		{
+			std::cout << "ERROR ForceCheck: Unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+
+	Blades start;
+	makeBlades(start);
+
+	const GrassForceIsa bestIsa = DetectForceIsa();
+	unsigned int simdMismatches[FORCE_ISA_AVX2 + 1] = { 0 };
+	float simdMaxError[FORCE_ISA_AVX2 + 1] = { 0.0f };
+
+	std::vector<Blades> results;
+	for (unsigned int s = 0; s < FORCE_CHECK_SCENARIOS; s++)
+	{
+		Scenario scenario;
+		makeScenario(s, scenario);
+
+		Blades b = start;
+		if (scenario.sleep)
+		{
+			b.awake.assign((FORCE_CHECK_BLADES + 31) / 32, 0xFFFFFFFFu);
+		}
+		for (unsigned int step = 0; step < FORCE_CHECK_STEPS; step++)
+		{
+			prepareStep(step, scenario);
+			const Blades before = b;
+			updateBlades(scenario, b, FORCE_ISA_SCALAR);
+			b.awakeHistory.insert(b.awakeHistory.end(), b.awake.begin(), b.awake.end());
+
+			for (unsigned int isa = FORCE_ISA_SSE4; isa <= (unsigned int)bestIsa; isa++)
+			{
+				Blades simd = before;
+				updateBlades(scenario, simd, (GrassForceIsa)isa);
+				compareSimd((GrassForceIsa)isa, s, step, b, simd, simdMismatches[isa], simdMaxError[isa]);
+			}
+		}
+		results.push_back(b);
+	}
+
+	bool simdPassed = true;
+	for (unsigned int isa = FORCE_ISA_SSE4; isa <= (unsigned int)bestIsa; isa++)
+	{
+		std::cout << "Force check of " << toString((GrassForceIsa)isa) << " against the reference: " << simdMismatches[isa] << " mismatches, largest error " << simdMaxError[isa] << " blade heights" << std::endl;
+		simdPassed = simdPassed && simdMismatches[isa] == 0;
+	}
+	if (bestIsa == FORCE_ISA_SCALAR)
+	{
+		std::cout << "The CPU supports no SIMD instruction set of UpdateForces, only the reference is checked." << std::endl;
+	}
+
+	if (!writeFile.empty())
+	{
+		return (writeGolden(writeFile, results) && simdPassed) ? 0 : 1;
+	}
+	return (compareGolden(goldenFile, results) && simdPassed) ? 0 : 1;
+}
+
+/**
+*  A 9 x 5 grid of blades with different heights, bends, directions and slightly tilted up vectors, at rest.
+*  Only exact arithmetic and square roots, so every compiler builds the same blades.
+*/
+void ForceCheck::makeBlades(Blades& blades)
+{
+	blades.position.resize(FORCE_CHECK_BLADES);
+	blades.v1.resize(FORCE_CHECK_BLADES);
+	blades.v2.resize(FORCE_CHECK_BLADES);
+	blades.attr.resize(FORCE_CHECK_BLADES);
+	blades.pressure.assign(FORCE_CHECK_BLADES, glm::vec4(0.0f));
+	for (unsigned int i = 0; i < FORCE_CHECK_BLADES; i++)
+	{
+		glm::vec3 pos((float)(i % 9) * 0.5f - 2.0f, 0.0f, (float)(i / 9) * 0.5f - 1.0f);
+		glm::vec3 up = glm::normalize(glm::vec3((float)((int)(i % 5) - 2) * 0.05f, 1.0f, (float)((int)(i % 3) - 1) * 0.05f));
+		float height = 0.6f + 0.05f * (float)(i % 7);
+		float bend = 0.2f + 0.1f * (float)(i % 6);
+
+		blades.position[i] = glm::vec4(pos, (float)i * 0.7f);
+		blades.v1[i] = glm::vec4(pos + up * height, height);
+		blades.v2[i] = glm::vec4(pos + up * height, 0.05f);
+		blades.attr[i] = glm::vec4(up, bend);
+	}
+}
+
+void ForceCheck::makeScenario(const unsigned int index, Scenario& scenario)
+{
+	GrassForceParams& p = scenario.params;
+	//Without wind, only calm blades fall asleep
+	scenario.sleep = index >= FORCE_CHECK_WIND_TYPES;
+	p.dt = scenario.sleep ? FORCE_CHECK_SLEEP_DT : FORCE_CHECK_DT;
+	//Rotation about y with cos 0.8 and sin 0.6, so the matrix is exact
+	p.modelMatrix = glm::mat4(glm::vec4(0.8f, 0.0f, -0.6f, 0.0f), glm::vec4(0.0f, 1.0f, 0.0f, 0.0f), glm::vec4(0.6f, 0.0f, 0.8f, 0.0f), glm::vec4(1.0f, 0.5f, -2.0f, 1.0f));
+	if (!scenario.sleep)
+	{
+		p.windType = index;
+	}
+	switch (p.windType)
+	{
+	case 0:
+		p.windData = glm::vec4(4.0f, 0.0f, 2.0f, 0.0f);
+		break;
+	case 1:
+		p.windData = glm::vec4(2.5f, 0.0f, -0.5f, 0.0f);
+		break;
+	case 2:
+		p.windData = glm::vec4(3.0f, 0.0f, -4.0f, 0.0f);
+		break;
+	}
+	p.gravityVec = glm::vec4(0.0f, -1.0f, 0.0f, 4.0f);
+	//The last scenario pulls towards a point instead
+	p.gravityPoint = glm::vec4(0.0f, -5.0f, 0.0f, 3.0f);
+	p.useGravityPoint = (index == FORCE_CHECK_WIND_TYPES - 1) ? 1.0f : 0.0f;
+
+	//Bilinear ramps in both directions
+	scenario.heightSamples.resize(FORCE_CHECK_HEIGHT_FIELD_SIZE * FORCE_CHECK_HEIGHT_FIELD_SIZE);
+	for (unsigned int y = 0; y < FORCE_CHECK_HEIGHT_FIELD_SIZE; y++)
+	{
+		for (unsigned int x = 0; x < FORCE_CHECK_HEIGHT_FIELD_SIZE; x++)
+		{
+			scenario.heightSamples[y * FORCE_CHECK_HEIGHT_FIELD_SIZE + x] = glm::vec2(0.125f * (float)x, 1.0f + 0.5f * (float)(y % 2));
+		}
+	}
+	scenario.heightField.samples = scenario.heightSamples.data();
+	scenario.heightField.width = FORCE_CHECK_HEIGHT_FIELD_SIZE;
+	scenario.heightField.height = FORCE_CHECK_HEIGHT_FIELD_SIZE;
+	scenario.heightField.bounds = glm::vec4(-3.0f, -6.0f, 8.0f, 8.0f);
+	p.heightField = &scenario.heightField;
+
+	scenario.collider[1] = glm::vec4(100.0f, 0.0f, 100.0f, 1.0f);
+	p.sphereCollider = scenario.collider;
+	p.amountSphereCollider = 2;
+}
+
+void ForceCheck::prepareStep(const unsigned int step, Scenario& scenario)
+{
+	scenario.params.windData.w = (float)step * scenario.params.dt;
+	if (scenario.sleep)
+	{
+		//No collider while the blades fall asleep, then one rolls in from the side
+		scenario.params.amountSphereCollider = (step >= FORCE_CHECK_SLEEP_WAKE_STEP) ? 2 : 0;
+		scenario.collider[0] = glm::vec4(0.2f * (float)step - 1.0f, 0.8f, -2.0f, 0.5f);
+		return;
+	}
+	//Rolls through the middle of the field, it reaches blades of both rows beside its path
+	scenario.collider[0] = glm::vec4(0.0f + 0.05f * (float)step, 0.8f, -2.0f, 0.5f);
+}
+
+void ForceCheck::updateBlades(Scenario& scenario, Blades& blades, const GrassForceIsa isa)
+{
+	scenario.params.awake = blades.awake.empty() ? 0 : blades.awake.data();
+	UpdateForces(scenario.params, blades.position.data(), blades.v1.data(), blades.v2.data(), blades.attr.data(), blades.pressure.data(), 0, FORCE_CHECK_SIMD_SPLIT, isa);
+	UpdateForces(scenario.params, blades.position.data(), blades.v1.data(), blades.v2.data(), blades.attr.data(), blades.pressure.data(), FORCE_CHECK_SIMD_SPLIT, FORCE_CHECK_BLADES - FORCE_CHECK_SIMD_SPLIT, isa);
+	scenario.params.awake = 0;
+}
+
+bool ForceCheck::writeGolden(const std::string& file, const std::vector<Blades>& results)
+{
+	std::ofstream out(file);
+	if (!out.is_open())
+	{
+		std::cout << "ERROR ForceCheck: Could not open " << file << "!" << std::endl;
+		return false;
+	}
+
+	out << FORCE_CHECK_MAGIC << " " << FORCE_CHECK_VERSION << " " << results.size() << " " << FORCE_CHECK_BLADES << " " << FORCE_CHECK_STEPS << std::endl;
+	out << std::setprecision(9);
+	for (unsigned int s = 0; s < results.size(); s++)
+	{
+		const Blades& b = results[s];
+		for (unsigned int i = 0; i < FORCE_CHECK_BLADES; i++)
+		{
+			out << b.v1[i].x << " " << b.v1[i].y << " " << b.v1[i].z << " "
+				<< b.v2[i].x << " " << b.v2[i].y << " " << b.v2[i].z << " "
+				<< b.pressure[i].x << " " << b.pressure[i].y << " " << b.pressure[i].z << " " << b.pressure[i].w << std::endl;
+		}
+		out << b.awakeHistory.size();
+		for (unsigned int w = 0; w < b.awakeHistory.size(); w++)
+		{
+			out << " " << b.awakeHistory[w];
+		}
+		out << std::endl;
+	}
+
+	if (!out.good())
+	{
+		std::cout << "ERROR ForceCheck: Could not write " << file << "!" << std::endl;
+		return false;
+	}
+	std::cout << "Wrote the results of " << results.size() << " scenarios to " << file << std::endl;
+	return true;
+}
+
+bool ForceCheck::compareGolden(const std::string& file, const std::vector<Blades>& results)
+{
+	std::ifstream in(file);
+	if (!in.is_open())
+	{
+		std::cout << "ERROR ForceCheck: Could not open " << file << "!" << std::endl;
+		return false;
+	}
+
+	std::string magic;
+	unsigned int version = 0, amountScenarios = 0, amountBlades = 0, amountSteps = 0;
+	in >> magic >> version >> amountScenarios >> amountBlades >> amountSteps;
+	if (magic != FORCE_CHECK_MAGIC || version != FORCE_CHECK_VERSION || amountScenarios != results.size() || amountBlades != FORCE_CHECK_BLADES || amountSteps != FORCE_CHECK_STEPS)
+	{
+		std::cout << "ERROR ForceCheck: " << file << " was written for other scenarios, write it again with --write!" << std::endl;
+		return false;
+	}
+
+	static const char* names[] = { "v1", "v2", "pressure" };
+	unsigned int mismatches = 0;
+	float maxError = 0.0f;
+	for (unsigned int s = 0; s < results.size(); s++)
+	{
+		const Blades& b = results[s];
+		for (unsigned int i = 0; i < FORCE_CHECK_BLADES; i++)
+		{
+			glm::vec4 golden[3];
+			in >> golden[0].x >> golden[0].y >> golden[0].z >> golden[1].x >> golden[1].y >> golden[1].z >> golden[2].x >> golden[2].y >> golden[2].z >> golden[2].w;
+			if (in.fail())
+			{
+				std::cout << "ERROR ForceCheck: " << file << " ends early!" << std::endl;
+				return false;
+			}
+
+			//Positions in blade heights, the collision force relative to its size
+			const float height = b.v1[i].w;
+			glm::vec4 value[3] = { b.v1[i], b.v2[i], b.pressure[i] };
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				float error = glm::length(glm::vec3(value[k]) - glm::vec3(golden[k])) / height;
+				if (k == 2)
+				{
+					error = glm::max(error, glm::abs(value[k].w - golden[k].w) / glm::max(glm::abs(golden[k].w), 1.0f));
+				}
+				maxError = glm::max(maxError, error);
+				if (!(error <= FORCE_CHECK_GOLDEN_TOLERANCE))
+				{
+					if (mismatches < 10)
+					{
+						std::cout << "ERROR ForceCheck: Scenario " << s << ", blade " << i << " " << names[k] << " is off by " << error << " blade heights" << std::endl;
+					}
+					mismatches++;
+				}
+			}
+		}
+
+		unsigned int amountWords = 0;
+		in >> amountWords;
+		std::vector<unsigned int> golden(amountWords);
+		for (unsigned int w = 0; w < amountWords; w++)
+		{
+			in >> golden[w];
+		}
+		if (in.fail())
+		{
+			std::cout << "ERROR ForceCheck: " << file << " ends early!" << std::endl;
+			return false;
+		}
+		if (golden != b.awakeHistory)
+		{
+			std::cout << "ERROR ForceCheck: Scenario " << s << " has other sleeping blades than " << file << std::endl;
+			mismatches++;
+		}
+	}
+
+	std::cout << "Force check against " << file << ": " << mismatches << " mismatches, largest error " << maxError << " blade heights" << std::endl;
+	return mismatches == 0;
+}
+
+void ForceCheck::compareSimd(const GrassForceIsa isa, const unsigned int scenario, const unsigned int step, const Blades& reference, const Blades& simd, unsigned int& mismatches, float& maxError)
+{
+	for (unsigned int w = 0; w < reference.awake.size(); w++)
+	{
+		if (simd.awake[w] != reference.awake[w])
+		{
+			if (mismatches < 10)
+			{
+				std::cout << "ERROR ForceCheck: " << toString(isa) << ", scenario " << scenario << ", step " << step << ", awake word " << w << " is "
+					<< std::hex << simd.awake[w] << " instead of " << reference.awake[w] << std::dec << std::endl;
+			}
+			mismatches++;
+		}
+	}
+
+	for (unsigned int i = 0; i < FORCE_CHECK_BLADES; i++)
+	{
+		const float height = reference.v1[i].w;
+		float error[2] = { glm::length(glm::vec3(simd.v1[i]) - glm::vec3(reference.v1[i])) / height, glm::length(glm::vec3(simd.v2[i]) - glm::vec3(reference.v2[i])) / height };
+		for (unsigned int k = 0; k < 2; k++)
+		{
+			maxError = glm::max(maxError, error[k]);
+			if (!(error[k] <= FORCE_CHECK_SIMD_TOLERANCE))
+			{
+				if (mismatches < 10)
+				{
+					std::cout << "ERROR ForceCheck: " << toString(isa) << ", scenario " << scenario << ", step " << step << ", blade " << i << " " << ((k == 0) ? "v1" : "v2") << " is off by " << error[k] << " blade heights" << std::endl;
+				}
+				mismatches++;
+			}
+		}
+	}
+}
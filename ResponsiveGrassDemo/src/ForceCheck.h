@@ -0,0 +1,75 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef FORCECHECK_H
+#define FORCECHECK_H
+
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "GrassForce.h"
+
+#define FORCE_CHECK_BLADES 45 //Not a multiple of any SIMD width
+#define FORCE_CHECK_STEPS 32
+#define FORCE_CHECK_DT (1.0f / 60.0f)
+#define FORCE_CHECK_SLEEP_DT 0.25f //Large steps, so the blades of the sleep scenario come to rest within FORCE_CHECK_STEPS
+#define FORCE_CHECK_SLEEP_WAKE_STEP 20 //First step with a collider in the sleep scenario
+#define FORCE_CHECK_GOLDEN_TOLERANCE 5e-5f //In blade heights, leaves room for fused multiply-adds and the sin and cos of other C runtimes
+#define FORCE_CHECK_SIMD_TOLERANCE 1e-4f //In blade heights per step, the documented bound of UpdateForces
+#define FORCE_CHECK_SIMD_SPLIT 3 //UpdateForces runs on [0, 3) and [3, FORCE_CHECK_BLADES), an unaligned first and a scalar tail
+
+/**
+*  Headless regression check of the CPU force update, no window or GL context is created.
+*  Started with: ResponsiveGrassDemo --force-check [options]
+*    --golden <file>  stored results to compare against, default is ForceCheck/ForceReference.txt in the ressources
+*    --write <file>   writes the results of this build as new golden file instead of comparing
+*  A fixed set of blades is simulated for FORCE_CHECK_STEPS steps with UpdateForcesReference, once per wind type,
+*  with a height field, a moving sphere collider that bends some blades and one that is out of reach.
+*  A last scenario without wind runs with an activity mask: the blades fall asleep, skip the colliders until
+*  FORCE_CHECK_SLEEP_WAKE_STEP, and then some of them are woken by the moving collider.
+*  v1, v2 and the pressure of every blade and the mask after every step are compared against the golden file.
+*  Every step is also run with UpdateForces for each SIMD instruction set the CPU supports, starting from the same
+*  state as the reference. v1 and v2 have to stay within FORCE_CHECK_SIMD_TOLERANCE of the reference step and the mask has to match.
+*  All updates are split at FORCE_CHECK_SIMD_SPLIT, so the second range starts inside a mask word.
+*  Returns 0 if both checks pass, 1 otherwise.
+*/
+class ForceCheck
+{
+public:
+	//args are the arguments after --force-check, returns the exit code
+	static int run(const std::vector<std::string>& args);
+
+private:
+	struct Blades
+	{
+		std::vector<glm::vec4> position, v1, v2, attr, pressure;
+		std::vector<unsigned int> awake; //Activity mask, empty if the scenario has none
+		std::vector<unsigned int> awakeHistory; //awake after every step
+	};
+
+	//The height field points into heightSamples, so a scenario is not copied
+	struct Scenario
+	{
+		GrassForceParams params;
+		glm::vec4 collider[2];
+		std::vector<glm::vec2> heightSamples;
+		GrassHeightField heightField;
+		bool sleep;
+	};
+
+	static void makeBlades(Blades& blades);
+	//Scenario 0 to 2 use the wind types, the last one is the sleep scenario
+	static void makeScenario(const unsigned int index, Scenario& scenario);
+	//Wind time and colliders of the given step
+	static void prepareStep(const unsigned int step, Scenario& scenario);
+	//One step of all blades with the given instruction set, in the ranges [0, FORCE_CHECK_SIMD_SPLIT) and [FORCE_CHECK_SIMD_SPLIT, FORCE_CHECK_BLADES)
+	static void updateBlades(Scenario& scenario, Blades& blades, const GrassForceIsa isa);
+	static bool writeGolden(const std::string& file, const std::vector<Blades>& results);
+	static bool compareGolden(const std::string& file, const std::vector<Blades>& results);
+	//Counts v1 and v2 further than FORCE_CHECK_SIMD_TOLERANCE from the reference and differing mask words in mismatches, maxError is raised to the largest error
+	static void compareSimd(const GrassForceIsa isa, const unsigned int scenario, const unsigned int step, const Blades& reference, const Blades& simd, unsigned int& mismatches, float& maxError);
+};
+
+#endif
@@ -16,6 +16,7 @@ namespace Geometry
 		glm::vec3 normal;
 		glm::vec3 tangent;
 		glm::vec3 bitangent;
+		glm::vec2 uv;
 	};
 
 	class TriangleFace
@@ -26,6 +27,9 @@ namespace Geometry
 		glm::vec3 faceCenterPosition;
 		float area;
 
+		//Empty face, for face lists that are filled in place
+		TriangleFace() {}
+
 		TriangleFace(const Vertex v1, const Vertex v2, const Vertex v3) : vertices()
 		{
 			vertices[0] = v1;
@@ -43,6 +47,32 @@ namespace Geometry
 			faceCenterPosition = (vertices[0].position + vertices[1].position + vertices[2].position) / 3.0f;
 		}
 	};
+
+	//Uniformly distributed barycentric coordinates from two uniform random numbers
+	inline glm::vec3 uniformBarycentric(const float r1, const float r2)
+	{
+		float sr1 = glm::sqrt(r1);
+		return glm::vec3(1.0f - sr1, sr1 * (1.0f - r2), sr1 * r2);
+	}
+
+	//Barycentric coordinates of p projected onto the plane of the face, outside of the face they are extrapolated
+	inline glm::vec3 barycentric(const glm::vec3& p, const TriangleFace& face)
+	{
+		glm::vec3 e0 = face.vertices[1].position - face.vertices[0].position;
+		glm::vec3 e1 = face.vertices[2].position - face.vertices[0].position;
+		glm::vec3 d = p - face.vertices[0].position;
+		float d00 = glm::dot(e0, e0);
+		float d01 = glm::dot(e0, e1);
+		float d11 = glm::dot(e1, e1);
+		float denom = d00 * d11 - d01 * d01;
+		if (denom <= 0.0f)
+		{
+			return glm::vec3(1.0f, 0.0f, 0.0f);
+		}
+		float v = (d11 * glm::dot(d, e0) - d01 * glm::dot(d, e1)) / denom;
+		float w = (d00 * glm::dot(d, e1) - d01 * glm::dot(d, e0)) / denom;
+		return glm::vec3(1.0f - v - w, v, w);
+	}
 }
 
 #endif
\ No newline at end of file
@@ -9,21 +9,48 @@
 #include <algorithm>
 #include <functional>
 #include <thread>
-#include <queue>
-#include <fstream>
+#include <mutex>
+#include <condition_variable>
 #include "glm\gtc\matrix_transform.hpp"
 #include "BoundingBox.h"
 #include "OpenGLState.h"
-#include "ThreadPool.h"
+#include "AliasTable.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "SurfacePoissonSampler.h"
+#include "GrassBake.h"
+#include "AttributeMap.h"
 
 #define MAX_AMOUNT_INNER_SPHERES 150
-#define MAX_AMOUNT_SPHERE_COLLIDER 50
-#define OPTIMAL_TILE_FACTOR 10
-
-#define PARTITIONING_BY_CLUSTERING
-
-#define USE_MANHATTEN_DISTANCE false
-#define EVALUATE_MSE
+#define GENERATION_CHUNK_SIZE 16384
+#define FORCE_CPU_CHUNK_SIZE 4096
+
+//Peak memory of one generated blade: four vec4 attributes, the per-tile copies and the partitioning bookkeeping
+#define GENERATION_BYTES_PER_BLADE 192
+
+//Density map sampling
+#define DENSITY_MAX_SUBDIVISIONS 64
+#define DENSITY_MAX_ATTEMPTS 16
+#define DENSITY_BLOCK_RETRY 2
+#define DENSITY_BLOCK_CLUSTER_THINNING 64
+#define BLADE_MAP_MIN_SCALE 0.05f
+
+//Random streams of one parameter set
+#define RANDOM_STREAM_BLADES 0
+#define RANDOM_STREAM_CLUSTER_CENTERS 1
+#define RANDOM_STREAM_CLUSTER_BLADES 2
+#define RANDOM_STREAM_COUNT 3
+//Shape streams count down from here per parameter set, so adding a shape mix leaves all other attributes unchanged
+#define RANDOM_STREAM_SHAPES 0xFFFFFFFEu
+
+//Storage binding of the deformed faces, the first one after the patch buffers
+#define REPROJECT_FACE_LOCATION GrassPatch::GrassBufferEnum::AMOUNT_BUFFER
+#define REPROJECT_VEC4_PER_FACE 6
+//Storage binding of the colliders of the force update
+#define COLLIDER_LOCATION (GrassPatch::GrassBufferEnum::AMOUNT_BUFFER + 1)
+
+//Prints the partition quality of every generation, --partition-benchmark measures it without slowing down the demo
+//#define EVALUATE_MSE
 
 //*******************************************
 //*********** Helper functions **************
@@ -35,6 +62,199 @@ glm::vec3 interpolate3G2(const glm::vec3& barycentric, const glm::vec3& v1, cons
 	return v1 * barycentric.x + v2 * barycentric.y + v3 * barycentric.z;
 }
 
+inline unsigned int randomStreamIndex(const unsigned int streamIndex, const unsigned int stream)
+{
+	return streamIndex * RANDOM_STREAM_COUNT + stream;
+}
+
+/**
+*  Splits the faces into spatially coherent groups whose blades fit into maxBytes. Each node is split along the
+*  longest axis of its face centers at the area-weighted median, so groups hold about the same amount of blades.
+*  A single face is never split, even if it exceeds the limit.
+*/
+void SplitFacesForGeneration(const std::vector<Geometry::TriangleFace>& faces, const double bytesPerArea, const double maxBytes, std::vector<std::vector<unsigned int>>& groups)
+{
+	groups.clear();
+	std::vector<unsigned int> order(faces.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	std::vector<std::pair<unsigned int, unsigned int>> stack;
+	stack.push_back(std::pair<unsigned int, unsigned int>(0, (unsigned int)order.size()));
+	while (!stack.empty())
+	{
+		unsigned int begin = stack.back().first;
+		unsigned int end = stack.back().second;
+		stack.pop_back();
+
+		double area = 0.0;
+		glm::vec3 cMin(FLT_MAX);
+		glm::vec3 cMax(-FLT_MAX);
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const Geometry::TriangleFace& f = faces[order[i]];
+			area += f.area;
+			cMin = glm::min(cMin, f.faceCenterPosition);
+			cMax = glm::max(cMax, f.faceCenterPosition);
+		}
+
+		if (end - begin <= 1 || area * bytesPerArea <= maxBytes)
+		{
+			if (end > begin)
+			{
+				groups.push_back(std::vector<unsigned int>(order.begin() + begin, order.begin() + end));
+			}
+			continue;
+		}
+
+		glm::vec3 extent = cMax - cMin;
+		unsigned int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+		std::sort(order.begin() + begin, order.begin() + end, [&](const unsigned int a, const unsigned int b)
+		{
+			return faces[a].faceCenterPosition[axis] < faces[b].faceCenterPosition[axis];
+		});
+
+		unsigned int mid = begin + 1;
+		double halfArea = area * 0.5;
+		double curArea = faces[order[begin]].area;
+		while (mid < end - 1 && curArea + faces[order[mid]].area <= halfArea)
+		{
+			curArea += faces[order[mid]].area;
+			mid++;
+		}
+
+		//Push the upper half first, so groups are emitted in spatial order
+		stack.push_back(std::pair<unsigned int, unsigned int>(mid, end));
+		stack.push_back(std::pair<unsigned int, unsigned int>(begin, mid));
+	}
+}
+
+inline glm::vec2 interpolateUV(const glm::vec3& barycentric, const Geometry::TriangleFace& face)
+{
+	return face.vertices[0].uv * barycentric.x + face.vertices[1].uv * barycentric.y + face.vertices[2].uv * barycentric.z;
+}
+
+/**
+*  Weight of every face for the blade distribution, which is its area or, with a density map, its area times the mean density.
+*  The map is sampled on a barycentric grid that roughly matches the texel size of the face in UV space.
+*  faceMax receives the maximum density of each face for the rejection step. Returns the sum of all weights.
+*/
+double ComputeFaceWeights(const GrassCreateBladeParams& p, const std::vector<Geometry::TriangleFace>& faces, std::vector<float>& weights, std::vector<float>& faceMax)
+{
+	weights.resize(faces.size());
+	if (p.densityMap == 0)
+	{
+		faceMax.clear();
+		double sumArea = 0.0;
+		for (unsigned int i = 0; i < faces.size(); i++)
+		{
+			weights[i] = faces[i].area;
+			sumArea += faces[i].area;
+		}
+		return sumArea;
+	}
+
+	faceMax.resize(faces.size());
+	const AttributeMap& map = *p.densityMap;
+	const float resolution = (float)glm::max(map.Width(), map.Height());
+	parallelFor((unsigned int)faces.size(), 256, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const Geometry::TriangleFace& f = faces[i];
+			float uvEdge = glm::max(glm::length(f.vertices[1].uv - f.vertices[0].uv), glm::max(glm::length(f.vertices[2].uv - f.vertices[1].uv), glm::length(f.vertices[0].uv - f.vertices[2].uv)));
+			unsigned int n = (unsigned int)glm::clamp(glm::ceil(uvEdge * resolution), 1.0f, (float)DENSITY_MAX_SUBDIVISIONS);
+
+			float sum = 0.0f;
+			float maxDensity = 0.0f;
+			unsigned int count = 0;
+			for (unsigned int a = 0; a <= n; a++)
+			{
+				for (unsigned int b = 0; a + b <= n; b++)
+				{
+					glm::vec3 barycentric = glm::vec3((float)(n - a - b), (float)a, (float)b) / (float)n;
+					float d = glm::clamp(map.sample(interpolateUV(barycentric, f)), 0.0f, 1.0f);
+					sum += d;
+					maxDensity = glm::max(maxDensity, d);
+					count++;
+				}
+			}
+
+			weights[i] = f.area * sum / (float)count;
+			faceMax[i] = maxDensity;
+		}
+	});
+
+	double sumWeights = 0.0;
+	for (unsigned int i = 0; i < faces.size(); i++)
+	{
+		sumWeights += weights[i];
+	}
+	return sumWeights;
+}
+
+/**
+*  Rejection sampling inside the faces, so the blades follow the density map even on large faces.
+*  propose(block, faceIndex, barycentric) places a candidate using the given random block, each attempt uses its own blocks.
+*  The last attempt is always accepted. Returns the block of the accepted candidate.
+*/
+template<typename Proposal>
+unsigned int SampleDensity(const GrassCreateBladeParams& p, const std::vector<Geometry::TriangleFace>& faces, const std::vector<float>& faceMax, const RandomStream& rng, const unsigned int element,
+	const Proposal& propose, unsigned int& faceIndex, glm::vec3& barycentric)
+{
+	unsigned int block = 0;
+	for (unsigned int a = 0; a < DENSITY_MAX_ATTEMPTS; a++)
+	{
+		block = (a == 0) ? 0 : DENSITY_BLOCK_RETRY + 2 * a;
+		propose(block, faceIndex, barycentric);
+		if (p.densityMap == 0 || rng.uniform(element, (DENSITY_BLOCK_RETRY + 2 * a + 1) * 4) * faceMax[faceIndex] < p.densityMap->sample(interpolateUV(barycentric, faces[faceIndex])))
+		{
+			break;
+		}
+	}
+	return block;
+}
+
+//Draws the shape of every blade from the shape mix of the parameter set
+void AssignBladeShapes(const GrassCreateBladeParams& p, const unsigned int streamIndex, BladeBuffer& blades)
+{
+	if (p.shapeMix.empty())
+	{
+		return;
+	}
+
+	std::vector<float> weights(p.shapeMix.size());
+	for (unsigned int i = 0; i < p.shapeMix.size(); i++)
+	{
+		weights[i] = p.shapeMix[i].weight;
+	}
+	AliasTable shapeSampler(weights);
+	RandomStream rng(p.seed, RANDOM_STREAM_SHAPES - streamIndex);
+
+	glm::vec4* position = blades.position();
+	parallelFor(blades.size(), GENERATION_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			glm::uvec4 bits = rng.bits(i, 0);
+			unsigned int s = shapeSampler.sample(bits.x, RandomStream::toUniform(bits.y));
+			position[i].w = encodeBladeShape(position[i].w, p.shapeMix[s].shape);
+		}
+	});
+}
+
+//Height and width scale of the optional blade maps at a surface point
+inline glm::vec2 SampleBladeScale(const GrassCreateBladeParams& p, const Geometry::TriangleFace& face, const glm::vec3& barycentric)
+{
+	glm::vec2 scale(1.0f);
+	if (p.bladeHeightMap != 0 || p.bladeWidthMap != 0)
+	{
+		glm::vec2 uv = interpolateUV(barycentric, face);
+		if (p.bladeHeightMap != 0) { scale.x = glm::max(p.bladeHeightMap->sample(uv), BLADE_MAP_MIN_SCALE); }
+		if (p.bladeWidthMap != 0) { scale.y = glm::max(p.bladeWidthMap->sample(uv), BLADE_MAP_MIN_SCALE); }
+	}
+	return scale;
+}
+
 bool intersect(const BoundingBox::TransformedBox& box, const glm::vec4& sphere)
 {
 	glm::vec3 Bmin = box.location - (box.axis1 + box.axis2 + box.axis3);
@@ -69,7 +289,7 @@ bool intersect(const glm::vec4& sphere1, const glm::vec4& sphere2)
 //Method for Quicksort
 unsigned int partition(unsigned int index[], const float values[], const unsigned int low, const unsigned int high)
 {
-	unsigned int pIndex = low + rand() % ((high - low)+1);
+	unsigned int pIndex = low + (high - low) / 2;
 	float pivot = values[index[pIndex]];
 	unsigned int helpPivot = index[high];
 	index[high] = index[pIndex];
@@ -135,147 +355,30 @@ void multi_quicksort(unsigned int index[], const float values[], const unsigned
 	}
 }
 
-void SortVectors(std::vector<glm::vec4>& main, std::vector<glm::vec4>& other1, std::vector<glm::vec4>& other2, std::vector<glm::vec4>& other3, float values[], const unsigned int minIndexInclusive, const unsigned int maxIndexExclusive)
+//Sorts the blades by values in [minIndexInclusive, maxIndexExclusive), the blades are permuted with a single gather
+void SortBlades(BladeBuffer& blades, float values[], const unsigned int minIndexInclusive, const unsigned int maxIndexExclusive)
 {
-	unsigned int* index = new unsigned int[main.size()];
-
-	for (unsigned int i = 0; i < main.size(); i++)
-	{
-		index[i] = i;
-	}
+	unsigned int amountBlades = blades.size();
+	std::vector<unsigned int> index(amountBlades);
+	std::iota(index.begin(), index.end(), 0);
 
 	unsigned int maxDepth = 5; //TODO make smarter
 
-	std::thread t(multi_quicksort, index, values, minIndexInclusive, maxIndexExclusive - 1, 0, maxDepth);
+	std::thread t(multi_quicksort, index.data(), values, minIndexInclusive, maxIndexExclusive - 1, 0, maxDepth);
 	t.join();
 
-	std::vector<glm::vec4> main_local(main);
-	std::vector<glm::vec4> other1_local(other1);
-	std::vector<glm::vec4> other2_local(other2);
-	std::vector<glm::vec4> other3_local(other3);
-	float* values_local = new float[main.size()];
-	std::copy(values, values+main.size(), values_local);
+	BladeBuffer sorted;
+	sorted.gather(blades, index.data(), amountBlades);
+	blades = std::move(sorted);
 
-	for (unsigned int i = 0; i < main.size(); i++)
+	std::vector<float> valuesSorted(amountBlades);
+	for (unsigned int i = 0; i < amountBlades; i++)
 	{
-		main[i] = main_local[index[i]];
-		other1[i] = other1_local[index[i]];
-		other2[i] = other2_local[index[i]];
-		other3[i] = other3_local[index[i]];
-		values[i] = values_local[index[i]];
+		valuesSorted[i] = values[index[i]];
 	}
-
-	delete[] values_local;
-	delete[] index;
+	std::copy(valuesSorted.begin(), valuesSorted.end(), values);
 }
 
-class Grid3D
-{
-	struct GridCell
-	{
-		float xMin, xMax, yMin, yMax, zMin, zMax;
-		std::vector<glm::vec3> content;
-	};
-
-	std::vector<GridCell> cells;
-	float xMin, xMax, yMin, yMax, zMin, zMax, gridSize;
-	unsigned int amountCellsX, amountCellsY, amountCellsZ;
-
-public:
-	Grid3D(float xMin, float xMax, float yMin, float yMax, float zMin, float zMax, float gridSize) : xMin(xMin), xMax(xMax), yMin(yMin), yMax(yMax), zMin(zMin), zMax(zMax), gridSize(gridSize)
-	{
-		amountCellsX = glm::max((unsigned int)glm::ceil((xMax - xMin) / gridSize), 1u);
-		amountCellsY = glm::max((unsigned int)glm::ceil((yMax - yMin) / gridSize), 1u);
-		amountCellsZ = glm::max((unsigned int)glm::ceil((zMax - zMin) / gridSize), 1u);
-
-		cells.reserve(amountCellsX * amountCellsY * amountCellsZ);
-
-		for (unsigned int z = 0; z < amountCellsZ; z++)
-		{
-			float curZMin = z * gridSize;
-			float curZMax = glm::max((z + 1)*gridSize, zMax);
-			for (unsigned int y = 0; y < amountCellsY; y++)
-			{
-				float curYMin = y * gridSize;
-				float curYMax = glm::max((y + 1)*gridSize, yMax);
-				for (unsigned int x = 0; x < amountCellsX; x++)
-				{
-					float curXMin = x * gridSize;
-					float curXMax = glm::max((x + 1)*gridSize, xMax);
-
-					GridCell cell;
-					cell.xMin = curXMin; cell.xMax = curXMax;
-					cell.yMin = curYMin; cell.yMax = curYMax;
-					cell.zMin = curZMin; cell.zMax = curZMax;
-					cells.push_back(cell);
-				}
-			}
-		}
-	}
-
-	~Grid3D() {}
-
-	unsigned int getIndex(unsigned int zBucket, unsigned int yBucket, unsigned int xBucket) const
-	{
-		return zBucket * (amountCellsX * amountCellsY) + yBucket * amountCellsX + xBucket;
-	}
-
-	void insert(const glm::vec3& position)
-	{
-		unsigned int xBucket = glm::min((unsigned int)glm::floor((position.x - xMin) / gridSize), amountCellsX - 1);
-		unsigned int yBucket = glm::min((unsigned int)glm::floor((position.y - yMin) / gridSize), amountCellsY - 1);
-		unsigned int zBucket = glm::min((unsigned int)glm::floor((position.z - zMin) / gridSize), amountCellsZ - 1);
-
-		unsigned int index = getIndex(zBucket, yBucket, xBucket);
-
-		cells[index].content.push_back(position);
-	}
-
-	std::vector<glm::vec3> getCandidates(const glm::vec3& position) const
-	{
-		unsigned int xBucket = glm::min((unsigned int)glm::floor((position.x - xMin) / gridSize), amountCellsX - 1);
-		unsigned int yBucket = glm::min((unsigned int)glm::floor((position.y - yMin) / gridSize), amountCellsY - 1);
-		unsigned int zBucket = glm::min((unsigned int)glm::floor((position.z - zMin) / gridSize), amountCellsZ - 1);
-
-		std::vector<glm::vec3> ret;
-
-		{
-			unsigned int index = getIndex(zBucket, yBucket, xBucket);
-			auto& c = cells[index].content;
-			ret.reserve(ret.size() + c.size());
-			ret.insert(ret.end(), c.begin(), c.end());
-		}
-		
-		for (int x = -1; x <= 1; x++)
-		{
-			if (!(x == -1 && xBucket == 0) && !(x == 1 && xBucket == amountCellsX - 1))
-			{
-				for (int y = -1; y <= 1; y++)
-				{
-					if (!(y == -1 && yBucket == 0) && !(y == 1 && yBucket == amountCellsY - 1))
-					{
-						for (int z = -1; z <= 1; z++)
-						{
-							if (!(z == -1 && zBucket == 0) && !(z == 1 && zBucket == amountCellsZ - 1))
-							{
-								unsigned int index = getIndex(zBucket + z, yBucket + y, xBucket + x);
-								auto& c = cells[index].content;
-								if (!c.empty())
-								{
-									ret.reserve(ret.size() + c.size());
-									ret.insert(ret.end(), c.begin(), c.end());
-								}
-							}
-						}
-					}
-				}
-			}
-		}
-
-		return ret;
-	}
-};
-
 std::vector<std::vector<unsigned int>> factorize3(unsigned int n)
 {
 	std::vector<std::vector<unsigned int>> ret;
@@ -305,12 +408,6 @@ std::vector<std::vector<unsigned int>> factorize3(unsigned int n)
 	return ret;
 }
 
-float manDist(const glm::vec3& p1, const glm::vec3& p2)
-{
-	glm::vec3 dif = glm::abs(p1 - p2);
-	return dif.x + dif.y + dif.z;
-}
-
 #pragma endregion
 
 //*******************************************
@@ -322,6 +419,7 @@ Shader * Grass::updateForceShader = 0;
 Shader * Grass::updateVisibilityShader = 0;
 Shader * Grass::copyBufferShader = 0;
 Shader * Grass::drawShader = 0;
+Shader * Grass::reprojectShader = 0;
 Texture2D * Grass::diffuseTexture = 0;
 Texture2D * Grass::pressureMap = 0;
 unsigned int Grass::maxAmountBlades = 0;
@@ -381,8 +479,8 @@ Grass::Grass() : overmind(&GrassOvermind::getInstance()), patches(), localGravit
 		replace.push_back(std::to_string(GrassPatch::GrassBufferEnum::DEBUGOUT));
 		symbols.push_back("ATTR_LOCATION");
 		replace.push_back(std::to_string(GrassPatch::GrassBufferEnum::ATTR));
-		symbols.push_back("MAX_AMOUNT_SPHERE_COLLIDER");
-		replace.push_back(std::to_string(MAX_AMOUNT_SPHERE_COLLIDER));
+		symbols.push_back("COLLIDER_LOCATION");
+		replace.push_back(std::to_string(COLLIDER_LOCATION));
 		updateForceShader = new Shader(SHADERPATH + "Grass/GrassUpdateForcesShader", symbols, replace);
 	}
 
@@ -433,6 +531,29 @@ Grass::Grass() : overmind(&GrassOvermind::getInstance()), patches(), localGravit
 		drawShader = new Shader(SHADERPATH + "Grass/GrassDrawShader", symbols, replace);
 	}
 
+	if (reprojectShader == 0)
+	{
+		std::vector<std::string> symbols;
+		std::vector<std::string> replace;
+		symbols.push_back("MAX_WORK_GROUP_SIZE_X");
+		replace.push_back(std::to_string(Shader::max_work_group_size_X));
+		symbols.push_back("POSITION_LOCATION");
+		replace.push_back(std::to_string(GrassPatch::GrassBufferEnum::POSITION));
+		symbols.push_back("V1_LOCATION");
+		replace.push_back(std::to_string(GrassPatch::GrassBufferEnum::V1));
+		symbols.push_back("V2_LOCATION");
+		replace.push_back(std::to_string(GrassPatch::GrassBufferEnum::V2));
+		symbols.push_back("ATTR_LOCATION");
+		replace.push_back(std::to_string(GrassPatch::GrassBufferEnum::ATTR));
+		symbols.push_back("ANCHOR_LOCATION");
+		replace.push_back(std::to_string(GrassPatch::GrassBufferEnum::ANCHOR));
+		symbols.push_back("FACE_LOCATION");
+		replace.push_back(std::to_string(REPROJECT_FACE_LOCATION));
+		symbols.push_back("VEC4_PER_FACE");
+		replace.push_back(std::to_string(REPROJECT_VEC4_PER_FACE));
+		reprojectShader = new Shader(SHADERPATH + "Grass/GrassReprojectShader", symbols, replace);
+	}
+
 	if (diffuseTexture == 0)
 	{
 		diffuseTexture = Texture2D::loadTextureFromFile(TEXTUREPATH + "Grass/GrassDiffuse.png", true, true, false, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
@@ -451,7 +572,7 @@ Grass::Grass(const std::vector<GrassCreateBladeParams>& params, std::vector<Geom
 
 Grass::Grass(const Grass& other) : overmind(&GrassOvermind::getInstance()), patches(other.patches), modelMatrix(other.modelMatrix), boundingObject(other.boundingObject), 
 	localGravity(other.localGravity), useLocalGravity(other.useLocalGravity), wind(other.wind), heightMap(other.heightMap), heightMapBounds(other.heightMapBounds), 
-	parentObject(other.parentObject), altDiffuseTexture(other.altDiffuseTexture)
+	parentObject(other.parentObject), altDiffuseTexture(other.altDiffuseTexture), patchHierarchy(other.patchHierarchy), colliderCellSize(other.colliderCellSize)
 {
 	amountGrassInstances++;
 
@@ -463,11 +584,20 @@ Grass::~Grass()
 {
 	amountGrassInstances--;
 	overmind->removeGrassInstance(this);
+	if (reprojectFaceBuffer != 0)
+	{
+		glDeleteBuffers(1, &reprojectFaceBuffer);
+	}
+	if (colliderBuffer != 0)
+	{
+		glDeleteBuffers(1, &colliderBuffer);
+	}
 	if (amountGrassInstances == 0)
 	{
 		delete updateForceShader;
 		delete updateVisibilityShader;
 		delete drawShader;
+		delete reprojectShader;
 	}
 }
 
@@ -475,34 +605,169 @@ void Grass::Initialize(const std::vector<GrassCreateBladeParams>& params, std::v
 {
 	std::cout << "Initialize grass on " << faces.size() << " faces" << std::endl;
 
-	for (unsigned int pI = 0; pI < params.size(); pI++)
+	//A matching bake skips the whole generation
+	unsigned long long bakeKey = GrassBake::computeKey(faces, params, maxAmountBlades);
+	std::string bakeFile = GrassBake::fileName(bakeKey);
+	unsigned int firstPatch = (unsigned int)patches.size();
+	bool baked = GrassBake::load(bakeFile, bakeKey, patches);
+	if (baked)
 	{
-		GrassCreateBladeParams p = params[pI];
-
-		switch (p.spacialDistribution)
+		for (unsigned int i = firstPatch; i < patches.size(); i++)
 		{
-		case GrassSpacialDistribution::FACE_RANDOM:
-			DistributeFaceRandom(p, faces);
-			break;
-		case GrassSpacialDistribution::FACE_AREA:
-			DistributeFaceArea(p, faces);
-			break;
+			maxAmountBlades = glm::max(maxAmountBlades, patches[i].patch->amountBlades);
 		}
 	}
 
+	if (!baked)
+	{
+		GenerateLayers(params, faces);
+	}
+
+	if (!baked)
+	{
+		GrassBake::save(bakeFile, bakeKey, patches, firstPatch);
+	}
+
 	overmind->NotifyGrassInstanceUpdated();
 	UpdatePressureMap();
 
+	for (unsigned int i = firstPatch; i < patches.size(); i++)
+	{
+		if (patches[i].patch->hasAnchors())
+		{
+			UpdateAnchorBounds(patches[i], faces, true);
+		}
+	}
+
+	UpdateBoundingObject();
+}
+
+/**
+*  Every parameter set is distributed and partitioned as one chunk on the ParallelPool, the face groups of one set stay sequential.
+*  The parallel loops inside a set run on the same pool, so the amount of threads does not grow with the amount of sets.
+*  The calling thread owns the GL context, it uploads the finished groups in the order of the serial generation,
+*  so the patch order does not depend on the timing of the workers.
+*  A set only starts a face group after its previous group was uploaded, so every set holds at most one group in memory
+*  and a streamed field stays below its generationMemoryLimitMB.
+*/
+void Grass::GenerateLayers(const std::vector<GrassCreateBladeParams>& params, std::vector<Geometry::TriangleFace>& faces)
+{
+	//Fields that exceed the memory limit are generated, partitioned and uploaded one face group at a time
+	std::vector<std::vector<std::vector<unsigned int>>> groups(params.size());
+	std::vector<unsigned int> firstSlot(params.size() + 1, 0);
+	for (unsigned int pI = 0; pI < params.size(); pI++)
+	{
+		const GrassCreateBladeParams& p = params[pI];
+		SplitFacesForGeneration(faces, (double)p.density * GENERATION_BYTES_PER_BLADE, (double)p.generationMemoryLimitMB * 1024.0 * 1024.0, groups[pI]);
+		if (groups[pI].size() > 1)
+		{
+			std::cout << "Streaming generation in " << groups[pI].size() << " face groups" << std::endl;
+		}
+		firstSlot[pI + 1] = firstSlot[pI] + (unsigned int)groups[pI].size();
+	}
+
+	//The tiling decision of all sets uses the patch size from before the generation, as the workers cannot see each other
+	const unsigned int maxBlades = maxAmountBlades;
+
+	std::vector<GeneratedPatches> slots(firstSlot[params.size()]);
+	std::vector<bool> ready(slots.size(), false);
+	std::vector<bool> uploaded(slots.size(), false);
+	std::mutex slotMutex;
+	std::condition_variable slotReady, slotUploaded;
+
+	//The generator thread is the calling thread of the pool run, so the uploads below are never blocked by the generation
+	std::thread generator([&]()
+	{
+		parallelFor((unsigned int)params.size(), 1, [&](const unsigned int begin, const unsigned int, const unsigned int)
+		{
+			const unsigned int pI = begin;
+			const GrassCreateBladeParams& p = params[pI];
+			unsigned int generatedBlades = 0; //Of the earlier groups, the source ids of a group start here
+			for (unsigned int g = 0; g < groups[pI].size(); g++)
+			{
+				if (g > 0)
+				{
+					std::unique_lock<std::mutex> lock(slotMutex);
+					slotUploaded.wait(lock, [&]() { return (bool)uploaded[firstSlot[pI] + g - 1]; });
+				}
+
+				//Group 0 keeps the stream of an unsplit field, so small fields generate the same blades as before
+				unsigned int streamIndex = pI + g * (unsigned int)params.size();
+
+				std::vector<Geometry::TriangleFace> groupFaces;
+				if (groups[pI].size() > 1)
+				{
+					groupFaces.reserve(groups[pI][g].size());
+					for (unsigned int i = 0; i < groups[pI][g].size(); i++)
+					{
+						groupFaces.push_back(faces[groups[pI][g][i]]);
+					}
+				}
+				const std::vector<Geometry::TriangleFace>& curFaces = (groups[pI].size() > 1) ? groupFaces : faces;
+
+				BladeBuffer blades;
+				switch (p.spacialDistribution)
+				{
+				case GrassSpacialDistribution::FACE_RANDOM:
+					DistributeFaceRandom(p, streamIndex, curFaces, groups[pI][g], blades);
+					break;
+				case GrassSpacialDistribution::FACE_AREA:
+					DistributeFaceArea(p, streamIndex, curFaces, groups[pI][g], blades);
+					break;
+				}
+
+				GeneratedPatches& slot = slots[firstSlot[pI] + g];
+				slot.params = &p;
+				if (!blades.empty())
+				{
+					const unsigned int amountBlades = blades.size();
+					AssignBladeShapes(p, streamIndex, blades);
+					BuildPatches(std::move(blades), p, maxBlades, generatedBlades, slot);
+					generatedBlades += amountBlades;
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(slotMutex);
+					ready[firstSlot[pI] + g] = true;
+				}
+				slotReady.notify_one();
+			}
+		});
+	});
+
+	for (unsigned int i = 0; i < slots.size(); i++)
+	{
+		{
+			std::unique_lock<std::mutex> lock(slotMutex);
+			slotReady.wait(lock, [&]() { return (bool)ready[i]; });
+		}
+		UploadPatches(slots[i]);
+		{
+			std::lock_guard<std::mutex> lock(slotMutex);
+			uploaded[i] = true;
+		}
+		slotUploaded.notify_all();
+	}
+	generator.join();
+}
+
+void Grass::UpdateBoundingObject()
+{
 	float xMin = FLT_MAX;
 	float yMin = FLT_MAX;
 	float zMin = FLT_MAX;
 	float xMax = -FLT_MAX;
 	float yMax = -FLT_MAX;
 	float zMax = -FLT_MAX;
+	float sumPatchSize = 0.0f;
+	unsigned int amountBoundedPatches = 0;
 	for each(GrassPatchInfo p in patches)
 	{
 		if (p.bounds != 0)
 		{
+			sumPatchSize += glm::max(p.bounds->xMax - p.bounds->xMin, glm::max(p.bounds->yMax - p.bounds->yMin, p.bounds->zMax - p.bounds->zMin));
+			amountBoundedPatches++;
+
 			if (p.bounds->xMin < xMin) { xMin = p.bounds->xMin;	}
 			if (p.bounds->yMin < yMin) { yMin = p.bounds->yMin; }
 			if (p.bounds->zMin < zMin) { zMin = p.bounds->zMin; }
@@ -517,61 +782,223 @@ void Grass::Initialize(const std::vector<GrassCreateBladeParams>& params, std::v
 		boundingObject = 0;
 	}
 	boundingObject = new BoundingBox(xMin, xMax, yMin, yMax, zMin, zMax);
+	patchHierarchy.build(patches);
+
+	if (amountBoundedPatches > 0 && sumPatchSize > 0.0f)
+	{
+		colliderCellSize = sumPatchSize / (float)amountBoundedPatches;
+	}
 }
 
-void GenerateClusterBlades(const GrassCreateBladeParams& p, const float clusterDistance, unsigned int amountBlades, unsigned int amountCluster, 
-	const std::vector<glm::vec3>& clusterPos, const std::vector<glm::vec3>& clusterUp, const std::vector<glm::vec3>& clusterTangent, 
-	std::vector<glm::vec4>& bladePositions, std::vector<glm::vec4>& bladeV1, std::vector<glm::vec4>& bladeV2, std::vector<glm::vec4>& bladeAttr)
+/**
+*  Bounds of an anchored patch from the bounds of its faces. With computeMargin the margins are taken from the current bounds,
+*  which must match the faces, otherwise the bounds are rebuilt from the faces and the stored margins.
+*/
+void Grass::UpdateAnchorBounds(GrassPatchInfo& patch, const std::vector<Geometry::TriangleFace>& faces, const bool computeMargin) const
 {
-	float innerClusterDistance = clusterDistance * 0.1f;
-	unsigned int amountBladesPerCluster = (unsigned int)glm::ceil((float)amountBlades / (float)amountCluster);
-	std::cout << "Amount Blades Per Cluster " << amountBladesPerCluster << std::endl;
-	unsigned int curAmountBlades = 0;
-
-	for (unsigned int i = 0; i < amountCluster; i++)
+	GrassPatch& grassPatch = *patch.patch;
+	glm::vec3 fMin(FLT_MAX);
+	glm::vec3 fMax(-FLT_MAX);
+	for (unsigned int i = 0; i < grassPatch.anchorFaces.size(); i++)
 	{
-		unsigned int bladesToGenerate = 0;
-		if (curAmountBlades + amountBladesPerCluster <= amountBlades)
+		if (grassPatch.anchorFaces[i] >= faces.size())
 		{
-			if (amountBladesPerCluster % 2 != 0 && amountBladesPerCluster > 1)
-			{
-				bladesToGenerate = amountBladesPerCluster + ((rand() % (int)(amountBladesPerCluster - 1)) - (int)(amountBladesPerCluster / 2));
-			}
-			else
-			{
-				bladesToGenerate = amountBladesPerCluster + ((rand() % (int)(amountBladesPerCluster)) - (int)(amountBladesPerCluster / 2));
-			}
+			continue;
 		}
-		else
+		const Geometry::TriangleFace& f = faces[grassPatch.anchorFaces[i]];
+		for (unsigned int j = 0; j < 3; j++)
 		{
-			bladesToGenerate = amountBlades - curAmountBlades;
+			fMin = glm::min(fMin, f.vertices[j].position);
+			fMax = glm::max(fMax, f.vertices[j].position);
 		}
+	}
+	if (fMin.x > fMax.x || patch.bounds == 0)
+	{
+		return;
+	}
 
-		if (bladesToGenerate > 0)
-		{
-			float curDir = random() * PI_F;
-			float dirIncrease = 2.0f * PI_F / (float)bladesToGenerate;
+	if (computeMargin)
+	{
+		grassPatch.anchorMarginMin = glm::max(fMin - glm::vec3(patch.bounds->xMin, patch.bounds->yMin, patch.bounds->zMin), glm::vec3(0.0f));
+		grassPatch.anchorMarginMax = glm::max(glm::vec3(patch.bounds->xMax, patch.bounds->yMax, patch.bounds->zMax) - fMax, glm::vec3(0.0f));
+	}
+	else
+	{
+		glm::vec3 bMin = fMin - grassPatch.anchorMarginMin;
+		glm::vec3 bMax = fMax + grassPatch.anchorMarginMax;
+		*patch.bounds = BoundingBox(bMin.x, bMax.x, bMin.y, bMax.y, bMin.z, bMax.z);
+	}
+}
 
-			float clusterMinHeight = p.bladeMinHeight + random() * (p.bladeMaxHeight - p.bladeMinHeight);
-			float clusterMaxHeight = p.bladeMinHeight + random() * (p.bladeMaxHeight - p.bladeMinHeight);
-			if (clusterMaxHeight < clusterMinHeight)
+void Grass::Reproject(const std::vector<Geometry::TriangleFace>& faces)
+{
+	bool anchored = false;
+	for (unsigned int i = 0; i < patches.size() && !anchored; i++)
+	{
+		anchored = patches[i].patch->hasAnchors();
+	}
+	if (!anchored || faces.empty())
+	{
+		return;
+	}
+
+	//Per face the three positions and the three directions the blade up vector is interpolated from
+	std::vector<glm::vec4> faceData(faces.size() * REPROJECT_VEC4_PER_FACE);
+	parallelFor((unsigned int)faces.size(), 4096, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const Geometry::TriangleFace& f = faces[i];
+			glm::vec4* data = &faceData[i * REPROJECT_VEC4_PER_FACE];
+			for (unsigned int j = 0; j < 3; j++)
 			{
-				float h = clusterMinHeight;
-				clusterMinHeight = clusterMaxHeight;
-				clusterMaxHeight = h;
+				data[j] = glm::vec4(f.vertices[j].position, 1.0f);
+				data[3 + j] = glm::vec4(f.faceNormal + f.vertices[j].normal, 0.0f);
 			}
+		}
+	});
 
-			float clusterMinWidth = p.bladeMinWidth + random() * (p.bladeMaxWidth - p.bladeMinWidth);
-			float clusterMaxWidth = p.bladeMinWidth + random() * (p.bladeMaxWidth - p.bladeMinWidth);
-			if (clusterMaxWidth < clusterMinWidth)
-			{
+	if (reprojectFaceBuffer == 0)
+	{
+		glGenBuffers(1, &reprojectFaceBuffer);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, reprojectFaceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, faceData.size() * sizeof(glm::vec4), faceData.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	reprojectShader->bind();
+	reprojectShader->setUniform("amountFaces", (GLuint)faces.size());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REPROJECT_FACE_LOCATION, reprojectFaceBuffer);
+	for (unsigned int i = 0; i < patches.size(); i++)
+	{
+		if (patches[i].patch->hasAnchors())
+		{
+			patches[i].patch->reproject(*reprojectShader);
+		}
+	}
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+	parallelFor((unsigned int)patches.size(), 16, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			if (patches[i].patch->hasAnchors())
+			{
+				UpdateAnchorBounds(patches[i], faces, false);
+			}
+		}
+	});
+	UpdateBoundingObject();
+}
+
+void Grass::setCpuForces(const bool enable)
+{
+	for (unsigned int i = 0; i < patches.size(); i++)
+	{
+		if (patches[i].patch->usesCpuForces() != enable)
+		{
+			patches[i].patch->setCpuForces(enable);
+		}
+	}
+}
+
+bool Grass::usesCpuForces() const
+{
+	for (unsigned int i = 0; i < patches.size(); i++)
+	{
+		if (patches[i].patch->usesCpuForces())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+*  Cluster centers are Poisson-disk distributed on the surface. With a density map the centers are thinned out
+*  by the density at their position, so amountCluster is the amount of centers before thinning.
+*/
+void GenerateClusterCenters(const GrassCreateBladeParams& p, const std::vector<Geometry::TriangleFace>& faces, const unsigned int amountCluster, const float clusterDistance, const RandomStream& rng,
+	std::vector<glm::vec3>& clusterPos, std::vector<glm::vec3>& clusterUp, std::vector<glm::vec3>& clusterTangent, std::vector<glm::vec2>& clusterScale, std::vector<unsigned int>& clusterFace)
+{
+	std::vector<SurfacePoissonSampler::Sample> samples;
+	SurfacePoissonSampler(faces).generate(amountCluster, clusterDistance, rng, samples);
+
+	for (unsigned int i = 0; i < samples.size(); i++)
+	{
+		const Geometry::TriangleFace& face = faces[samples[i].face];
+		glm::vec3 barycentric = samples[i].barycentric;
+
+		if (p.densityMap != 0 && rng.uniform(i, DENSITY_BLOCK_CLUSTER_THINNING * 4) >= p.densityMap->sample(interpolateUV(barycentric, face)))
+		{
+			continue;
+		}
+
+		clusterPos.push_back(samples[i].position);
+		clusterUp.push_back(glm::normalize((face.faceNormal + interpolate3G2(barycentric, face.vertices[0].normal, face.vertices[1].normal, face.vertices[2].normal)) * 0.5f));
+		clusterTangent.push_back(glm::normalize(face.vertices[1].position - face.vertices[0].position));
+		clusterScale.push_back(SampleBladeScale(p, face, barycentric));
+		clusterFace.push_back(samples[i].face);
+	}
+}
+
+//Blades of a cluster are anchored to the face of the cluster center, with extrapolated barycentric coordinates if they lie outside
+void GenerateClusterBlades(const GrassCreateBladeParams& p, const RandomStream& rng, const float clusterDistance, unsigned int amountBlades, unsigned int amountCluster, 
+	const std::vector<glm::vec3>& clusterPos, const std::vector<glm::vec3>& clusterUp, const std::vector<glm::vec3>& clusterTangent, const std::vector<glm::vec2>& clusterScale,
+	const std::vector<unsigned int>& clusterFace, const std::vector<Geometry::TriangleFace>& faces, const std::vector<unsigned int>& faceIds, BladeBuffer& blades)
+{
+	float innerClusterDistance = clusterDistance * 0.1f;
+	unsigned int amountBladesPerCluster = (unsigned int)glm::ceil((float)amountBlades / (float)amountCluster);
+	std::cout << "Amount Blades Per Cluster " << amountBladesPerCluster << std::endl;
+	unsigned int curAmountBlades = 0;
+
+	for (unsigned int i = 0; i < amountCluster; i++)
+	{
+		glm::uvec4 bits = rng.bits(i, 0);
+		glm::vec4 rnd = rng.uniform4(i, 1);
+
+		unsigned int bladesToGenerate = 0;
+		if (curAmountBlades + amountBladesPerCluster <= amountBlades)
+		{
+			if (amountBladesPerCluster % 2 != 0 && amountBladesPerCluster > 1)
+			{
+				bladesToGenerate = amountBladesPerCluster + ((int)(bits.x % (amountBladesPerCluster - 1)) - (int)(amountBladesPerCluster / 2));
+			}
+			else
+			{
+				bladesToGenerate = amountBladesPerCluster + ((int)(bits.x % amountBladesPerCluster) - (int)(amountBladesPerCluster / 2));
+			}
+		}
+		else
+		{
+			bladesToGenerate = amountBlades - curAmountBlades;
+		}
+
+		if (bladesToGenerate > 0)
+		{
+			float curDir = RandomStream::toUniform(bits.y) * PI_F;
+			float dirIncrease = 2.0f * PI_F / (float)bladesToGenerate;
+
+			float clusterMinHeight = p.bladeMinHeight + RandomStream::toUniform(bits.z) * (p.bladeMaxHeight - p.bladeMinHeight);
+			float clusterMaxHeight = p.bladeMinHeight + RandomStream::toUniform(bits.w) * (p.bladeMaxHeight - p.bladeMinHeight);
+			if (clusterMaxHeight < clusterMinHeight)
+			{
+				float h = clusterMinHeight;
+				clusterMinHeight = clusterMaxHeight;
+				clusterMaxHeight = h;
+			}
+
+			float clusterMinWidth = p.bladeMinWidth + rnd.x * (p.bladeMaxWidth - p.bladeMinWidth);
+			float clusterMaxWidth = p.bladeMinWidth + rnd.y * (p.bladeMaxWidth - p.bladeMinWidth);
+			if (clusterMaxWidth < clusterMinWidth)
+			{
 				float h = clusterMinWidth;
 				clusterMinWidth = clusterMaxWidth;
 				clusterMaxWidth = h;
 			}
 
-			float clusterMinBend = p.bladeMinBend + random() * (p.bladeMaxBend - p.bladeMinBend);
-			float clusterMaxBend = p.bladeMinBend + random() * (p.bladeMaxBend - p.bladeMinBend);
+			float clusterMinBend = p.bladeMinBend + rnd.z * (p.bladeMaxBend - p.bladeMinBend);
+			float clusterMaxBend = p.bladeMinBend + rnd.w * (p.bladeMaxBend - p.bladeMinBend);
 			if (clusterMaxBend < clusterMinBend)
 			{
 				float h = clusterMinBend;
@@ -601,14 +1028,15 @@ void GenerateClusterBlades(const GrassCreateBladeParams& p, const float clusterD
 					std::cout << "DistributeFaceRandom: THERE IS SOMETHING FISHY HERE " << bladeAlpha << " - " << curDir << std::endl;
 				}
 
-				float bladeHeight = clusterMinHeight + interpolateFac * (clusterMaxHeight - clusterMinHeight);
-				float bladeWidth = clusterMinWidth + interpolateFac * (clusterMaxWidth - clusterMinWidth);
+				float bladeHeight = (clusterMinHeight + interpolateFac * (clusterMaxHeight - clusterMinHeight)) * clusterScale[i].x;
+				float bladeWidth = (clusterMinWidth + interpolateFac * (clusterMaxWidth - clusterMinWidth)) * clusterScale[i].y;
 				float bladeBend = clusterMinBend + interpolateFac * (clusterMaxBend - clusterMinBend);
 
-				bladePositions.push_back(glm::vec4(bladePos, bladeAlpha));
-				bladeAttr.push_back(glm::vec4(clusterUp[i], bladeBend));
-				bladeV1.push_back(glm::vec4(bladePos + clusterUp[i] * bladeHeight, bladeHeight));
-				bladeV2.push_back(glm::vec4(bladePos + clusterUp[i] * bladeHeight, bladeWidth));
+				blades.push_back(glm::vec4(bladePos, bladeAlpha), glm::vec4(bladePos + clusterUp[i] * bladeHeight, bladeHeight), glm::vec4(bladePos + clusterUp[i] * bladeHeight, bladeWidth), glm::vec4(clusterUp[i], bladeBend));
+				if (blades.hasAnchors())
+				{
+					blades.setAnchor(blades.size() - 1, faceIds[clusterFace[i]], Geometry::barycentric(bladePos, faces[clusterFace[i]]));
+				}
 
 				curAmountBlades++;
 
@@ -618,62 +1046,76 @@ void GenerateClusterBlades(const GrassCreateBladeParams& p, const float clusterD
 	}
 }
 
-void Grass::DistributeFaceRandom(const GrassCreateBladeParams& p, std::vector <Geometry::TriangleFace>& faces)
+void Grass::DistributeFaceRandom(const GrassCreateBladeParams& p, const unsigned int streamIndex, const std::vector<Geometry::TriangleFace>& faces, const std::vector<unsigned int>& faceIds, BladeBuffer& blades)
 {
-	std::vector<glm::vec4> bladePositions;
-	std::vector<glm::vec4> bladeAttr;
-	std::vector<glm::vec4> bladeV1;
-	std::vector<glm::vec4> bladeV2;
-
 	float sumArea = 0;
-	float xMin = FLT_MAX, xMax = -FLT_MAX, yMin = FLT_MAX, yMax = -FLT_MAX, zMin = FLT_MAX, zMax = -FLT_MAX;
 	for (unsigned int i = 0; i < faces.size(); i++)
 	{
 		sumArea += faces[i].area;
+	}
 
-		for (unsigned int j = 0; j < 3; j++)
-		{
-			auto v = faces[i].vertices[j].position;
-			xMin = glm::min(xMin, v.x);
-			yMin = glm::min(yMin, v.y);
-			zMin = glm::min(zMin, v.z);
-			xMax = glm::max(xMax, v.x);
-			yMax = glm::max(yMax, v.y);
-			zMax = glm::max(zMax, v.z);
-		}
+	std::vector<float> faceWeights;
+	std::vector<float> faceMax;
+	double sumWeights = ComputeFaceWeights(p, faces, faceWeights, faceMax);
+	if (sumWeights <= 0.0)
+	{
+		std::cout << "Random-face distribution generates no blades, the density map is empty" << std::endl;
+		return;
 	}
 
-	unsigned int amountBlades = glm::max((unsigned int)(sumArea * p.density), 1u);
+	unsigned int amountBlades = glm::max((unsigned int)(sumWeights * p.density), 1u);
 	std::cout << "Random-face distribution generates " << amountBlades << " blades" << std::endl;
-	bladePositions.reserve(amountBlades);
-	bladeAttr.reserve(amountBlades);
-	bladeV1.reserve(amountBlades);
-	bladeV2.reserve(amountBlades);
+	if (p.attachToFaces)
+	{
+		blades.enableAnchors();
+	}
+	blades.reserve(amountBlades);
+
+	//Faces are picked proportional to their area, weighted by the density map
+	AliasTable faceSampler(faceWeights);
 
 	switch (p.distribution)
 	{
 	case GrassDistribution::UNIFORM:
 		{
-			for (unsigned int i = 0; i < amountBlades; i++)
+			blades.resize(amountBlades);
+
+			//Blade i only depends on the seed and i, so the result does not depend on the amount of threads
+			RandomStream rng(p.seed, randomStreamIndex(streamIndex, RANDOM_STREAM_BLADES));
+
+			parallelFor(amountBlades, GENERATION_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int)
 			{
-				Geometry::TriangleFace face = faces[rand() % faces.size()];
+				for (unsigned int i = begin; i < end; i++)
+				{
+					glm::vec4 rnd = rng.uniform4(i, 1);
 
-				glm::vec3 barycentric = glm::vec3(random(), random(), random());
-				barycentric /= barycentric.x + barycentric.y + barycentric.z;
+					unsigned int faceIndex = 0;
+					glm::vec3 barycentric;
+					SampleDensity(p, faces, faceMax, rng, i, [&](const unsigned int block, unsigned int& f, glm::vec3& b)
+					{
+						glm::uvec4 bits = rng.bits(i, block);
+						f = faceSampler.sample(bits.x, RandomStream::toUniform(bits.y));
+						b = Geometry::uniformBarycentric(RandomStream::toUniform(bits.z), RandomStream::toUniform(bits.w));
+					}, faceIndex, barycentric);
 
-				glm::vec3 bladePos = interpolate3G2(barycentric, face.vertices[0].position, face.vertices[1].position, face.vertices[2].position);
-				glm::vec3 bladeUp = glm::normalize((face.faceNormal + interpolate3G2(barycentric, face.vertices[0].normal, face.vertices[1].normal, face.vertices[2].normal)) * 0.5f);
-			
-				float dirAlpha = random() * PI_F * 2.0f;
-				float height = p.bladeMinHeight + random() * (p.bladeMaxHeight - p.bladeMinHeight);
-				float width = p.bladeMinWidth + random() * (p.bladeMaxWidth - p.bladeMinWidth);
-				float bend = p.bladeMinBend + random() * (p.bladeMaxBend - p.bladeMinBend);
-
-				bladePositions.push_back(glm::vec4(bladePos, dirAlpha));
-				bladeAttr.push_back(glm::vec4(bladeUp, bend));
-				bladeV1.push_back(glm::vec4(bladePos + bladeUp * height, height));
-				bladeV2.push_back(glm::vec4(bladePos + bladeUp * height, width));
-			}
+					const Geometry::TriangleFace& face = faces[faceIndex];
+
+					glm::vec3 bladePos = interpolate3G2(barycentric, face.vertices[0].position, face.vertices[1].position, face.vertices[2].position);
+					glm::vec3 bladeUp = glm::normalize((face.faceNormal + interpolate3G2(barycentric, face.vertices[0].normal, face.vertices[1].normal, face.vertices[2].normal)) * 0.5f);
+
+					float dirAlpha = rnd.x * PI_F * 2.0f;
+					glm::vec2 scale = SampleBladeScale(p, face, barycentric);
+					float height = (p.bladeMinHeight + rnd.y * (p.bladeMaxHeight - p.bladeMinHeight)) * scale.x;
+					float width = (p.bladeMinWidth + rnd.z * (p.bladeMaxWidth - p.bladeMinWidth)) * scale.y;
+					float bend = p.bladeMinBend + rnd.w * (p.bladeMaxBend - p.bladeMinBend);
+
+					blades.set(i, glm::vec4(bladePos, dirAlpha), glm::vec4(bladePos + bladeUp * height, height), glm::vec4(bladePos + bladeUp * height, width), glm::vec4(bladeUp, bend));
+					if (p.attachToFaces)
+					{
+						blades.setAnchor(i, faceIds[faceIndex], barycentric);
+					}
+				}
+			});
 		}
 		break;
 	case GrassDistribution::CLUSTER:
@@ -681,131 +1123,118 @@ void Grass::DistributeFaceRandom(const GrassCreateBladeParams& p, std::vector <G
 			std::vector<glm::vec3> clusterPos;
 			std::vector<glm::vec3> clusterUp;
 			std::vector<glm::vec3> clusterTangent;
+			std::vector<glm::vec2> clusterScale;
+			std::vector<unsigned int> clusterFace;
 
 			unsigned int amountCluster = glm::max((unsigned int)(amountBlades * p.clusterPercentage), 1u);
+			//Centers in bare regions are thinned out again
+			unsigned int amountCandidates = glm::max((unsigned int)((double)amountCluster * sumArea / sumWeights), amountCluster);
 
-			clusterPos.reserve(amountCluster);
-			clusterUp.reserve(amountCluster);
-			clusterTangent.reserve(amountCluster);
+			clusterPos.reserve(amountCandidates);
+			clusterUp.reserve(amountCandidates);
+			clusterTangent.reserve(amountCandidates);
+			clusterScale.reserve(amountCandidates);
+			clusterFace.reserve(amountCandidates);
 
-			float clusterDistance = (glm::sqrt(sumArea) / glm::sqrt((float)amountCluster));
-			float curClusterDistance = clusterDistance;
+			float clusterDistance = (glm::sqrt(sumArea) / glm::sqrt((float)amountCandidates));
 
-			Grid3D grid(xMin, xMax, yMin, yMax, zMin, zMax, clusterDistance);
+			GenerateClusterCenters(p, faces, amountCandidates, clusterDistance, RandomStream(p.seed, randomStreamIndex(streamIndex, RANDOM_STREAM_CLUSTER_CENTERS)), clusterPos, clusterUp, clusterTangent, clusterScale, clusterFace);
 
-			unsigned int curAmountCluster = 0;
-			unsigned int invalidCount = 0;
-			unsigned int curInvalidCount = 0;
-			while (curAmountCluster < amountCluster)
+			if (clusterPos.size() > 0)
 			{
-				if (curInvalidCount > amountCluster / 10)
-				{
-					curClusterDistance *= 0.9f;
-					curInvalidCount = 0;
-				}
-
-				Geometry::TriangleFace face = faces[rand() % faces.size()];
-
-				glm::vec3 barycentric = glm::vec3(random(), random(), random());
-				barycentric /= barycentric.x + barycentric.y + barycentric.z;
-
-				glm::vec3 pos = interpolate3G2(barycentric, face.vertices[0].position, face.vertices[1].position, face.vertices[2].position);
-				glm::vec3 up = glm::normalize((face.faceNormal + interpolate3G2(barycentric, face.vertices[0].normal, face.vertices[1].normal, face.vertices[2].normal)) * 0.5f);
-				glm::vec3 tan = glm::normalize(face.vertices[1].position - face.vertices[0].position);
-
-				//Check for distances
-				bool valid = true;
-				auto listAdjacentClusters = grid.getCandidates(pos);
-				for each (glm::vec3 p in listAdjacentClusters)
-				{
-					if (glm::distance(p, pos) < curClusterDistance)
-					{
-						valid = false;
-						break;
-					}
-				}
-
-				if (valid)
-				{
-					curAmountCluster++;
-					clusterPos.push_back(pos);
-					clusterUp.push_back(up);
-					clusterTangent.push_back(tan);
-					grid.insert(pos);
-				}
-				else
-				{
-					invalidCount++;
-					curInvalidCount++;
-				}
+				GenerateClusterBlades(p, RandomStream(p.seed, randomStreamIndex(streamIndex, RANDOM_STREAM_CLUSTER_BLADES)), clusterDistance, amountBlades, (unsigned int)clusterPos.size(), clusterPos, clusterUp, clusterTangent, clusterScale, clusterFace, faces, faceIds, blades);
 			}
-
-			GenerateClusterBlades(p, clusterDistance, amountBlades, amountCluster, clusterPos, clusterUp, clusterTangent, bladePositions, bladeV1, bladeV2, bladeAttr);
 		}
 		break;
 	}
-
-	GeneratePatches(bladePositions, bladeV1, bladeV2, bladeAttr, p.shape, p.tessellationProps);
 }
 
-void Grass::DistributeFaceArea(const GrassCreateBladeParams& p, std::vector <Geometry::TriangleFace>& faces)
+void Grass::DistributeFaceArea(const GrassCreateBladeParams& p, const unsigned int streamIndex, const std::vector<Geometry::TriangleFace>& faces, const std::vector<unsigned int>& faceIds, BladeBuffer& blades)
 {
-	std::vector<glm::vec4> bladePositions;
-	std::vector<glm::vec4> bladeAttr;
-	std::vector<glm::vec4> bladeV1;
-	std::vector<glm::vec4> bladeV2;
-
 	float sumArea = 0;
 	for (unsigned int i = 0; i < faces.size(); i++)
 	{
 		sumArea += faces[i].area;
 	}
 
-	unsigned int amountBlades = glm::max((unsigned int)(sumArea * p.density), 1u);
+	std::vector<float> faceWeights;
+	std::vector<float> faceMax;
+	double sumWeights = ComputeFaceWeights(p, faces, faceWeights, faceMax);
+	if (sumWeights <= 0.0)
+	{
+		std::cout << "Area-face distribution generates no blades, the density map is empty" << std::endl;
+		return;
+	}
+
+	unsigned int amountBlades = glm::max((unsigned int)(sumWeights * p.density), 1u);
 	std::cout << "Area-face distribution generates " << amountBlades << " blades" << std::endl;
-	bladePositions.reserve(amountBlades);
-	bladeAttr.reserve(amountBlades);
-	bladeV1.reserve(amountBlades);
-	bladeV2.reserve(amountBlades);
+	if (p.attachToFaces)
+	{
+		blades.enableAnchors();
+	}
+	blades.reserve(amountBlades);
 
 	switch (p.distribution)
 	{
 	case GrassDistribution::UNIFORM:
 		{
+			RandomStream rng(p.seed, randomStreamIndex(streamIndex, RANDOM_STREAM_BLADES));
+
+			//Only needed for the remaining blades if a density map makes faces unequal
+			AliasTable faceSampler;
+			if (p.densityMap != 0)
+			{
+				faceSampler.build(faceWeights);
+			}
+
+			auto addBlade = [&](const unsigned int element, const unsigned int block, const unsigned int faceIndex, const glm::vec3& barycentric)
+			{
+				const Geometry::TriangleFace& face = faces[faceIndex];
+				glm::vec4 rnd0 = rng.uniform4(element, block);
+				glm::vec4 rnd1 = rng.uniform4(element, 1);
+
+				glm::vec3 bladePos = interpolate3G2(barycentric, face.vertices[0].position, face.vertices[1].position, face.vertices[2].position);
+				glm::vec3 bladeUp = glm::normalize((face.faceNormal + interpolate3G2(barycentric, face.vertices[0].normal, face.vertices[1].normal, face.vertices[2].normal)) * 0.5f);
+
+				glm::vec2 scale = SampleBladeScale(p, face, barycentric);
+				float dirAlpha = rnd0.w * PI_F * 2.0f;
+				float height = (p.bladeMinHeight + rnd1.x * (p.bladeMaxHeight - p.bladeMinHeight)) * scale.x;
+				float width = (p.bladeMinWidth + rnd1.y * (p.bladeMaxWidth - p.bladeMinWidth)) * scale.y;
+				float bend = p.bladeMinBend + rnd1.z * (p.bladeMaxBend - p.bladeMinBend);
+
+				blades.push_back(glm::vec4(bladePos, dirAlpha), glm::vec4(bladePos + bladeUp * height, height), glm::vec4(bladePos + bladeUp * height, width), glm::vec4(bladeUp, bend));
+				if (p.attachToFaces)
+				{
+					blades.setAnchor(blades.size() - 1, faceIds[faceIndex], barycentric);
+				}
+			};
+
 			float sumCurArea = 0.0f;
 			unsigned int curAmountBlades = 0;
 			std::vector<unsigned int> facesWithoutBlades;
 			for (unsigned int i = 0; i < faces.size(); i++)
 			{
-				sumCurArea += faces[i].area;
+				sumCurArea += faceWeights[i];
 				float curBlades = sumCurArea * p.density;
 				if (curBlades >= 1.0f)
 				{
 					for (unsigned int j = 0; j < (unsigned int)curBlades; j++)
 					{
-						Geometry::TriangleFace face = faces[i];
-
-						glm::vec3 barycentric = glm::vec3(random(), random(), random());
-						barycentric /= barycentric.x + barycentric.y + barycentric.z;
-
-						glm::vec3 bladePos = interpolate3G2(barycentric, face.vertices[0].position, face.vertices[1].position, face.vertices[2].position);
-						glm::vec3 bladeUp = glm::normalize((face.faceNormal + interpolate3G2(barycentric, face.vertices[0].normal, face.vertices[1].normal, face.vertices[2].normal)) * 0.5f);
-
-						float dirAlpha = random() * PI_F * 2.0f;
-						float height = p.bladeMinHeight + random() * (p.bladeMaxHeight - p.bladeMinHeight);
-						float width = p.bladeMinWidth + random() * (p.bladeMaxWidth - p.bladeMinWidth);
-						float bend = p.bladeMinBend + random() * (p.bladeMaxBend - p.bladeMinBend);
+						unsigned int faceIndex = i;
+						glm::vec3 barycentric;
+						unsigned int acceptedBlock = SampleDensity(p, faces, faceMax, rng, curAmountBlades, [&](const unsigned int block, unsigned int& f, glm::vec3& b)
+						{
+							b = glm::vec3(rng.uniform4(curAmountBlades, block));
+							b /= b.x + b.y + b.z;
+						}, faceIndex, barycentric);
 
-						bladePositions.push_back(glm::vec4(bladePos, dirAlpha));
-						bladeAttr.push_back(glm::vec4(bladeUp, bend));
-						bladeV1.push_back(glm::vec4(bladePos + bladeUp * height, height));
-						bladeV2.push_back(glm::vec4(bladePos + bladeUp * height, width));
+						addBlade(curAmountBlades, acceptedBlock, i, barycentric);
 
 						curAmountBlades++;
 					}
 					sumCurArea -= (float)((unsigned int)curBlades) / p.density;
 				}
-				else
+				else if (faceWeights[i] > 0.0f)
 				{
 					facesWithoutBlades.push_back(i);
 				}
@@ -813,287 +1242,71 @@ void Grass::DistributeFaceArea(const GrassCreateBladeParams& p, std::vector <Geo
 			//Distribute if there are additional blades
 			for (unsigned int i = curAmountBlades; i < amountBlades; i++)
 			{
+				glm::uvec4 faceBits = rng.bits(i, 2);
+
 				unsigned int faceIndex = 0;
 				if (facesWithoutBlades.size() > 0)
 				{
-					unsigned int fwobIndex = rand() % facesWithoutBlades.size();
+					unsigned int fwobIndex = faceBits.x % facesWithoutBlades.size();
 					faceIndex = facesWithoutBlades[fwobIndex];
 					facesWithoutBlades.erase(facesWithoutBlades.begin() + fwobIndex);
 				}
+				else if (p.densityMap != 0)
+				{
+					faceIndex = faceSampler.sample(faceBits.x, RandomStream::toUniform(faceBits.y));
+				}
 				else
 				{
-					faceIndex = rand() % faces.size();
+					faceIndex = faceBits.x % faces.size();
 				}
-				Geometry::TriangleFace face = faces[faceIndex];
-
-				glm::vec3 barycentric = glm::vec3(random(), random(), random());
-				barycentric /= barycentric.x + barycentric.y + barycentric.z;
-
-				glm::vec3 bladePos = interpolate3G2(barycentric, face.vertices[0].position, face.vertices[1].position, face.vertices[2].position);
-				glm::vec3 bladeUp = glm::normalize((face.faceNormal + interpolate3G2(barycentric, face.vertices[0].normal, face.vertices[1].normal, face.vertices[2].normal)) * 0.5f);
 
-				float dirAlpha = random() * PI_F * 2.0f;
-				float height = p.bladeMinHeight + random() * (p.bladeMaxHeight - p.bladeMinHeight);
-				float width = p.bladeMinWidth + random() * (p.bladeMaxWidth - p.bladeMinWidth);
-				float bend = p.bladeMinBend + random() * (p.bladeMaxBend - p.bladeMinBend);
+				glm::vec3 barycentric;
+				unsigned int acceptedBlock = SampleDensity(p, faces, faceMax, rng, i, [&](const unsigned int block, unsigned int& f, glm::vec3& b)
+				{
+					b = glm::vec3(rng.uniform4(i, block));
+					b /= b.x + b.y + b.z;
+				}, faceIndex, barycentric);
 
-				bladePositions.push_back(glm::vec4(bladePos, dirAlpha));
-				bladeAttr.push_back(glm::vec4(bladeUp, bend));
-				bladeV1.push_back(glm::vec4(bladePos + bladeUp * height, height));
-				bladeV2.push_back(glm::vec4(bladePos + bladeUp * height, width));
+				addBlade(i, acceptedBlock, faceIndex, barycentric);
 			}
 		}
 		break;
 	case GrassDistribution::CLUSTER:
 		{
-			float xMin = FLT_MAX, xMax = -FLT_MAX, yMin = FLT_MAX, yMax = -FLT_MAX, zMin = FLT_MAX, zMax = -FLT_MAX;
-			for (unsigned int i = 0; i < faces.size(); i++)
-			{
-				Geometry::TriangleFace f1 = faces[i];
-
-				for (unsigned int j = 0; j < 3; j++)
-				{
-					auto v = f1.vertices[j].position;
-					xMin = glm::min(xMin, v.x);
-					yMin = glm::min(yMin, v.y);
-					zMin = glm::min(zMin, v.z);
-					xMax = glm::max(xMax, v.x);
-					yMax = glm::max(yMax, v.y);
-					zMax = glm::max(zMax, v.z);
-				}
-			}
-
 			std::vector<glm::vec3> clusterPos;
 			std::vector<glm::vec3> clusterUp;
 			std::vector<glm::vec3> clusterTangent;
+			std::vector<glm::vec2> clusterScale;
+			std::vector<unsigned int> clusterFace;
 
 			unsigned int amountCluster = glm::max((unsigned int)(amountBlades * p.clusterPercentage), 1u);
+			//Centers in bare regions are thinned out again
+			unsigned int amountCandidates = glm::max((unsigned int)((double)amountCluster * sumArea / sumWeights), amountCluster);
 
-			clusterPos.reserve(amountCluster);
-			clusterUp.reserve(amountCluster);
-			clusterTangent.reserve(amountCluster);
+			clusterPos.reserve(amountCandidates);
+			clusterUp.reserve(amountCandidates);
+			clusterTangent.reserve(amountCandidates);
+			clusterScale.reserve(amountCandidates);
+			clusterFace.reserve(amountCandidates);
 
-			float clusterDistance = (glm::sqrt(sumArea) / glm::sqrt((float)amountCluster));
-			float curClusterDistance = clusterDistance;
+			float clusterDistance = (glm::sqrt(sumArea) / glm::sqrt((float)amountCandidates));
 
-			Grid3D grid(xMin, xMax, yMin, yMax, zMin, zMax, clusterDistance);
+			GenerateClusterCenters(p, faces, amountCandidates, clusterDistance, RandomStream(p.seed, randomStreamIndex(streamIndex, RANDOM_STREAM_CLUSTER_CENTERS)), clusterPos, clusterUp, clusterTangent, clusterScale, clusterFace);
 
-			unsigned int curAmountCluster = 0;
-			unsigned int invalidCount = 0;
-			unsigned int curFace = 0;
-			unsigned int faceIter = 0;
-			unsigned int curFaceIter = 0;
-			std::vector<unsigned int> facesWithoutCluster;
-			unsigned int * clusterCentersInFace = new unsigned int[faces.size()];
-			std::fill(clusterCentersInFace, clusterCentersInFace + faces.size(), 0u);
-			while (curAmountCluster < amountCluster)
+			if (clusterPos.size() > 0)
 			{
-				if (curFaceIter == 1)
-				{
-					curClusterDistance *= 0.90f;
-					curFaceIter = 0;
-				}
-
-				if (faces[curFace].area > clusterDistance)
-				{
-					//try to generate cluster center
-					//if generated try to distribute other cluster
-					Geometry::TriangleFace f = faces[curFace];
-					unsigned int clusterCentersToCreate = 1;
-					float diag = glm::sqrt(2.0f * f.area);
-					if (diag > curClusterDistance)
-					{
-						clusterCentersToCreate = (unsigned int)(glm::ceil(diag / curClusterDistance));
-					}
-					clusterCentersToCreate = glm::max(clusterCentersToCreate - clusterCentersInFace[curFace], 0u);
-
-					for (unsigned int i = 0; i < clusterCentersToCreate; i++)
-					{
-						if (curAmountCluster < amountCluster)
-						{
-							glm::vec3 barycentric = glm::vec3(random(), random(), random());
-							barycentric /= barycentric.x + barycentric.y + barycentric.z;
-
-							glm::vec3 pos = interpolate3G2(barycentric, f.vertices[0].position, f.vertices[1].position, f.vertices[2].position);
-							glm::vec3 up = glm::normalize((f.faceNormal + interpolate3G2(barycentric, f.vertices[0].normal, f.vertices[1].normal, f.vertices[2].normal)) * 0.5f);
-							glm::vec3 tan = glm::normalize(f.vertices[1].position - f.vertices[0].position);
-
-							bool valid = true;
-							auto listAdjacentClusters = grid.getCandidates(pos);
-							for each (glm::vec3 p in listAdjacentClusters)
-							{
-								if (glm::distance(p, pos) < curClusterDistance)
-								{
-									valid = false;
-									break;
-								}
-							}
-
-							if (valid)
-							{
-								curAmountCluster++;
-								clusterPos.push_back(pos);
-								clusterUp.push_back(up);
-								clusterTangent.push_back(tan);
-								grid.insert(pos);
-
-								clusterCentersInFace[curFace]++;
-							}
-							else
-							{
-								invalidCount++;
-							}
-						}
-						else
-						{
-							break;
-						}
-					}
-				}
-				else
-				{
-					facesWithoutCluster.push_back(curFace);
-				}
-				curFace++;
-				if (curFace == faces.size())
-				{
-					std::cout << "One iteration finished - Current amount of clusters: " << curAmountCluster << " out of " << amountCluster << std::endl;
-					faceIter++;
-					curFaceIter++;
-					curFace = 0;
-					//Process Faces without Clusters
-					for (unsigned int i = 0; i < facesWithoutCluster.size(); i++)
-					{
-						//Only process if there is really no cluster in this face (could have been distributed from nearby faces)
-						if (clusterCentersInFace[facesWithoutCluster[i]] == 0)
-						{
-							if (curAmountCluster < amountCluster)
-							{
-								Geometry::TriangleFace f = faces[facesWithoutCluster[i]];
-
-								glm::vec3 barycentric = glm::vec3(random(), random(), random());
-								barycentric /= barycentric.x + barycentric.y + barycentric.z;
-
-								glm::vec3 pos = interpolate3G2(barycentric, f.vertices[0].position, f.vertices[1].position, f.vertices[2].position);
-								glm::vec3 up = glm::normalize((f.faceNormal + interpolate3G2(barycentric, f.vertices[0].normal, f.vertices[1].normal, f.vertices[2].normal)) * 0.5f);
-								glm::vec3 tan = glm::normalize(f.vertices[1].position - f.vertices[0].position);
-
-								bool valid = true;
-								auto listAdjacentClusters = grid.getCandidates(pos);
-								for each (glm::vec3 p in listAdjacentClusters)
-								{
-									if (glm::distance(p, pos) < curClusterDistance)
-									{
-										valid = false;
-										break;
-									}
-								}
-
-								if (valid)
-								{
-									curAmountCluster++;
-									clusterPos.push_back(pos);
-									clusterUp.push_back(up);
-									clusterTangent.push_back(tan);
-									grid.insert(pos);
-
-									clusterCentersInFace[curFace]++;
-								}
-								else
-								{
-									invalidCount++;
-								}
-							}
-							else
-							{
-								break;
-							}
-						}
-					}
-				}
+				GenerateClusterBlades(p, RandomStream(p.seed, randomStreamIndex(streamIndex, RANDOM_STREAM_CLUSTER_BLADES)), clusterDistance, amountBlades, (unsigned int)clusterPos.size(), clusterPos, clusterUp, clusterTangent, clusterScale, clusterFace, faces, faceIds, blades);
 			}
-
-			GenerateClusterBlades(p, clusterDistance, amountBlades, amountCluster, clusterPos, clusterUp, clusterTangent, bladePositions, bladeV1, bladeV2, bladeAttr);
-
-			delete[] clusterCentersInFace;
 		}
 		break;
 	}
-
-	GeneratePatches(bladePositions, bladeV1, bladeV2, bladeAttr, p.shape, p.tessellationProps);
 }
 
-#ifdef PARTITIONING_BY_CLUSTERING
-struct {
-	bool operator()(std::pair<unsigned int, float>& a, std::pair<unsigned int, float>& b)
-	{
-		return a.second < b.second;
-	}
-} sortingFunc;
-
-void ProcessCluster(const unsigned int t, const unsigned int amountTiles, const unsigned int bladesPerTile, const bool* clusterSwapped, const std::vector<std::vector<unsigned int>>& clusterIndices, const std::vector<glm::vec4>& bladePositions, const float* clusterCounts, glm::vec3* clusterMeans, glm::vec3** swapCandidates, float** swapCandidatesDist, unsigned int** swapCandidatesIdx)
+void Grass::BuildPatches(BladeBuffer blades, const GrassCreateBladeParams& params, const unsigned int maxBlades, const unsigned int firstSourceId, GeneratedPatches& generated)
 {
-	const std::vector<unsigned int>& ind = clusterIndices[t];
-	if (clusterSwapped[t])
-	{
-		clusterMeans[t] = glm::vec3(0.0f);
-		for (unsigned int i = 0; i < ind.size(); i++)
-		{
-			clusterMeans[t] += glm::vec3(bladePositions[ind[i]].xyz) / clusterCounts[t];
-		}
-	}
-
-	std::vector<std::pair<unsigned int, float>> swapCandidateHelper;
-	swapCandidateHelper.reserve(bladesPerTile + 1);
-	for (unsigned int s = 0; s < amountTiles; s++)
-	{
-		if (clusterSwapped[t] || clusterSwapped[s])
-		{
-			swapCandidateHelper.clear();
-			for (unsigned int i = 0; i < ind.size(); i++)
-			{
-				if (USE_MANHATTEN_DISTANCE)
-				{
-					float d1 = manDist(bladePositions[ind[i]].xyz, clusterMeans[s]);
-					float d2 = manDist(bladePositions[ind[i]].xyz, clusterMeans[t]);
-					float dist = d1*d1 - d2*d2;
-					swapCandidateHelper.push_back(std::pair<unsigned int, float>(i, dist));
-				}
-				else
-				{
-					glm::vec3 vec = bladePositions[ind[i]].xyz - clusterMeans[s];
-					glm::vec3 vec2 = bladePositions[ind[i]].xyz - clusterMeans[t];
-					float dist = glm::dot(vec, vec) - glm::dot(vec2, vec2);
-					swapCandidateHelper.push_back(std::pair<unsigned int, float>(i, dist));
-				}
-			}
-			std::sort(swapCandidateHelper.begin(), swapCandidateHelper.end(), sortingFunc);
-
-			swapCandidatesIdx[t][s] = ind[swapCandidateHelper[0].first];
-			swapCandidates[t][s] = bladePositions[ind[swapCandidateHelper[0].first]].xyz;
-			if (USE_MANHATTEN_DISTANCE)
-			{
-				float d = manDist(bladePositions[ind[swapCandidateHelper[0].first]].xyz, clusterMeans[t]);
-				swapCandidatesDist[t][s] = d*d;
-			}
-			else
-			{
-				glm::vec3 vec = bladePositions[ind[swapCandidateHelper[0].first]].xyz - clusterMeans[t];
-				swapCandidatesDist[t][s] = glm::dot(vec, vec);
-			}
-		}
-	}
-}
-#endif
-
-void Grass::GeneratePatches(std::vector<glm::vec4>& bladePositions, std::vector<glm::vec4>& bladeV1, std::vector<glm::vec4>& bladeV2, std::vector<glm::vec4>& bladeAttr, const BladeShape shape, const glm::vec4& tessellationProps)
-{
-	unsigned int amountBlades = bladePositions.size();
-
-	if (amountBlades != bladeV1.size() || amountBlades != bladeV2.size() || amountBlades != bladeAttr.size())
-	{
-		std::cout << "GeneratePatches: THERE IS SOMETHING FISHY HERE" << std::endl;
-	}
+	unsigned int amountBlades = blades.size();
+	const glm::vec4* bladePositions = blades.position();
+	const glm::vec4* bladeV1 = blades.v1();
 
 	float xMin = FLT_MAX;
 	float yMin = FLT_MAX;
@@ -1101,7 +1314,7 @@ void Grass::GeneratePatches(std::vector<glm::vec4>& bladePositions, std::vector<
 	float xMax = FLT_MIN;
 	float yMax = FLT_MIN;
 	float zMax = FLT_MIN;
-	for (unsigned int i = 0; i < bladePositions.size(); i++)
+	for (unsigned int i = 0; i < amountBlades; i++)
 	{
 		glm::vec3 pos = bladePositions[i].xyz;
 		float height = bladeV1[i].w;
@@ -1118,347 +1331,153 @@ void Grass::GeneratePatches(std::vector<glm::vec4>& bladePositions, std::vector<
 	}
 
 	//TILING
-	if (amountBlades > maxAmountBlades)
+	if (amountBlades > maxBlades && amountBlades >= (unsigned int)Shader::max_work_group_size_X * (unsigned int)OPTIMAL_TILE_FACTOR)
 	{
-		if (amountBlades >= (unsigned int)Shader::max_work_group_size_X * (unsigned int)OPTIMAL_TILE_FACTOR)
+		//Make tiles
+		unsigned int tileSize = (unsigned int)Shader::max_work_group_size_X * (unsigned int)OPTIMAL_TILE_FACTOR;
+		if (params.autoTuneTileSize)
 		{
-			//Make tiles
-			unsigned int amountTiles = (unsigned int)glm::ceil(amountBlades / ((float)Shader::max_work_group_size_X * (float)OPTIMAL_TILE_FACTOR));
-			std::cout << "Amount blades " << amountBlades << " makes " << amountTiles << " tiles." << std::endl;
-			unsigned int bladesPerTile = amountBlades / amountTiles;
-
-#ifdef EVALUATE_MSE
-			float meanSquaredError = 0.0f;
-#endif
-
-#ifdef PARTITIONING_BY_CLUSTERING
-			//Idee von http://statistical-research.com/spatial-clustering-with-equal-sizes/
-			int* clusterId = new int[amountBlades];
-			std::fill_n(clusterId, amountBlades, -1);
-
-			//Assign initial clusters
-			std::vector<std::pair<unsigned int, float>> sortedCandidates;
-			sortedCandidates.reserve(amountBlades);
-			float xRange = xMax - xMin;
-			float yRange = yMax - yMin;
-			float zRange = zMax - zMin;
-			for (unsigned int i = 0; i < amountBlades; i++)
+			std::vector<unsigned int> candidates;
+			for (unsigned int i = 0; i < sizeof(autoTuneTileFactors) / sizeof(autoTuneTileFactors[0]); i++)
 			{
-				if (xRange >= yRange && xRange >= zRange)
-					sortedCandidates.push_back(std::pair<unsigned int, float>(i, bladePositions[i].x));
-				else if (yRange >= xRange && yRange >= zRange)
-					sortedCandidates.push_back(std::pair<unsigned int, float>(i, bladePositions[i].y));
-				else 
-					sortedCandidates.push_back(std::pair<unsigned int, float>(i, bladePositions[i].z));
+				candidates.push_back((unsigned int)Shader::max_work_group_size_X * autoTuneTileFactors[i]);
 			}
-			std::sort(sortedCandidates.begin(), sortedCandidates.end(), sortingFunc);
-			
-			int currentCluster = 0;
-			std::vector<std::pair<unsigned int, float>> clusterCandidates;
-			clusterCandidates.reserve(amountBlades - 1);
-			glm::vec3* clusterMeans = new glm::vec3[amountTiles];
-			for (unsigned int i = 0; i < amountBlades && (unsigned int)currentCluster < amountTiles; i++)
-			{
-				//if (clusterId[i] == -1)
-				if (clusterId[sortedCandidates[i].first] == -1)
-				{
-					//clusterId[i] = currentCluster;
-					clusterId[sortedCandidates[i].first] = currentCluster;
-					//clusterMeans[currentCluster] += glm::vec3(bladePositions[i].xyz) / (float)(bladesPerTile - 1);
-					clusterMeans[currentCluster] += glm::vec3(bladePositions[sortedCandidates[i].first].xyz) / (float)(bladesPerTile - 1);
-					clusterCandidates.clear();
-					for (unsigned int j = 0; j < amountBlades; j++)
-					{
-						//if (i != j && clusterId[j] == -1)
-						if (i != j && clusterId[sortedCandidates[j].first] == -1)
-						{
-							if (USE_MANHATTEN_DISTANCE)
-							{
-								//clusterCandidates.push_back(std::pair<unsigned int, float>(j, manDist(bladePositions[j].xyz, bladePositions[i].xyz)));
-								float d = manDist(bladePositions[sortedCandidates[j].first].xyz, bladePositions[sortedCandidates[i].first].xyz);
-								clusterCandidates.push_back(std::pair<unsigned int, float>(j, d*d));
-							}
-							else
-							{
-								//glm::vec3 vec = bladePositions[j].xyz - bladePositions[i].xyz;
-								glm::vec3 vec = bladePositions[sortedCandidates[j].first].xyz - bladePositions[sortedCandidates[i].first].xyz;
-								clusterCandidates.push_back(std::pair<unsigned int, float>(j, glm::dot(vec,vec)));
-							}
-						}
-					}
-					std::sort(clusterCandidates.begin(), clusterCandidates.end(), sortingFunc);
-
-
-					for (unsigned int c = 0; c < bladesPerTile-1; c++)
-					{
-						//clusterId[clusterCandidates[c].first] = currentCluster;
-						clusterId[sortedCandidates[clusterCandidates[c].first].first] = currentCluster;
-					}
-					currentCluster++;
-					//std::cout << "Cluster " << currentCluster << " initially finished" << std::endl;
-				}
-			}
-
-			for (unsigned int rest = 0; rest < amountBlades; rest++)
-			{
-				if (clusterId[rest] == -1)
-				{
-					unsigned int minCluster;
-					float minDist = FLT_MAX;
-					for (unsigned int i = 0; i < amountTiles; i++)
-					{
-						float dist;
-						if (USE_MANHATTEN_DISTANCE)
-						{
-							dist = manDist(clusterMeans[i], bladePositions[rest].xyz);
-						}
-						else
-						{
-							glm::vec3 vec = clusterMeans[i] - bladePositions[rest].xyz;
-							dist = glm::dot(vec, vec);
-						}
-						if (dist < minDist)
-						{
-							minDist = dist;
-							minCluster = i;
-						}
-					}
-					clusterId[rest] = minCluster;
-				}
-			}
-
-			//Swap between clusters to make the overall result better
-			glm::vec3** swapCandidates = new glm::vec3*[amountTiles];
-			float** swapCandidatesDist = new float*[amountTiles];
-			unsigned int** swapCandidatesIdx = new unsigned int*[amountTiles];
-			float* clusterCounts = new float[amountTiles];
-			bool* clusterSwapped = new bool[amountTiles];
-			std::fill_n(clusterSwapped, amountTiles, true);
-			std::vector<std::vector<unsigned int>> clusterIndices;
-			clusterIndices.reserve(amountTiles);
-			for (unsigned int i = 0; i < amountTiles; i++)
-			{
-				clusterIndices.push_back(std::vector<unsigned int>());
-				clusterIndices[i].reserve(bladesPerTile + 1);
-				swapCandidates[i] = new glm::vec3[amountTiles];
-				swapCandidatesDist[i] = new float[amountTiles];
-				swapCandidatesIdx[i] = new unsigned int[amountTiles];
-			}
-			for (unsigned int i = 0; i < amountBlades; i++)
-			{
-				clusterCounts[clusterId[i]]++;
-				clusterIndices[clusterId[i]].push_back(i);
-			}
-
-			std::ofstream debug(GENERATEDFILESPATH + "Debug.txt");
-
-			unsigned int iteration = 0;
-			bool clusterWasSwapped = true;
-			std::vector<std::pair<unsigned int, float>> swapCandidateHelper;
-			swapCandidateHelper.reserve(bladesPerTile + 1);
-			ThreadPool pool = ThreadPool(8);
-			Clock whileTimeCount;
-			whileTimeCount.Tick();
-			while (iteration < 0 && clusterWasSwapped)
-			//while (clusterWasSwapped)
-			{
-				clusterWasSwapped = false;
-
-				//Calculate mean and swap candidate if cluster was swapped
-				for (unsigned int t = 0; t < amountTiles; t++)
-				{
-					pool.AddJob([t, amountTiles, bladesPerTile, clusterSwapped, clusterIndices, bladePositions, clusterCounts, clusterMeans, swapCandidates, swapCandidatesDist, swapCandidatesIdx](){
-						ProcessCluster(t, amountTiles, bladesPerTile, clusterSwapped, clusterIndices, bladePositions, clusterCounts, clusterMeans, swapCandidates, swapCandidatesDist, swapCandidatesIdx);
-					});
-				}
-				pool.WaitAll();
-
-				std::fill_n(clusterSwapped, amountTiles, false);
-
-				unsigned int swapCount = 0;
-				//Try to swap between clusters
-				for (unsigned int i = 0; i < amountTiles - 1; i++)
-				{
-					if (!clusterSwapped[i])
-					{
-						for (unsigned int j = i + 1; j < amountTiles; j++)
-						{
-							if (!clusterSwapped[j])
-							{
-								const glm::vec3 sc1 = swapCandidates[i][j];
-								const glm::vec3 cc1 = clusterMeans[i];
-								const float scd1 = swapCandidatesDist[i][j];
-								const glm::vec3 sc2 = swapCandidates[j][i];
-								const glm::vec3 cc2 = clusterMeans[j];
-								const float scd2 = swapCandidatesDist[j][i];
-								float swappedValue;
-								if (USE_MANHATTEN_DISTANCE)
-								{
-									float d1 = manDist(sc1, cc2);
-									float d2 = manDist(sc2, cc1);
-									swappedValue = d1*d1 + d2*d2;
-								}
-								else
-								{
-									const glm::vec3 vec1 = sc1 - cc2;
-									const glm::vec3 vec2 = sc2 - cc1;
-									swappedValue = glm::dot(vec1, vec1) + glm::dot(vec2, vec2);
-								}
-								if (swappedValue < scd1 + scd2)
-								{
-									//std::cout << "Swap between Cluster " << i << " and cluster " << j << ": benefit=" << std::to_string(scd1 + scd2 - swappedValue) << " Candidate i=[" << std::to_string(swapCandidates[i][j].x) << ", " << std::to_string(swapCandidates[i][j].y) << ", " << std::to_string(swapCandidates[i][j].z) << "] Candidate j=[" << std::to_string(swapCandidates[j][i].x) << ", " << std::to_string(swapCandidates[j][i].y) << ", " << std::to_string(swapCandidates[j][i].z) << "] " << std::endl;
-									//debug << "Swap between Cluster " << i << " and cluster " << j << ": benefit=" << std::to_string(scd1 + scd2 - swappedValue) << " Candidate i=[" << std::to_string(swapCandidates[i][j].x) << ", " << std::to_string(swapCandidates[i][j].y) << ", " << std::to_string(swapCandidates[i][j].z) << "] Candidate j=[" << std::to_string(swapCandidates[j][i].x) << ", " << std::to_string(swapCandidates[j][i].y) << ", " << std::to_string(swapCandidates[j][i].z) << "] " << std::endl;
-
-									//swap
-									const unsigned int idxi = swapCandidatesIdx[i][j];
-									const unsigned int idxj = swapCandidatesIdx[j][i];
-									clusterId[idxi] = j;
-									clusterId[idxj] = i;
-
-									clusterIndices[i].erase(std::remove(clusterIndices[i].begin(), clusterIndices[i].end(), idxi), clusterIndices[i].end());
-									clusterIndices[j].erase(std::remove(clusterIndices[j].begin(), clusterIndices[j].end(), idxj), clusterIndices[j].end());
-									clusterIndices[i].push_back(idxj);
-									clusterIndices[j].push_back(idxi);
-
-									clusterSwapped[i] = true;
-									clusterSwapped[j] = true;
-									clusterWasSwapped = true;
-									swapCount++;
-									break;
-								}
-								else
-								{
-									//debug << "No Swap between Cluster " << i << " and cluster " << j << ": benefit=" << std::to_string(scd1 + scd2 - swappedValue) << " Candidate i=[" << std::to_string(swapCandidates[i][j].x) << ", " << std::to_string(swapCandidates[i][j].y) << ", " << std::to_string(swapCandidates[i][j].z) << "] Candidate j=[" << std::to_string(swapCandidates[j][i].x) << ", " << std::to_string(swapCandidates[j][i].y) << ", " << std::to_string(swapCandidates[j][i].z) << "] " << std::endl;
-								}
-							}
-						}
-					}
-				}
+			tileSize = TuneBladesPerTile(bladePositions, bladeV1, amountBlades, candidates, params.autoTuneCameras, params.autoTuneViewDistance, params.seed);
+			std::cout << "Auto tuned tile size: " << tileSize << " blades" << std::endl;
+		}
+		unsigned int amountTiles = (unsigned int)glm::ceil(amountBlades / (float)tileSize);
+		std::cout << "Amount blades " << amountBlades << " makes " << amountTiles << " tiles." << std::endl;
 
-				iteration++;
-				std::cout << "Iteration " << iteration << " finished. There " << (clusterWasSwapped ? "were " + std::to_string(swapCount) + " swaps." : " was no swap.") << std::endl;
-				//debug << "Iteration " << iteration << " finished. There was " << (clusterWasSwapped ? "a " : "no ") << "swap." << std::endl;
-			}
-			whileTimeCount.Tick();
-			std::cout << "Finished after " << iteration << " iterations in " << std::to_string(whileTimeCount.LastFrameTime()) << "seconds." << std::endl;
+		std::vector<unsigned int> order;
+		std::vector<unsigned int> tileStart;
+		PartitionBlades(params.partitionStrategy, bladePositions, amountBlades, amountTiles, glm::vec3(xMin, yMin, zMin), glm::vec3(xMax, yMax, zMax), order, tileStart);
 
-			delete[] clusterMeans;
-			for (unsigned int i = 0; i < amountTiles; i++)
-			{
-				delete[] swapCandidates[i];
-				delete[] swapCandidatesDist[i];
-			}
-			delete[] swapCandidates;
-			delete[] clusterCounts;
-			delete[] clusterSwapped;
-			delete[] swapCandidatesDist;
-			delete[] swapCandidatesIdx;
-#endif
-
-			std::cout << "Amount Tiles: " << amountTiles << std::endl;
+		if (params.partitionRefineIterations > 0)
+		{
+			RefinePartition(bladePositions, amountTiles, tileStart, params.partitionRefineIterations, params.partitionRefineSeconds, order);
+		}
 
-			for (unsigned int i = 0; i < amountTiles; i++)
-			{
-				std::cout << "Starting Tile: " << i << std::endl;
-
-				std::vector<glm::vec4> tilePosition;
-				std::vector<glm::vec4> tileV1;
-				std::vector<glm::vec4> tileV2;
-				std::vector<glm::vec4> tileAttr;
-				std::vector<glm::vec4> tileDebug;
-
-				float tile_xMin = FLT_MAX;
-				float tile_yMin = FLT_MAX;
-				float tile_zMin = FLT_MAX;
-				float tile_xMax = -FLT_MAX;
-				float tile_yMax = -FLT_MAX;
-				float tile_zMax = -FLT_MAX;
-
-#ifdef PARTITIONING_BY_CLUSTERING
-				for (unsigned int b = 0; b < amountBlades; b++)
-				{
-					if (clusterId[b] == i)
-					{
-						glm::vec3 pos = bladePositions[b].xyz;
-						float height = bladeV1[b].w;
-
-						glm::vec3 min = pos - height;
-						glm::vec3 max = pos + height;
-
-						if (min.x < tile_xMin) { tile_xMin = min.x; }
-						if (min.y < tile_yMin) { tile_yMin = min.y; }
-						if (min.z < tile_zMin) { tile_zMin = min.z; }
-						if (max.x > tile_xMax) { tile_xMax = max.x; }
-						if (max.y > tile_yMax) { tile_yMax = max.y; }
-						if (max.z > tile_zMax) { tile_zMax = max.z; }
-
-						tilePosition.push_back(bladePositions[b]);
-						tileV1.push_back(bladeV1[b]);
-						tileV2.push_back(bladeV2[b]);
-						tileAttr.push_back(bladeAttr[b]);
-						tileDebug.push_back(glm::vec4(i / 31.0f, (i % 5) / 4.0f, (i % 7) / 6.0f, 1.0f));
-					}
-				}
-#endif
+		if (params.sortBladesInPatch)
+		{
+			SortTilesByMorton(bladePositions, tileStart, order);
+		}
 
 #ifdef EVALUATE_MSE
-				glm::vec3 tile_mean = (glm::vec3(tile_xMin, tile_yMin, tile_zMin) + glm::vec3(tile_xMax, tile_yMax, tile_zMax)) * 0.5f;
-				for (unsigned int b = 0; b < tilePosition.size(); b++)
-				{
-					
-					glm::vec3 pos = tilePosition[b].xyz;
-					glm::vec3 evec = tile_mean - pos;
-					meanSquaredError += glm::dot(evec, evec);
-				}
+		PartitionQuality quality = EvaluatePartition(bladePositions, bladeV1, order, tileStart);
+		std::cout << toString(params.partitionStrategy) << " partition: MSE = " << std::to_string(quality.meanSquaredError) << ", bounds volume = " << std::to_string(quality.boundsVolume)
+			<< ", overlap ratio = " << std::to_string(quality.overlapRatio) << ", blades per tile variance = " << std::to_string(quality.bladesPerTileVariance) << std::endl;
 #endif
 
-				GrassPatchInfo p;
-				p.modelMatrix = glm::mat4(1.0f);
-				p.tessellationProps = tessellationProps;
-				p.patch = new GrassPatch(tilePosition, tileV1, tileV2, tileAttr, tileDebug, shape);
-				p.bounds = new BoundingBox(tile_xMin, tile_xMax, tile_yMin, tile_yMax, tile_zMin, tile_zMax);
+		std::cout << "Amount Tiles: " << amountTiles << std::endl;
 
-				maxAmountBlades = glm::max(maxAmountBlades, p.patch->amountBlades);
+		generated.blades.gather(blades, order.data(), amountBlades);
+		blades.release();
 
-				patches.push_back(p);
+		const glm::vec4* tilePosition = generated.blades.position();
+		const glm::vec4* tileV1 = generated.blades.v1();
+		generated.boundsMin.resize(amountTiles);
+		generated.boundsMax.resize(amountTiles);
+		parallelFor(amountTiles, 1, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+		{
+			glm::vec3 tileMin(FLT_MAX);
+			glm::vec3 tileMax(-FLT_MAX);
+			for (unsigned int b = tileStart[begin]; b < tileStart[begin + 1]; b++)
+			{
+				glm::vec3 pos = tilePosition[b].xyz;
+				float height = tileV1[b].w;
+				tileMin = glm::min(tileMin, pos - height);
+				tileMax = glm::max(tileMax, pos + height);
 			}
-			
-#ifdef EVALUATE_MSE
-			meanSquaredError = meanSquaredError / (float)amountBlades;
-			std::cout << "MSE = " << std::to_string(meanSquaredError) << std::endl;
-#endif
+			generated.boundsMin[begin] = tileMin;
+			generated.boundsMax[begin] = tileMax;
+		});
 
-#ifdef PARTITIONING_BY_CLUSTERING
-			delete[] clusterId;
-#endif
+		generated.tileStart = std::move(tileStart);
+		generated.tileSize = tileSize;
+		if (params.sortBladesInPatch)
+		{
+			generated.sourceIds = std::move(order);
+		}
+	}
+	else
+	{
+		//Do not tile
+		if (params.sortBladesInPatch)
+		{
+			std::vector<unsigned int> tileStart(2, 0);
+			tileStart[1] = amountBlades;
+			generated.sourceIds.resize(amountBlades);
+			std::iota(generated.sourceIds.begin(), generated.sourceIds.end(), 0);
+			SortTilesByMorton(bladePositions, tileStart, generated.sourceIds);
+
+			generated.blades.gather(blades, generated.sourceIds.data(), amountBlades);
 		}
 		else
 		{
-			//Do not tile
-			GrassPatchInfo p;
-			p.modelMatrix = glm::mat4(1.0f);
-			p.tessellationProps = tessellationProps;
-			p.patch = new GrassPatch(bladePositions, bladeV1, bladeV2, bladeAttr, std::vector<glm::vec4>(), shape);
-			p.bounds = new BoundingBox(xMin, xMax, yMin, yMax, zMin, zMax);
+			generated.blades = std::move(blades);
+		}
+
+		generated.tileStart.resize(2, 0);
+		generated.tileStart[1] = amountBlades;
+		generated.boundsMin.assign(1, glm::vec3(xMin, yMin, zMin));
+		generated.boundsMax.assign(1, glm::vec3(xMax, yMax, zMax));
+		generated.tileSize = 0;
+	}
 
-			maxAmountBlades = glm::max(maxAmountBlades, p.patch->amountBlades);
+	//The order indexes the blades of this face group, the ids count through the whole field
+	for (unsigned int i = 0; i < generated.sourceIds.size(); i++)
+	{
+		generated.sourceIds[i] += firstSourceId;
+	}
+}
 
-			patches.push_back(p);
-		}
+void Grass::UploadPatches(GeneratedPatches& generated)
+{
+	if (generated.blades.empty())
+	{
+		return;
 	}
-	else
+
+	const GrassCreateBladeParams& params = *generated.params;
+	const unsigned int amountTiles = (unsigned int)generated.tileStart.size() - 1;
+	for (unsigned int i = 0; i < amountTiles; i++)
 	{
-		//Do not tile
+		const unsigned int first = generated.tileStart[i];
+		const unsigned int count = generated.tileStart[i + 1] - first;
+		const glm::vec3& bMin = generated.boundsMin[i];
+		const glm::vec3& bMax = generated.boundsMax[i];
+
 		GrassPatchInfo p;
 		p.modelMatrix = glm::mat4(1.0f);
-		p.tessellationProps = tessellationProps;
-		p.patch = new GrassPatch(bladePositions, bladeV1, bladeV2, bladeAttr, std::vector<glm::vec4>(), shape);
-		p.bounds = new BoundingBox(xMin, xMax, yMin, yMax, zMin, zMax);
+		p.tessellationProps = params.tessellationProps;
+		if (generated.tileSize > 0)
+		{
+			std::cout << "Starting Tile: " << i << std::endl;
+			p.patch = new GrassPatch(generated.blades, first, count, glm::vec4(i / 31.0f, (i % 5) / 4.0f, (i % 7) / 6.0f, 1.0f), params.shape);
+		}
+		else
+		{
+			p.patch = new GrassPatch(generated.blades, first, count, glm::vec4(0.0f), params.shape);
+		}
+		if (!generated.sourceIds.empty())
+		{
+			p.patch->sourceIds.assign(generated.sourceIds.begin() + first, generated.sourceIds.begin() + first + count);
+		}
+		if (params.cpuForces)
+		{
+			p.patch->setCpuForces(true);
+		}
+		p.tileSize = generated.tileSize;
+		p.bounds = new BoundingBox(bMin.x, bMax.x, bMin.y, bMax.y, bMin.z, bMax.z);
 
 		maxAmountBlades = glm::max(maxAmountBlades, p.patch->amountBlades);
 
 		patches.push_back(p);
 	}
+
+	//The blades are on the GPU now
+	generated.blades.release();
+	std::vector<unsigned int>().swap(generated.sourceIds);
 }
 
 void Grass::Draw(const float dt, const Camera& cam)
@@ -1476,10 +1495,8 @@ void Grass::Draw(const float dt, const Camera& cam)
 	if (visible)
 	{
 		OpenGLState::Instance().disable(GL_CULL_FACE);
-		for (unsigned int i = 0; i<patches.size(); i++)
-		{
-			ProcessPatch(patches[i], cam);
-		}
+		patchHierarchy.cull(cam, modelMatrix, (heightMap != 0) ? heightMap->heightScale : 0.0f, patches, frame);
+
 		////////////////
 		//Force update//
 		////////////////
@@ -1504,40 +1521,59 @@ void Grass::Draw(const float dt, const Camera& cam)
 		//Forces
 		if (wind.size() > 0)
 		{
-			updateForceShader->setUniform("windType", (GLuint)wind[0]->getWindType());
-			updateForceShader->setUniform("windData", wind[0]->getWindData());
+			forceParams.windType = (GLuint)wind[0]->getWindType();
+			forceParams.windData = wind[0]->getWindData();
 			//TODO add multiple wind setting
 		}
 		else
 		{
-			updateForceShader->setUniform("windType", (GLuint)99);
-			updateForceShader->setUniform("windData", glm::vec4(0.0f));
+			forceParams.windType = 99;
+			forceParams.windData = glm::vec4(0.0f);
 		}
+		updateForceShader->setUniform("windType", (GLuint)forceParams.windType);
+		updateForceShader->setUniform("windData", forceParams.windData);
 
-		if (useLocalGravity)
-		{
-			updateForceShader->setUniform("gravityVec", localGravity.gravityVector);
-			updateForceShader->setUniform("gravityPoint", localGravity.gravityPoint);
-			updateForceShader->setUniform("useGravityPoint", localGravity.gravityPointAlpha);
-		}
-		else
-		{
-			updateForceShader->setUniform("gravityVec", overmind->getGravity().gravityVector);
-			updateForceShader->setUniform("gravityPoint", overmind->getGravity().gravityPoint);
-			updateForceShader->setUniform("useGravityPoint", overmind->getGravity().gravityPointAlpha);
-		}
+		const GrassGravity& gravity = useLocalGravity ? localGravity : overmind->getGravity();
+		forceParams.gravityVec = gravity.gravityVector;
+		forceParams.gravityPoint = gravity.gravityPoint;
+		forceParams.useGravityPoint = gravity.gravityPointAlpha;
+		updateForceShader->setUniform("gravityVec", forceParams.gravityVec);
+		updateForceShader->setUniform("gravityPoint", forceParams.gravityPoint);
+		updateForceShader->setUniform("useGravityPoint", forceParams.useGravityPoint);
 
 		//Misc Settings
+		forceParams.dt = dt;
 		updateForceShader->setUniform("dt", dt);
 
-		for (unsigned int i = 0; i < patches.size(); i++)
+		//The height map is read back once, when the first patch needs it on the CPU
+		forceParams.heightField = 0;
+		if (heightMap != 0)
 		{
-			if (patches[i].forceVisible)
+			if (usesCpuForces())
 			{
-				UpdatePatchForce(patches[i]);
+				if (heightField.samples == 0 || heightField.width != heightMap->Width() || heightField.height != heightMap->Height())
+				{
+					heightFieldSamples.resize(heightMap->Width() * heightMap->Height());
+					heightMap->bind(1);
+					glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, heightFieldSamples.data());
+					heightField.samples = heightFieldSamples.data();
+					heightField.width = heightMap->Width();
+					heightField.height = heightMap->Height();
+				}
+				heightField.bounds = heightMapBounds;
+				forceParams.heightField = &heightField;
 			}
 		}
 
+		//Collider
+		UpdateColliders();
+
+		for (unsigned int i = 0; i < frame.batches.size(); i++)
+		{
+			UpdateBatchForce(frame.batches[i]);
+		}
+		UpdateCpuForces();
+
 		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 		/////////////////////
 		//Visibility update//
@@ -1593,14 +1629,13 @@ void Grass::Draw(const float dt, const Camera& cam)
 		updateVisibilityShader->setUniform("doOrientationCulling", (GLboolean)overmind->getOrientationCulling());
 		updateVisibilityShader->setUniform("depthCullLevel", overmind->getDepthCullLevel());
 
-		for (unsigned int i = 0; i<patches.size(); i++)
+		for (unsigned int i = 0; i < frame.batches.size(); i++)
 		{
-			if (patches[i].visible)
-			{
-				UpdatePatchVisibility(patches[i]);
-			}
+			UpdateBatchVisibility(frame.batches[i]);
 		}
 
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
 		////////
 		//Draw//
 		////////
@@ -1654,144 +1689,289 @@ void Grass::Draw(const float dt, const Camera& cam)
 		drawShader->setUniform("useFlare", (GLboolean)overmind->getUseFlare());
 		drawShader->setUniform("usePositionColor", (GLboolean)overmind->getUsePositionColor());
 
-		for (unsigned int i = 0; i<patches.size(); i++)
+		for (unsigned int i = 0; i < frame.batches.size(); i++)
 		{
-			DrawPatch(patches[i]);
+			DrawBatch(frame.batches[i]);
 		}
 		OpenGLState::Instance().enable(GL_CULL_FACE);
 	}
 }
 
-void Grass::ProcessPatch(GrassPatchInfo& patch, const Camera& cam) const
+/**
+*  The colliders are put into the spatial hash once, then every patch, or the bounds of a merged batch, takes the colliders of the
+*  cells around its bounds. The colliders of all patches are appended to one list and uploaded once, a patch only keeps its span.
+*/
+void Grass::UpdateColliders()
 {
-	glm::mat4 patchModelMatrix = modelMatrix * patch.modelMatrix;
-
-	float patchVisible = -1.0f;
-
-	if (patch.bounds != 0)
+	colliders.clear();
+	colliderSpans.assign(frame.patches.size(), glm::uvec2(0));
+	if (overmind->colliderList != 0 && overmind->getCollisionDetection() && !overmind->colliderList->empty())
 	{
-		if (heightMap == 0)
-		{
-			patchVisible = patch.bounds->isVisibleF2(cam, patchModelMatrix);
-		}
-		else
+		colliderHash.reset(colliderCellSize);
+		colliderHash.build(*(overmind->colliderList));
+
+		for (unsigned int b = 0; b < frame.batches.size(); b++)
 		{
-			BoundingBox b(*(patch.bounds));
-			b.inflate(glm::vec3(0.0f, heightMap->heightScale, 0.0f));
-			patchVisible = b.isVisibleF2(cam, patchModelMatrix);
+			const PatchBatch& batch = frame.batches[b];
+			if (batch.merged)
+			{
+				BoundingBox bounds(batch.min.x, batch.max.x, batch.min.y, batch.max.y, batch.min.z, batch.max.z);
+				glm::uvec2 span = AppendColliders(&bounds, modelMatrix);
+				for (unsigned int i = batch.first; i < batch.first + batch.count; i++)
+				{
+					colliderSpans[i] = span;
+				}
+				continue;
+			}
+			for (unsigned int i = batch.first; i < batch.first + batch.count; i++)
+			{
+				const GrassPatchInfo& patch = patches[frame.patches[i]];
+				if (patch.forceVisible)
+				{
+					colliderSpans[i] = AppendColliders(patch.bounds, modelMatrix * patch.modelMatrix);
+				}
+			}
 		}
 	}
 
-	if (patchVisible < 0.0f)
+	//The buffer only grows, an empty list still binds one element
+	unsigned int size = std::max((unsigned int)colliders.size(), 1u);
+	if (colliderBuffer == 0)
 	{
-		patch.visible = true;
-		patch.forceVisible = true;
+		glGenBuffers(1, &colliderBuffer);
 	}
-	else
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, colliderBuffer);
+	if (size > colliderBufferSize)
+	{
+		colliderBufferSize = std::max(size, colliderBufferSize * 2);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, colliderBufferSize * sizeof(glm::vec4), 0, GL_DYNAMIC_DRAW);
+	}
+	if (!colliders.empty())
+	{
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, colliders.size() * sizeof(glm::vec4), colliders.data());
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COLLIDER_LOCATION, colliderBuffer);
+}
+
+glm::uvec2 Grass::AppendColliders(const BoundingBox* bounds, const glm::mat4& transform)
+{
+	const std::vector<glm::vec4>& list = *(overmind->colliderList);
+	unsigned int first = (unsigned int)colliders.size();
+	if (bounds != 0)
 	{
-		patch.visible = false;
-		if (patchVisible < 2.0f)
+		BoundingBox b(*bounds);
+		if (heightMap != 0)
 		{
-			patch.forceVisible = true;
+			b.inflate(glm::vec3(0.0f, heightMap->heightScale, 0.0f));
 		}
-		else
+		BoundingBox::TransformedBox box = b.transform(transform);
+
+		//Only the colliders in the cells around the box are tested, kept in list order
+		colliderIndices.clear();
+		glm::vec3 extent = glm::abs(box.axis1) + glm::abs(box.axis2) + glm::abs(box.axis3) + glm::vec3(colliderHash.getMaxW());
+		colliderHash.query(box.location - extent, box.location + extent, [&](const unsigned int index, const glm::vec4& coll) -> bool
+		{
+			if (intersect(box, coll))
+			{
+				colliderIndices.push_back(index);
+			}
+			return true;
+		});
+		std::sort(colliderIndices.begin(), colliderIndices.end());
+		for (unsigned int i = 0; i < colliderIndices.size(); i++)
 		{
-			patch.forceVisible = false;
+			colliders.push_back(list[colliderIndices[i]]);
 		}
 	}
+	else
+	{
+		colliders.insert(colliders.end(), list.begin(), list.end());
+	}
+	return glm::uvec2(first, (unsigned int)colliders.size() - first);
 }
 
-void Grass::UpdatePatchForce(const GrassPatchInfo& patch) const
+/**
+*  The patches of a merged batch share their model matrix and their span of colliders, so they are only set for the first patch.
+*/
+void Grass::UpdateBatchForce(const PatchBatch& batch)
 {
-	glm::mat4 patchModelMatrix = modelMatrix * patch.modelMatrix;
-	glm::mat4 invPatchModelMatrix = glm::inverse(patchModelMatrix);
-	glm::mat3 invTransPatchModelMatrix = glm::inverse(glm::transpose(glm::mat3(patchModelMatrix)));
-
-	//Pressure Map offset
-	updateForceShader->setUniform("pressureMapOffset", patch.pressureMapOffset);
-
-	//Collider
-	if (overmind->colliderList != 0 && overmind->getCollisionDetection())
+	GrassForceParams cpuParams = forceParams;
+	for (unsigned int i = batch.first; i < batch.first + batch.count; i++)
 	{
-		std::vector<glm::vec4> collider;
-		collider.reserve(overmind->colliderList->size());
+		const GrassPatchInfo& patch = patches[frame.patches[i]];
+		if (!patch.forceVisible)
+		{
+			continue;
+		}
+
+		if (!batch.merged || i == batch.first)
+		{
+			glm::mat4 patchModelMatrix = modelMatrix * patch.modelMatrix;
+			const glm::uvec2& span = colliderSpans[i];
+			cpuParams.modelMatrix = patchModelMatrix;
+			cpuParams.sphereCollider = colliders.data() + span.x;
+			cpuParams.amountSphereCollider = span.y;
+
+			updateForceShader->setUniform("firstSphereCollider", (GLuint)span.x);
+			updateForceShader->setUniform("amountSphereCollider", (GLuint)span.y);
+
+			//Misc Settings
+			updateForceShader->setUniform("modelMatrix", patchModelMatrix);
+			updateForceShader->setUniform("invModelMatrix", glm::inverse(patchModelMatrix));
+			updateForceShader->setUniform("invTransModelMatrix", glm::inverse(glm::transpose(glm::mat3(patchModelMatrix))));
+		}
 
-		auto list = *(overmind->colliderList);
-		for each (glm::vec4 coll in list)
+		if (patch.patch->usesCpuForces())
 		{
-			if (patch.bounds != 0)
+			patch.patch->prepareForceCpu();
+			patch.patch->wakeOnForceChange(cpuParams);
+
+			CpuForceJob job;
+			job.patch = patch.patch;
+			job.params = cpuParams;
+			if (batch.split)
 			{
-				if (heightMap == 0)
-				{
-					if (intersect(patch.bounds->transform(patchModelMatrix), coll))
-					{
-						collider.push_back(coll);
-					}
-				}
-				else
+				for (unsigned int r = batch.firstForceRange; r < batch.firstForceRange + batch.amountForceRanges; r++)
 				{
-					BoundingBox b(*(patch.bounds));
-					b.inflate(glm::vec3(0.0f, heightMap->heightScale, 0.0f));
-					if (intersect(b.transform(patchModelMatrix), coll))
-					{
-						collider.push_back(coll);
-					}
+					job.first = frame.forceRanges[r].x;
+					job.count = frame.forceRanges[r].y;
+					cpuForceJobs.push_back(job);
 				}
 			}
 			else
 			{
-				collider.push_back(coll);
+				job.first = 0;
+				job.count = patch.patch->amountBlades;
+				cpuForceJobs.push_back(job);
 			}
+			continue;
 		}
 
-		if (collider.size() > MAX_AMOUNT_SPHERE_COLLIDER)
+		//Pressure Map offset
+		updateForceShader->setUniform("pressureMapOffset", patch.pressureMapOffset);
+
+		if (batch.split)
+		{
+			for (unsigned int r = batch.firstForceRange; r < batch.firstForceRange + batch.amountForceRanges; r++)
+			{
+				patch.patch->updateForce(*updateForceShader, frame.forceRanges[r].x, frame.forceRanges[r].y);
+			}
+		}
+		else
 		{
-			collider.resize(MAX_AMOUNT_SPHERE_COLLIDER);
+			patch.patch->updateForce(*updateForceShader);
 		}
+	}
+}
 
-		updateForceShader->setUniform("amountSphereCollider", (GLuint)collider.size());
-		updateForceShader->setUniform("sphereCollider[0]", collider);
+/**
+*  All CPU force ranges of the frame go to the PatchScheduler at once, weighted by blades and colliders.
+*  The stats of every patch are summed in job order, the uploads stay on this thread.
+*/
+void Grass::UpdateCpuForces()
+{
+	if (cpuForceJobs.empty())
+	{
+		return;
 	}
-	else
+
+	//Ranges where every blade sleeps and no collider is near are skipped
+	unsigned int amountJobs = 0;
+	for (unsigned int j = 0; j < cpuForceJobs.size(); j++)
 	{
-		updateForceShader->setUniform("amountSphereCollider", (GLuint)0);
+		cpuForceJobs[j].patch->cpuForceStats = PatchTaskStats();
+		if (cpuForceJobs[j].params.amountSphereCollider > 0 || cpuForceJobs[j].patch->awakeForceCpu(cpuForceJobs[j].first, cpuForceJobs[j].count))
+		{
+			cpuForceJobs[amountJobs++] = cpuForceJobs[j];
+		}
+	}
+	cpuForceJobs.resize(amountJobs);
+
+	std::vector<PatchJob> jobs(cpuForceJobs.size());
+	for (unsigned int j = 0; j < cpuForceJobs.size(); j++)
+	{
+		const CpuForceJob& job = cpuForceJobs[j];
+		jobs[j].first = job.first;
+		jobs[j].count = job.count;
+		jobs[j].amountColliders = job.params.amountSphereCollider;
 	}
 
-	//Misc Settings
-	updateForceShader->setUniform("modelMatrix", patchModelMatrix);
-	updateForceShader->setUniform("invModelMatrix", invPatchModelMatrix);
-	updateForceShader->setUniform("invTransModelMatrix", invTransPatchModelMatrix);
+	std::vector<PatchTaskStats> jobStats;
+	PatchScheduler::Instance().run(jobs, [&](const PatchTask& task)
+	{
+		const CpuForceJob& job = cpuForceJobs[task.job];
+		job.patch->simulateForceCpu(job.params, task.first, task.count);
+	}, jobStats);
+
+	for (unsigned int j = 0; j < cpuForceJobs.size(); j++)
+	{
+		CpuForceJob& job = cpuForceJobs[j];
+		job.patch->timeForce.Start();
+		job.patch->uploadForceCpu(job.first, job.count);
+		job.patch->timeForce.Stop();
+		job.patch->cpuForceStats += jobStats[j];
+	}
 
-	patch.patch->updateForce(*updateForceShader);
+	cpuForceJobs.clear();
 }
 
-void Grass::UpdatePatchVisibility(const GrassPatchInfo& patch) const
+void Grass::UpdateBatchVisibility(const PatchBatch& batch) const
 {
-	glm::mat4 patchModelMatrix = modelMatrix * patch.modelMatrix;
-	glm::mat3 invTransPatchModelMatrix = glm::inverse(glm::transpose(glm::mat3(patchModelMatrix)));
+	for (unsigned int i = batch.first; i < batch.first + batch.count; i++)
+	{
+		const GrassPatchInfo& patch = patches[frame.patches[i]];
+		if (!patch.visible)
+		{
+			continue;
+		}
 
-	//Misc Settings
-	updateVisibilityShader->setUniform("modelMatrix", patchModelMatrix);
-	updateVisibilityShader->setUniform("invTransModelMatrix", invTransPatchModelMatrix);	
+		if (!batch.merged || i == batch.first)
+		{
+			glm::mat4 patchModelMatrix = modelMatrix * patch.modelMatrix;
+
+			//Misc Settings
+			updateVisibilityShader->setUniform("modelMatrix", patchModelMatrix);
+			updateVisibilityShader->setUniform("invTransModelMatrix", glm::inverse(glm::transpose(glm::mat3(patchModelMatrix))));
+		}
 
-	patch.patch->updateVisibility(*updateVisibilityShader, *copyBufferShader);
+		if (batch.split)
+		{
+			patch.patch->updateVisibility(*updateVisibilityShader, frame.visibleRanges.data() + batch.firstVisibleRange, batch.amountVisibleRanges);
+		}
+		else
+		{
+			glm::uvec2 range(0, patch.patch->amountBlades);
+			patch.patch->updateVisibility(*updateVisibilityShader, &range, 1);
+		}
+	}
 }
 
-void Grass::DrawPatch(const GrassPatchInfo& patch) const
+void Grass::DrawBatch(const PatchBatch& batch) const
 {
-	glm::mat4 patchModelMatrix = modelMatrix * patch.modelMatrix;
+	for (unsigned int i = batch.first; i < batch.first + batch.count; i++)
+	{
+		const GrassPatchInfo& patch = patches[frame.patches[i]];
+		if (!patch.visible)
+		{
+			continue;
+		}
 
-	//VS Uniforms
-	drawShader->setUniform("modelMatrix", patchModelMatrix);
+		if (!batch.merged || i == batch.first)
+		{
+			//VS Uniforms
+			drawShader->setUniform("modelMatrix", modelMatrix * patch.modelMatrix);
 
-	//TCS Uniforms
-	drawShader->setUniform("tessellationProps", patch.tessellationProps);
+			//TCS Uniforms
+			drawShader->setUniform("tessellationProps", patch.tessellationProps);
 
-	//TES Uniforms
-	GLuint subroutine = patch.patch->bladeShape;
-	glUniformSubroutinesuiv(GL_TESS_EVALUATION_SHADER, 1, &subroutine);
+			//TES Uniforms
+			GLuint subroutine = patch.patch->bladeShape;
+			glUniformSubroutinesuiv(GL_TESS_EVALUATION_SHADER, 1, &subroutine);
+		}
 
-	patch.patch->draw(*drawShader);
+		patch.patch->draw(*drawShader);
+	}
 }
 
 #pragma endregion
@@ -1800,24 +1980,23 @@ void Grass::DrawPatch(const GrassPatchInfo& patch) const
 //************ GrassPatch ******************
 //*******************************************
 #pragma region GrassPatch
-GrassPatch::GrassPatch(const std::vector<glm::vec4>& pos, const std::vector<glm::vec4>& v1, const std::vector<glm::vec4>& v2, const std::vector<glm::vec4>& attr, const std::vector<glm::vec4>& debug, const BladeShape bladeShape) : bladeShape(bladeShape)
+GrassPatch::GrassPatch(const BladeBuffer& blades, const unsigned int first, const unsigned int count, const glm::vec4& debugColor, const BladeShape bladeShape) : amountBlades(count), bladeShape(bladeShape)
 {
-	amountBlades = pos.size();
-	if (v1.size() != amountBlades || v2.size() != amountBlades || attr.size() != amountBlades)
+	if (first + count > blades.size())
 	{
-		std::cout << "ERROR GrassPatch: Different Vector sizes!" << std::endl;
+		std::cout << "ERROR GrassPatch: Blade range out of bounds!" << std::endl;
+		amountBlades = 0;
 	}
+	upload(blades.position() + first, blades.v1() + first, blades.v2() + first, blades.attr() + first, blades.hasAnchors() ? blades.anchor() + first : 0, debugColor);
+}
 
-	//Additional initializations
-	std::vector<glm::vec4> debugLocal;
-	if (debug.size() == 0)
-	{
-		debugLocal = std::vector<glm::vec4>(amountBlades, glm::vec4(0));
-	}
-	else
-	{
-		debugLocal = debug;
-	}
+GrassPatch::GrassPatch(const glm::vec4* pos, const glm::vec4* v1, const glm::vec4* v2, const glm::vec4* attr, const glm::vec4* anchor, const unsigned int amountBlades, const glm::vec4& debugColor, const BladeShape bladeShape) : amountBlades(amountBlades), bladeShape(bladeShape)
+{
+	upload(pos, v1, v2, attr, anchor, debugColor);
+}
+
+void GrassPatch::upload(const glm::vec4* pos, const glm::vec4* v1, const glm::vec4* v2, const glm::vec4* attr, const glm::vec4* anchor, const glm::vec4& debugColor)
+{
 	std::vector<GLuint> index(amountBlades);
 	std::iota(index.begin(), index.end(), 0);
 	IndirectBufferStruct indirectBufferEntry = { (GLuint)amountBlades, (GLuint)1, (GLuint)0, (GLuint)0, (GLuint)0 };
@@ -1830,29 +2009,30 @@ GrassPatch::GrassPatch(const std::vector<glm::vec4>& pos, const std::vector<glm:
 	glBindVertexArray(grassVAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[GrassBufferEnum::POSITION]);
-	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), pos.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), pos, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(GrassBufferEnum::POSITION);
 	glVertexAttribPointer(GrassBufferEnum::POSITION, 4, GL_FLOAT, GL_FALSE, 0, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[GrassBufferEnum::V1]);
-	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), v1.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), v1, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(GrassBufferEnum::V1);
 	glVertexAttribPointer(GrassBufferEnum::V1, 4, GL_FLOAT, GL_FALSE, 0, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[GrassBufferEnum::V2]);
-	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), v2.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), v2, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(GrassBufferEnum::V2);
 	glVertexAttribPointer(GrassBufferEnum::V2, 4, GL_FLOAT, GL_FALSE, 0, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[GrassBufferEnum::ATTR]);
-	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), attr.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), attr, GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[GrassBufferEnum::DEBUGOUT]);
-	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), debugLocal.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, amountBlades * sizeof(glm::vec4), 0, GL_STATIC_DRAW);
+	glClearBufferData(GL_ARRAY_BUFFER, GL_RGBA32F, GL_RGBA, GL_FLOAT, &debugColor);
 	glEnableVertexAttribArray(GrassBufferEnum::DEBUGOUT);
 	glVertexAttribPointer(GrassBufferEnum::DEBUGOUT, 4, GL_FLOAT, GL_FALSE, 0, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -1870,6 +2050,55 @@ GrassPatch::GrassPatch(const std::vector<glm::vec4>& pos, const std::vector<glm:
 
 	glBindVertexArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	anchorFaces.clear();
+	if (anchor != 0 && amountBlades > 0)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, grassBuffer[GrassBufferEnum::ANCHOR]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, amountBlades * sizeof(glm::vec4), anchor, GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		anchorFaces.resize(amountBlades);
+		for (unsigned int i = 0; i < amountBlades; i++)
+		{
+			anchorFaces[i] = BladeBuffer::anchorFace(anchor[i]);
+		}
+		std::sort(anchorFaces.begin(), anchorFaces.end());
+		anchorFaces.erase(std::unique(anchorFaces.begin(), anchorFaces.end()), anchorFaces.end());
+		anchorFaces.shrink_to_fit();
+	}
+
+	segments.clear();
+	if (anchor == 0 && amountBlades >= PATCH_SPLIT_MIN_BLADES)
+	{
+		glm::vec3 patchMin(FLT_MAX);
+		glm::vec3 patchMax(-FLT_MAX);
+		float segmentArea = 0.0f;
+		segments.resize(PATCH_SPLIT_SEGMENTS);
+		for (unsigned int s = 0; s < PATCH_SPLIT_SEGMENTS; s++)
+		{
+			Segment& segment = segments[s];
+			segment.first = (unsigned int)((unsigned long long)amountBlades * s / PATCH_SPLIT_SEGMENTS);
+			segment.count = (unsigned int)((unsigned long long)amountBlades * (s + 1) / PATCH_SPLIT_SEGMENTS) - segment.first;
+			segment.min = glm::vec3(FLT_MAX);
+			segment.max = glm::vec3(-FLT_MAX);
+			for (unsigned int b = segment.first; b < segment.first + segment.count; b++)
+			{
+				glm::vec3 p = pos[b].xyz;
+				segment.min = glm::min(segment.min, p - v1[b].w);
+				segment.max = glm::max(segment.max, p + v1[b].w);
+			}
+			patchMin = glm::min(patchMin, segment.min);
+			patchMax = glm::max(patchMax, segment.max);
+			segmentArea += (segment.max.x - segment.min.x) * (segment.max.z - segment.min.z);
+		}
+
+		//Segments of unordered blades all cover the whole patch and could never be culled
+		if (segmentArea / PATCH_SPLIT_SEGMENTS > 0.5f * (patchMax.x - patchMin.x) * (patchMax.z - patchMin.z))
+		{
+			segments.clear();
+		}
+	}
 }
 
 GrassPatch::~GrassPatch()
@@ -1879,9 +2108,42 @@ GrassPatch::~GrassPatch()
 
 }
 
+void GrassPatch::download(BladeBuffer& blades, glm::vec4& debugColor) const
+{
+	if (hasAnchors())
+	{
+		blades.enableAnchors();
+	}
+	blades.resize(amountBlades);
+	const GrassBufferEnum source[BladeBuffer::AMOUNT_ATTRIBUTES] = { POSITION, V1, V2, ATTR };
+	for (unsigned int a = 0; a < BladeBuffer::AMOUNT_ATTRIBUTES; a++)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[source[a]]);
+		glGetBufferSubData(GL_ARRAY_BUFFER, 0, amountBlades * sizeof(glm::vec4), blades.data((BladeBuffer::Attribute)a));
+	}
+	if (hasAnchors())
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[ANCHOR]);
+		glGetBufferSubData(GL_ARRAY_BUFFER, 0, amountBlades * sizeof(glm::vec4), blades.anchor());
+	}
+	debugColor = glm::vec4(0.0f);
+	if (amountBlades > 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[DEBUGOUT]);
+		glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4), &debugColor);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void GrassPatch::updateForce(const Shader& shader)
 {
-	shader.setUniform("amountBlades", amountBlades);
+	updateForce(shader, 0, amountBlades);
+}
+
+void GrassPatch::updateForce(const Shader& shader, const unsigned int first, const unsigned int count)
+{
+	shader.setUniform("firstBlade", first);
+	shader.setUniform("amountBlades", first + count);
 
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::POSITION, grassBuffer[GrassBufferEnum::POSITION]);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::V1, grassBuffer[GrassBufferEnum::V1]);
@@ -1890,14 +2152,163 @@ void GrassPatch::updateForce(const Shader& shader)
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::DEBUGOUT, grassBuffer[GrassBufferEnum::DEBUGOUT]);
 
 	timeForce.Start();
+	glDispatchCompute((count / shader.max_work_group_size_X) + 1, 1, 1);
+	timeForce.Stop();
+}
+
+void GrassPatch::reproject(const Shader& shader)
+{
+	shader.setUniform("amountBlades", amountBlades);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::POSITION, grassBuffer[GrassBufferEnum::POSITION]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::V1, grassBuffer[GrassBufferEnum::V1]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::V2, grassBuffer[GrassBufferEnum::V2]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::ATTR, grassBuffer[GrassBufferEnum::ATTR]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::ANCHOR, grassBuffer[GrassBufferEnum::ANCHOR]);
+
 	glDispatchCompute((amountBlades / shader.max_work_group_size_X) + 1, 1, 1);
+
+	cpuBladesDirty = cpuForces;
+}
+
+void GrassPatch::setCpuForces(const bool enable)
+{
+	cpuForces = enable;
+	if (enable)
+	{
+		glm::vec4 debugColor;
+		download(cpuBlades, debugColor);
+		cpuPressure.assign(amountBlades, glm::vec4(0.0f));
+		cpuBladesDirty = false;
+		cpuAwake.resize((amountBlades + 31) / 32);
+		wakeForceCpu();
+	}
+	else
+	{
+		cpuBlades.release();
+		std::vector<glm::vec4>().swap(cpuPressure);
+		std::vector<unsigned int>().swap(cpuAwake);
+	}
+}
+
+void GrassPatch::updateForceCpu(const GrassForceParams& params, const unsigned int first, const unsigned int count)
+{
+	prepareForceCpu();
+	if (count == 0 || first + count > amountBlades)
+	{
+		return;
+	}
+
+	timeForce.Start();
+	parallelFor(count, FORCE_CPU_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		simulateForceCpu(params, first + begin, end - begin);
+	});
+	uploadForceCpu(first, count);
 	timeForce.Stop();
 }
 
+void GrassPatch::prepareForceCpu()
+{
+	if (cpuBladesDirty)
+	{
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glm::vec4 debugColor;
+		download(cpuBlades, debugColor);
+		cpuBladesDirty = false;
+		wakeForceCpu();
+	}
+}
+
+void GrassPatch::simulateForceCpu(const GrassForceParams& params, const unsigned int first, const unsigned int count)
+{
+	GrassForceParams p = params;
+	p.awake = cpuSleep ? cpuAwake.data() : 0;
+	UpdateForces(p, cpuBlades.position(), cpuBlades.v1(), cpuBlades.v2(), cpuBlades.attr(), cpuPressure.data(), first, count);
+}
+
+void GrassPatch::uploadForceCpu(const unsigned int first, const unsigned int count)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[GrassBufferEnum::V1]);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4), count * sizeof(glm::vec4), cpuBlades.v1() + first);
+	glBindBuffer(GL_ARRAY_BUFFER, grassBuffer[GrassBufferEnum::V2]);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4), count * sizeof(glm::vec4), cpuBlades.v2() + first);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GrassPatch::setCpuSleep(const bool enable)
+{
+	cpuSleep = enable;
+	wakeForceCpu();
+}
+
+//The time in windData.w is left out, the sleep test of a blade holds for every time of the wind
+void GrassPatch::wakeOnForceChange(const GrassForceParams& params)
+{
+	const float e = 1e-5f;
+	bool changed = params.windType != cpuSleepParams.windType
+		|| glm::any(glm::greaterThan(glm::abs(glm::vec3(params.windData) - glm::vec3(cpuSleepParams.windData)), glm::vec3(e)))
+		|| glm::any(glm::greaterThan(glm::abs(params.gravityVec - cpuSleepParams.gravityVec), glm::vec4(e)))
+		|| glm::any(glm::greaterThan(glm::abs(params.gravityPoint - cpuSleepParams.gravityPoint), glm::vec4(e)))
+		|| glm::abs(params.useGravityPoint - cpuSleepParams.useGravityPoint) > e
+		|| params.heightField != cpuSleepParams.heightField;
+	for (unsigned int c = 0; c < 4 && !changed; c++)
+	{
+		changed = glm::any(glm::greaterThan(glm::abs(params.modelMatrix[c] - cpuSleepParams.modelMatrix[c]), glm::vec4(e)));
+	}
+
+	if (changed)
+	{
+		wakeForceCpu();
+		cpuSleepParams = params;
+	}
+}
+
+void GrassPatch::wakeForceCpu()
+{
+	wakeForceCpu(0, amountBlades);
+}
+
+void GrassPatch::wakeForceCpu(const unsigned int first, const unsigned int count)
+{
+	if (cpuAwake.empty() || count == 0)
+	{
+		return;
+	}
+	for (unsigned int id = first; id < first + count; id += 32 - (id & 31))
+	{
+		unsigned int amount = glm::min(32 - (id & 31), first + count - id);
+		WriteAwakeBits(cpuAwake.data(), id, amount, 0xFFFFFFFFu);
+	}
+}
+
+bool GrassPatch::awakeForceCpu(const unsigned int first, const unsigned int count) const
+{
+	if (!cpuSleep || cpuAwake.empty())
+	{
+		return true;
+	}
+	for (unsigned int id = first; id < first + count; id += 32 - (id & 31))
+	{
+		unsigned int amount = glm::min(32 - (id & 31), first + count - id);
+		if (ReadAwakeBits(cpuAwake.data(), id, amount) != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 void GrassPatch::updateVisibility(const Shader& shader, const Shader& copyBuffer) 
 {
-	shader.setUniform("amountBlades", amountBlades);
+	glm::uvec2 range(0, amountBlades);
+	updateVisibility(shader, &range, 1);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
 
+void GrassPatch::updateVisibility(const Shader& shader, const glm::uvec2* ranges, const unsigned int amountRanges)
+{
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::POSITION, grassBuffer[GrassBufferEnum::POSITION]);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::V1, grassBuffer[GrassBufferEnum::V1]);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::V2, grassBuffer[GrassBufferEnum::V2]);
@@ -1906,11 +2317,18 @@ void GrassPatch::updateVisibility(const Shader& shader, const Shader& copyBuffer
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::INDEX, grassBuffer[GrassBufferEnum::INDEX]);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GrassBufferEnum::ATOMIC_COUNTER, grassBuffer[GrassBufferEnum::INDIRECT]);
 
+	//The count is reset here instead of in the shader, so several ranges can append to it
+	GLuint zero = 0;
+	glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
 	timeVis.Start();
-	glDispatchCompute((amountBlades / shader.max_work_group_size_X) + 1, 1, 1);
+	for (unsigned int i = 0; i < amountRanges; i++)
+	{
+		shader.setUniform("firstBlade", ranges[i].x);
+		shader.setUniform("amountBlades", ranges[i].x + ranges[i].y);
+		glDispatchCompute((ranges[i].y / shader.max_work_group_size_X) + 1, 1, 1);
+	}
 	timeVis.Stop();
-
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 }
 
 void GrassPatch::draw(const Shader& shader) 
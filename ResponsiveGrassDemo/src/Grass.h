@@ -15,8 +15,18 @@
 #include "HeightMap.h"
 #include "WindGenerator.h"
 #include "GLClock.h"
+#include "SpatialHash.h"
+#include "BladeBuffer.h"
+#include "GrassPartition.h"
+#include "PatchHierarchy.h"
+#include "GrassForce.h"
+#include "PatchScheduler.h"
 
 #pragma region GrassPatch
+//Patches with fewer blades are never split
+#define PATCH_SPLIT_SEGMENTS 8
+#define PATCH_SPLIT_MIN_BLADES 4096
+
 enum BladeShape { QUAD, TRIANGLE, QUADRATIC, QUADRATIC3D, QUADRATIC3DMINW, THRESHTRIANGLEMINW, DANDELION };
 
 #pragma region BladeShapeMethods
@@ -36,12 +46,31 @@ static std::string toString(BladeShape g)
 }
 #pragma endregion
 
+//Per-blade shapes are stored as whole turns in the direction angle of the blade, sine and cosine of the angle ignore them
+#define BLADE_SHAPE_TURN (2.0f * PI_F)
+
+/**
+*  Blades without an own shape keep their angle in the first two turns, which also covers angles of exactly one turn.
+*  The angle is wrapped slightly below one turn, so rounding can never move it into the next shape.
+*/
+inline float encodeBladeShape(const float dirAlpha, const BladeShape shape)
+{
+	float angle = glm::min(dirAlpha - BLADE_SHAPE_TURN * glm::floor(dirAlpha / BLADE_SHAPE_TURN), BLADE_SHAPE_TURN * 0.9999f);
+	return angle + BLADE_SHAPE_TURN * (float)(shape + 2);
+}
+
+struct GrassShapeWeight
+{
+	BladeShape shape;
+	float weight;
+};
+
 class GrassPatch
 {
 public:
 	enum GrassBufferEnum
 	{
-		POSITION, V1, V2, DEBUGOUT, ATTR, INDEX, INDIRECT, ATOMIC_COUNTER, AMOUNT_BUFFER
+		POSITION, V1, V2, DEBUGOUT, ATTR, INDEX, INDIRECT, ATOMIC_COUNTER, ANCHOR, AMOUNT_BUFFER
 	};
 
 private:
@@ -54,22 +83,86 @@ private:
 		GLuint baseIndex;
 	};
 
+	void upload(const glm::vec4* pos, const glm::vec4* v1, const glm::vec4* v2, const glm::vec4* attr, const glm::vec4* anchor, const glm::vec4& debugColor);
+
+	//CPU force update, the blades are mirrored in memory and v1 and v2 are uploaded after every update
+	bool cpuForces = false;
+	bool cpuBladesDirty = false; //Positions changed on the GPU
+	BladeBuffer cpuBlades;
+	std::vector<glm::vec4> cpuPressure;
+	//Activity bitmask of the CPU force update, see GrassForceParams::awake. Blades fall asleep at rest and are woken
+	//by colliders in reach, by changed wind, gravity or transform and by pressure map writes.
+	bool cpuSleep = true;
+	std::vector<unsigned int> cpuAwake;
+	GrassForceParams cpuSleepParams; //Forces at the last wake check
+
 public:
 	GLuint grassBuffer[GrassBufferEnum::AMOUNT_BUFFER];
 	GLuint grassVAO;
 
 	GLClock timeForce, timeVis, timeDraw;
+	PatchTaskStats cpuForceStats; //CPU force update of the last frame, summed over the ranges of the patch
 
 	unsigned int amountBlades;
 	BladeShape bladeShape;
+
+	//Only for patches generated with attachToFaces: the faces the blades are anchored to (sorted),
+	//and how far the blades reach beyond the bounds of these faces
+	std::vector<unsigned int> anchorFaces;
+	glm::vec3 anchorMarginMin = glm::vec3(0.0f);
+	glm::vec3 anchorMarginMax = glm::vec3(0.0f);
+
+	//Bounds of PATCH_SPLIT_SEGMENTS equal blade ranges in patch space, used to dispatch only the visible part of a patch.
+	//Empty if the blades are not ordered spatially, or follow a deforming mesh.
+	struct Segment
+	{
+		glm::vec3 min, max;
+		unsigned int first, count;
+	};
+	std::vector<Segment> segments;
+
+	//Only for patches generated with sortBladesInPatch: index of every blade in the generation order of its field,
+	//counted over all face groups of a streamed field, so tools can map the sorted blades back to stable ids
+	std::vector<unsigned int> sourceIds;
 public:
-	GrassPatch(const std::vector<glm::vec4>& pos, const std::vector<glm::vec4>& v1, const std::vector<glm::vec4>& v2, const std::vector<glm::vec4>& attr, const std::vector<glm::vec4>& debug, const BladeShape = THRESHTRIANGLEMINW);
+	//Uploads blades [first, first + count). All blades get the same debug color.
+	GrassPatch(const BladeBuffer& blades, const unsigned int first, const unsigned int count, const glm::vec4& debugColor, const BladeShape = THRESHTRIANGLEMINW);
+	//Uploads amountBlades blades straight from memory, e.g. a mapped bake file. anchor may be 0.
+	GrassPatch(const glm::vec4* pos, const glm::vec4* v1, const glm::vec4* v2, const glm::vec4* attr, const glm::vec4* anchor, const unsigned int amountBlades, const glm::vec4& debugColor, const BladeShape = THRESHTRIANGLEMINW);
 	~GrassPatch();
 
 	void updateForce(const Shader& shader);
+	//Only updates the blades [first, first + count)
+	void updateForce(const Shader& shader, const unsigned int first, const unsigned int count);
+	void reproject(const Shader& shader);
+
+	//Runs updateForce on the CPU through UpdateForces instead of the force shader. The pressure restarts at rest.
+	void setCpuForces(const bool enable);
+	bool usesCpuForces() const { return cpuForces; }
+	void updateForceCpu(const GrassForceParams& params, const unsigned int first, const unsigned int count);
+	//updateForceCpu in steps, so the simulation of many patches can be scheduled together:
+	//prepareForceCpu and uploadForceCpu need the GL context, simulateForceCpu can run on any thread for disjoint ranges
+	void prepareForceCpu();
+	void simulateForceCpu(const GrassForceParams& params, const unsigned int first, const unsigned int count);
+	void uploadForceCpu(const unsigned int first, const unsigned int count);
+	void setCpuSleep(const bool enable);
+	bool usesCpuSleep() const { return cpuSleep; }
+	//Wakes all blades if wind, gravity or the transform differ from the last call
+	void wakeOnForceChange(const GrassForceParams& params);
+	void wakeForceCpu();
+	void wakeForceCpu(const unsigned int first, const unsigned int count);
+	//False if every blade of the range sleeps, then the range can be skipped unless a collider is near
+	bool awakeForceCpu(const unsigned int first, const unsigned int count) const;
 	void updateVisibility(const Shader& shader, const Shader& copyBuffer);
+	//Only the given ranges of first blade and amount of blades can be visible. The caller issues the memory barrier before drawing.
+	void updateVisibility(const Shader& shader, const glm::uvec2* ranges, const unsigned int amountRanges);
 	void draw(const Shader& shader);
 
+	bool hasAnchors() const { return !anchorFaces.empty(); }
+
+	//Reads the blade buffers back from the GPU, including the anchors if the patch has some
+	void download(BladeBuffer& blades, glm::vec4& debugColor) const;
+
 	unsigned int fetchBladesDrawn();
 	double fetchTimeForce();
 	double fetchTimeVis();
@@ -78,6 +171,11 @@ public:
 #pragma endregion
 
 #pragma region Grass
+//Tile sizes in work groups of Shader::max_work_group_size_X, part of the bake key
+#define OPTIMAL_TILE_FACTOR 10
+//Candidate tile sizes of the auto tuner
+static const unsigned int autoTuneTileFactors[] = { 2, 5, 10, 20, 40, 80 };
+
 enum GrassDistribution
 {
 	UNIFORM, CLUSTER
@@ -87,7 +185,7 @@ enum GrassSpacialDistribution
 {
 	FACE_RANDOM, FACE_AREA
 };
-	
+
 struct GrassGravity
 {
 	glm::vec4 gravityVector;
@@ -104,8 +202,11 @@ struct GrassPatchInfo
 	glm::vec4 tessellationProps;
 	bool visible;
 	bool forceVisible;
+	unsigned int tileSize; //Blades per patch the field was cut with, 0 if the field was not tiled
 };
 
+class AttributeMap;
+
 struct GrassCreateBladeParams
 {
 	float density;
@@ -120,6 +221,23 @@ struct GrassCreateBladeParams
 	float bladeMaxBend;
 	BladeShape shape;
 	glm::vec4 tessellationProps;
+	unsigned long long seed = 0; //Equal seeds and params always generate the same blades
+	unsigned int generationMemoryLimitMB = 512; //Larger fields are generated and uploaded one spatial face group at a time
+	bool attachToFaces = false; //Blades keep their face and barycentric coordinates, so Grass::Reproject can follow a deforming mesh
+	GrassPartitionStrategy partitionStrategy = PARTITION_CLUSTERING; //The curve strategies are linear in the amount of blades, median split gives the tightest bounds
+	unsigned int partitionRefineIterations = 0; //Constrained k-means iterations after the partitioning, 0 disables the refinement
+	float partitionRefineSeconds = 30.0f; //Time budget of the refinement
+	bool autoTuneTileSize = false; //Chooses the blades per patch with a cost model instead of OPTIMAL_TILE_FACTOR work groups
+	unsigned int autoTuneCameras = 64; //Sampled camera poses of the cost model
+	float autoTuneViewDistance = 100.0f; //Far plane of the sampled cameras
+	bool sortBladesInPatch = false; //Orders the blades of every patch along a Morton curve, GrassPatch::sourceIds keeps the generation order
+	std::vector<GrassShapeWeight> shapeMix; //Every blade draws its shape with these weights, so mixed shapes share patches. Empty uses shape for all blades.
+	bool cpuForces = false; //The patches simulate their forces with UpdateForces on the CPU instead of the force shader, see GrassPatch::setCpuForces
+
+	//Optional maps, sampled through the UVs of the faces. Density scales the amount of blades, height and width scale the blades.
+	AttributeMap* densityMap = 0;
+	AttributeMap* bladeHeightMap = 0;
+	AttributeMap* bladeWidthMap = 0;
 };
 
 class GrassOvermind;
@@ -127,19 +245,67 @@ class GrassOvermind;
 class Grass
 {
 private:
-	void ProcessPatch(GrassPatchInfo& patch, const Camera& cam) const;
-	void UpdatePatchForce(const GrassPatchInfo& patch) const;
-	void UpdatePatchVisibility(const GrassPatchInfo& patch) const;
-	void DrawPatch(const GrassPatchInfo& patch) const;
+	//Patches with CPU forces are only collected, UpdateCpuForces simulates them together
+	void UpdateBatchForce(const PatchBatch& batch);
+	void UpdateCpuForces();
+	void UpdateBatchVisibility(const PatchBatch& batch) const;
+	void DrawBatch(const PatchBatch& batch) const;
+	//Broadphase of the frame: every force visible entry of frame.patches gets its span of colliders
+	void UpdateColliders();
+	//Appends the colliders intersecting the bounds, in list order, and returns first and amount. bounds may be 0, then all colliders are used.
+	glm::uvec2 AppendColliders(const BoundingBox* bounds, const glm::mat4& transform);
+
+	//Patches of one face group, built without GL on a worker thread and uploaded by the thread that owns the context
+	struct GeneratedPatches
+	{
+		const GrassCreateBladeParams* params = 0;
+		BladeBuffer blades; //Patch i holds the blades [tileStart[i], tileStart[i + 1])
+		std::vector<unsigned int> tileStart;
+		std::vector<glm::vec3> boundsMin, boundsMax;
+		std::vector<unsigned int> sourceIds; //Only with sortBladesInPatch, already offset by the earlier face groups
+		unsigned int tileSize = 0; //0 if the blades were not tiled
+	};
 
-	void DistributeFaceRandom(const GrassCreateBladeParams& p, std::vector <Geometry::TriangleFace>& faces);
-	void DistributeFaceArea(const GrassCreateBladeParams& p, std::vector <Geometry::TriangleFace>& faces);
-	void GeneratePatches(std::vector<glm::vec4>& bladePositions, std::vector<glm::vec4>& bladeV1, std::vector<glm::vec4>& bladeV2, std::vector<glm::vec4>& bladeAttr, const BladeShape shape, const glm::vec4& tessellationProps);
+	void GenerateLayers(const std::vector<GrassCreateBladeParams>& params, std::vector<Geometry::TriangleFace>& faces);
+	//faceIds maps the given faces to the faces passed to Initialize, for the anchors
+	static void DistributeFaceRandom(const GrassCreateBladeParams& p, const unsigned int streamIndex, const std::vector<Geometry::TriangleFace>& faces, const std::vector<unsigned int>& faceIds, BladeBuffer& blades);
+	static void DistributeFaceArea(const GrassCreateBladeParams& p, const unsigned int streamIndex, const std::vector<Geometry::TriangleFace>& faces, const std::vector<unsigned int>& faceIds, BladeBuffer& blades);
+	//Blades are only tiled if they exceed maxBlades. firstSourceId is the amount of blades of the earlier face groups of the field.
+	static void BuildPatches(BladeBuffer blades, const GrassCreateBladeParams& params, const unsigned int maxBlades, const unsigned int firstSourceId, GeneratedPatches& generated);
+	void UploadPatches(GeneratedPatches& generated);
 
 	static Shader * updateForceShader;
 	static Shader * updateVisibilityShader;
 	static Shader * copyBufferShader;
 	static Shader * drawShader;
+	static Shader * reprojectShader;
+
+	GLuint reprojectFaceBuffer = 0;
+	void UpdateAnchorBounds(GrassPatchInfo& patch, const std::vector<Geometry::TriangleFace>& faces, const bool computeMargin) const;
+	void UpdateBoundingObject();
+
+	PatchHierarchy patchHierarchy; //Rebuilt with the bounding object
+	PatchFrame frame; //Batches of the current frame
+	GrassForceParams forceParams; //Force uniforms of the current frame, for patches with CPU forces
+	std::vector<glm::vec2> heightFieldSamples; //Read back once for patches with CPU forces
+	GrassHeightField heightField;
+	//CPU force ranges of the current frame
+	struct CpuForceJob
+	{
+		GrassPatch* patch;
+		GrassForceParams params;
+		unsigned int first, count;
+	};
+	std::vector<CpuForceJob> cpuForceJobs;
+	SpatialHash colliderHash;
+	float colliderCellSize = 1.0f; //Mean patch size, so a patch query only touches a few cells
+	//Colliders of the frame, entry i of frame.patches uses colliders [colliderSpans[i].x, colliderSpans[i].x + colliderSpans[i].y).
+	//The shader reads them from colliderBuffer, the memory is kept between frames.
+	std::vector<glm::vec4> colliders;
+	std::vector<glm::uvec2> colliderSpans;
+	std::vector<unsigned int> colliderIndices;
+	GLuint colliderBuffer = 0;
+	unsigned int colliderBufferSize = 0;
 
 public:
 	static Texture2D * diffuseTexture;
@@ -180,6 +346,17 @@ public:
 
 	void Initialize(const std::vector<GrassCreateBladeParams>& params, std::vector<Geometry::TriangleFace>& faces);
 	void Draw(const float dt, const Camera& cam);
+
+	/**
+	*  Moves the blades of patches generated with attachToFaces onto the deformed faces. faces must have the same
+	*  order as the faces passed to Initialize. Positions and up vectors are refreshed on the GPU, v1 and v2 follow the ground position.
+	*/
+	void Reproject(const std::vector<Geometry::TriangleFace>& faces);
+
+	//Switches all patches between the force shader and the CPU force update
+	void setCpuForces(const bool enable);
+	//True if any patch simulates its forces on the CPU
+	bool usesCpuForces() const;
 };
 #pragma endregion
 
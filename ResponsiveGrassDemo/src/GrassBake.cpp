@@ -0,0 +1,356 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "GrassBake.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "BoundingBox.h"
+#include "AttributeMap.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+//Read-only mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile(const std::string& file) : data(0), size(0)
+	{
+#ifdef _WIN32
+		fileHandle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+		mappingHandle = 0;
+		if (fileHandle == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+		{
+			return;
+		}
+		mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+		if (mappingHandle == 0)
+		{
+			return;
+		}
+		data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		size = (data != 0) ? (unsigned long long)fileSize.QuadPart : 0;
+#else
+		fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			return;
+		}
+		void* mapped = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			return;
+		}
+		data = (const char*)mapped;
+		size = (unsigned long long)info.st_size;
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (data != 0) UnmapViewOfFile(data);
+		if (mappingHandle != 0) CloseHandle(mappingHandle);
+		if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+#else
+		if (data != 0) munmap((void*)data, (size_t)size);
+		if (fd >= 0) close(fd);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data;
+	unsigned long long size;
+
+private:
+#ifdef _WIN32
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+#else
+	int fd;
+#endif
+};
+
+//FNV-1a on 32 bit words
+inline void hashWords(unsigned long long& hash, const void* data, const unsigned int amountWords)
+{
+	const unsigned int* words = (const unsigned int*)data;
+	for (unsigned int i = 0; i < amountWords; i++)
+	{
+		hash = (hash ^ words[i]) * FNV_PRIME;
+	}
+}
+
+template<typename T>
+inline void hashValue(unsigned long long& hash, const T& value)
+{
+	static_assert(sizeof(T) % 4 == 0, "Only hash types made of 32 bit words");
+	hashWords(hash, &value, sizeof(T) / 4);
+}
+
+void hashMap(unsigned long long& hash, const AttributeMap* map)
+{
+	if (map == 0)
+	{
+		hashValue(hash, 0u);
+		return;
+	}
+	hashValue(hash, map->Width());
+	hashValue(hash, map->Height());
+	hashWords(hash, map->Data(), map->Width() * map->Height());
+}
+
+unsigned long long GrassBake::computeKey(const std::vector<Geometry::TriangleFace>& faces, const std::vector<GrassCreateBladeParams>& params, const unsigned int maxAmountBlades)
+{
+	unsigned long long hash = FNV_OFFSET;
+	hashValue(hash, (unsigned int)GRASS_BAKE_VERSION);
+	hashValue(hash, maxAmountBlades); //Decides whether a field gets tiled
+
+	//The tile sizes are multiples of the work group size, which differs between GPUs
+	hashValue(hash, (unsigned int)Shader::max_work_group_size_X);
+	hashValue(hash, (unsigned int)OPTIMAL_TILE_FACTOR);
+	hashValue(hash, (unsigned int)(sizeof(autoTuneTileFactors) / sizeof(autoTuneTileFactors[0])));
+	for (unsigned int i = 0; i < sizeof(autoTuneTileFactors) / sizeof(autoTuneTileFactors[0]); i++)
+	{
+		hashValue(hash, autoTuneTileFactors[i]);
+	}
+
+	hashValue(hash, (unsigned int)faces.size());
+	for (unsigned int i = 0; i < faces.size(); i++)
+	{
+		const Geometry::TriangleFace& f = faces[i];
+		for (unsigned int j = 0; j < 3; j++)
+		{
+			hashValue(hash, f.vertices[j].position);
+			hashValue(hash, f.vertices[j].normal);
+			hashValue(hash, f.vertices[j].uv);
+		}
+		hashValue(hash, f.faceNormal);
+		hashValue(hash, f.area);
+	}
+
+	//Field by field, so padding never ends up in the key
+	hashValue(hash, (unsigned int)params.size());
+	for (unsigned int i = 0; i < params.size(); i++)
+	{
+		const GrassCreateBladeParams& p = params[i];
+		hashValue(hash, p.density);
+		hashValue(hash, (unsigned int)p.distribution);
+		hashValue(hash, p.clusterPercentage);
+		hashValue(hash, (unsigned int)p.spacialDistribution);
+		hashValue(hash, p.bladeMinHeight);
+		hashValue(hash, p.bladeMaxHeight);
+		hashValue(hash, p.bladeMinWidth);
+		hashValue(hash, p.bladeMaxWidth);
+		hashValue(hash, p.bladeMinBend);
+		hashValue(hash, p.bladeMaxBend);
+		hashValue(hash, (unsigned int)p.shape);
+		hashValue(hash, p.tessellationProps);
+		hashValue(hash, p.seed);
+		hashValue(hash, p.generationMemoryLimitMB);
+		hashValue(hash, (unsigned int)p.attachToFaces);
+		hashValue(hash, (unsigned int)p.partitionStrategy);
+		hashValue(hash, p.partitionRefineIterations);
+		hashValue(hash, p.partitionRefineSeconds);
+		hashValue(hash, (unsigned int)p.autoTuneTileSize);
+		hashValue(hash, p.autoTuneCameras);
+		hashValue(hash, p.autoTuneViewDistance);
+		hashValue(hash, (unsigned int)p.sortBladesInPatch);
+		hashValue(hash, (unsigned int)p.cpuForces);
+		hashValue(hash, (unsigned int)p.shapeMix.size());
+		for (unsigned int s = 0; s < p.shapeMix.size(); s++)
+		{
+			hashValue(hash, (unsigned int)p.shapeMix[s].shape);
+			hashValue(hash, p.shapeMix[s].weight);
+		}
+		hashMap(hash, p.densityMap);
+		hashMap(hash, p.bladeHeightMap);
+		hashMap(hash, p.bladeWidthMap);
+	}
+
+	return hash;
+}
+
+std::string GrassBake::fileName(const unsigned long long key)
+{
+	char name[32];
+	sprintf(name, "Grass_%016llx", key);
+	return GENERATEDFILESPATH + name + GRASS_BAKE_EXTENSION;
+}
+
+bool GrassBake::load(const std::string& file, const unsigned long long key, std::vector<GrassPatchInfo>& patches)
+{
+	MappedFile mapped(file);
+	if (mapped.data == 0 || mapped.size < sizeof(FileHeader))
+	{
+		return false;
+	}
+
+	const FileHeader* header = (const FileHeader*)mapped.data;
+	if (strncmp(header->magic, GRASS_BAKE_MAGIC, sizeof(header->magic)) != 0 || header->version != GRASS_BAKE_VERSION || header->key != key)
+	{
+		std::cout << "Grass bake " << file << " is outdated" << std::endl;
+		return false;
+	}
+
+	//Validate the whole file before anything is uploaded
+	if ((unsigned long long)header->amountPatches * sizeof(PatchHeader) > mapped.size)
+	{
+		std::cout << "Grass bake " << file << " is truncated" << std::endl;
+		return false;
+	}
+	std::vector<unsigned long long> offsets(header->amountPatches);
+	unsigned long long offset = sizeof(FileHeader);
+	for (unsigned int i = 0; i < header->amountPatches; i++)
+	{
+		if (offset + sizeof(PatchHeader) > mapped.size)
+		{
+			std::cout << "Grass bake " << file << " is truncated" << std::endl;
+			return false;
+		}
+		offsets[i] = offset;
+		const PatchHeader* ph = (const PatchHeader*)(mapped.data + offset);
+		offset += sizeof(PatchHeader) + (ph->hasAnchors != 0 ? 5ull : 4ull) * ph->amountBlades * sizeof(glm::vec4);
+		offset += (ph->hasSourceIds != 0) ? (unsigned long long)ph->amountBlades * sizeof(unsigned int) : 0ull;
+	}
+	if (offset != mapped.size)
+	{
+		std::cout << "Grass bake " << file << " has an invalid size" << std::endl;
+		return false;
+	}
+
+	for (unsigned int i = 0; i < header->amountPatches; i++)
+	{
+		const PatchHeader* ph = (const PatchHeader*)(mapped.data + offsets[i]);
+		const glm::vec4* blades = (const glm::vec4*)(ph + 1);
+		const unsigned int n = ph->amountBlades;
+
+		GrassPatchInfo p;
+		p.modelMatrix = glm::mat4(1.0f);
+		p.tessellationProps = glm::vec4(ph->tessellationProps[0], ph->tessellationProps[1], ph->tessellationProps[2], ph->tessellationProps[3]);
+		p.patch = new GrassPatch(blades, blades + n, blades + 2 * n, blades + 3 * n, (ph->hasAnchors != 0) ? blades + 4 * n : 0, n, glm::vec4(ph->debugColor[0], ph->debugColor[1], ph->debugColor[2], ph->debugColor[3]), (BladeShape)ph->shape);
+		p.bounds = new BoundingBox(ph->bounds[0], ph->bounds[1], ph->bounds[2], ph->bounds[3], ph->bounds[4], ph->bounds[5]);
+		p.tileSize = ph->tileSize;
+		if (ph->hasSourceIds != 0)
+		{
+			const unsigned int* sourceIds = (const unsigned int*)(blades + ((ph->hasAnchors != 0) ? 5 : 4) * n);
+			p.patch->sourceIds.assign(sourceIds, sourceIds + n);
+		}
+		if (ph->cpuForces != 0)
+		{
+			p.patch->setCpuForces(true);
+		}
+		patches.push_back(p);
+	}
+
+	std::cout << "Loaded " << header->amountPatches << " grass patches from " << file << std::endl;
+	return true;
+}
+
+bool GrassBake::save(const std::string& file, const unsigned long long key, const std::vector<GrassPatchInfo>& patches, const unsigned int firstPatch)
+{
+	//Written to a temporary file first, so an interrupted bake never looks valid
+	std::string tempFile = file + ".tmp";
+	std::ofstream out(tempFile.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cout << "Could not open file to write grass bake. Filename = " << file << std::endl;
+		return false;
+	}
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, GRASS_BAKE_MAGIC, sizeof(header.magic));
+	header.version = GRASS_BAKE_VERSION;
+	header.amountPatches = (unsigned int)(patches.size() - firstPatch);
+	header.key = key;
+	out.write((const char*)&header, sizeof(header));
+
+	BladeBuffer blades;
+	for (unsigned int i = firstPatch; i < patches.size(); i++)
+	{
+		const GrassPatchInfo& p = patches[i];
+		glm::vec4 debugColor;
+		p.patch->download(blades, debugColor);
+
+		PatchHeader ph;
+		ph.amountBlades = p.patch->amountBlades;
+		ph.shape = (unsigned int)p.patch->bladeShape;
+		ph.hasAnchors = p.patch->hasAnchors() ? 1 : 0;
+		ph.tileSize = p.tileSize;
+		ph.hasSourceIds = p.patch->sourceIds.empty() ? 0 : 1;
+		ph.cpuForces = p.patch->usesCpuForces() ? 1 : 0;
+		for (unsigned int j = 0; j < 4; j++)
+		{
+			ph.tessellationProps[j] = p.tessellationProps[j];
+			ph.debugColor[j] = debugColor[j];
+		}
+		ph.bounds[0] = p.bounds->xMin;
+		ph.bounds[1] = p.bounds->xMax;
+		ph.bounds[2] = p.bounds->yMin;
+		ph.bounds[3] = p.bounds->yMax;
+		ph.bounds[4] = p.bounds->zMin;
+		ph.bounds[5] = p.bounds->zMax;
+
+		out.write((const char*)&ph, sizeof(ph));
+		for (unsigned int a = 0; a < BladeBuffer::AMOUNT_ATTRIBUTES; a++)
+		{
+			out.write((const char*)blades.data((BladeBuffer::Attribute)a), blades.size() * sizeof(glm::vec4));
+		}
+		if (ph.hasAnchors != 0)
+		{
+			out.write((const char*)blades.anchor(), blades.size() * sizeof(glm::vec4));
+		}
+		if (ph.hasSourceIds != 0)
+		{
+			out.write((const char*)p.patch->sourceIds.data(), p.patch->sourceIds.size() * sizeof(unsigned int));
+		}
+	}
+
+	bool success = out.good();
+	out.close();
+	if (!success)
+	{
+		std::cout << "Could not write grass bake. Filename = " << file << std::endl;
+		remove(tempFile.c_str());
+		return false;
+	}
+
+	remove(file.c_str());
+	if (rename(tempFile.c_str(), file.c_str()) != 0)
+	{
+		std::cout << "Could not write grass bake. Filename = " << file << std::endl;
+		remove(tempFile.c_str());
+		return false;
+	}
+
+	std::cout << "Saved " << header.amountPatches << " grass patches to " << file << std::endl;
+	return true;
+}
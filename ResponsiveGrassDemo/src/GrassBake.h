@@ -0,0 +1,62 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef GRASSBAKE_H
+#define GRASSBAKE_H
+
+#include <vector>
+#include <string>
+#include "Common.h"
+#include "Geometry.h"
+#include "Grass.h"
+
+#define GRASS_BAKE_MAGIC "GRSBAKE"
+#define GRASS_BAKE_VERSION 5
+#define GRASS_BAKE_EXTENSION ".grassbake"
+
+/**
+*  Binary cache of generated grass patches, stored in GENERATEDFILESPATH.
+*  Layout: GrassBake::FileHeader, then for every patch a GrassBake::PatchHeader followed by the
+*  position, v1, v2 and attr arrays of the patch (amountBlades vec4 each), the anchor array if the patch has anchors
+*  and the source ids (amountBlades unsigned int) if its blades were sorted.
+*  Files are memory mapped on load and uploaded to the GPU without intermediate copies.
+*/
+class GrassBake
+{
+public:
+	struct FileHeader
+	{
+		char magic[8];
+		unsigned int version;
+		unsigned int amountPatches;
+		unsigned long long key;
+	};
+
+	struct PatchHeader
+	{
+		unsigned int amountBlades;
+		unsigned int shape;
+		float tessellationProps[4];
+		float bounds[6]; //xMin xMax yMin yMax zMin zMax
+		float debugColor[4];
+		unsigned int hasAnchors;
+		unsigned int tileSize; //Blades per patch the field was cut with, auto tuned or fixed, 0 if not tiled
+		unsigned int hasSourceIds;
+		unsigned int cpuForces;
+	};
+
+	//Hash of everything that influences the generated blades
+	static unsigned long long computeKey(const std::vector<Geometry::TriangleFace>& faces, const std::vector<GrassCreateBladeParams>& params, const unsigned int maxAmountBlades);
+
+	static std::string fileName(const unsigned long long key);
+
+	//Appends the baked patches, returns false without side effects if the file is missing, outdated or broken
+	static bool load(const std::string& file, const unsigned long long key, std::vector<GrassPatchInfo>& patches);
+
+	//Writes patches [firstPatch, patches.size()), must be called before the force update changed the blade buffers
+	static bool save(const std::string& file, const unsigned long long key, const std::vector<GrassPatchInfo>& patches, const unsigned int firstPatch);
+};
+
+#endif
@@ -0,0 +1,377 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "GrassForce.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+//Defined in GrassForceSSE4.cpp and GrassForceAVX2.cpp
+void UpdateForcesSSE4(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count);
+void UpdateForcesAVX2(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count);
+
+//The helper functions of the shader, groundPosV2 and invHeight are globals there
+inline glm::vec3 calculateV1(const glm::vec3& groundPos, const glm::vec3& groundPosV2, const glm::vec3& bladeUp, const float height, const float invHeight)
+{
+	glm::vec3 g = groundPosV2 - glm::dot(groundPosV2, bladeUp) * bladeUp;
+	float v2ratio = glm::abs(glm::length(g) * invHeight);
+	float fac = glm::max(1.0f - v2ratio, 0.05f * glm::max(v2ratio, 1.0f));
+	return groundPos + bladeUp * height * fac;
+}
+
+inline void makePersistentLength(const glm::vec3& groundPos, const glm::vec3& groundPosV2, glm::vec3& v1, glm::vec3& v2, const float height)
+{
+	glm::vec3 v01 = v1 - groundPos;
+	glm::vec3 v12 = v2 - v1;
+	float lv01 = glm::length(v01);
+	float lv12 = glm::length(v12);
+
+	float L1 = lv01 + lv12;
+	float L0 = glm::length(groundPosV2);
+	float L = (2.0f * L0 + L1) / 3.0f; //http://steve.hollasch.net/cgindex/curves/cbezarclen.html
+
+	float ldiff = height / L;
+	v01 = v01 * ldiff;
+	v12 = v12 * ldiff;
+	v1 = groundPos + v01;
+	v2 = v1 + v12;
+}
+
+inline void ensureValidV2Pos(glm::vec3& v2, const glm::vec3& groundPosV2, const glm::vec3& bladeUp)
+{
+	v2 += bladeUp * -glm::min(glm::dot(bladeUp, groundPosV2), 0.0f);
+}
+
+//Ground correction, v1 and length correction, in the order of the shader
+inline void correctBlade(const glm::vec3& groundPos, const glm::vec3& bladeUp, const float height, const float invHeight, glm::vec3& v1, glm::vec3& v2)
+{
+	glm::vec3 groundPosV2 = v2 - groundPos;
+	ensureValidV2Pos(v2, groundPosV2, bladeUp);
+	v1 = calculateV1(groundPos, groundPosV2, bladeUp, height, invHeight);
+	makePersistentLength(groundPos, groundPosV2, v1, v2, height);
+}
+
+//Sets the bits of mask in word to bits
+static void writeWordBits(unsigned int* word, const unsigned int mask, const unsigned int bits)
+{
+	unsigned int old = *(volatile unsigned int*)word;
+	for (;;)
+	{
+		unsigned int desired = (old & ~mask) | (bits & mask);
+		if (desired == old)
+		{
+			return;
+		}
+#ifdef _MSC_VER
+		unsigned int previous = (unsigned int)_InterlockedCompareExchange((volatile long*)word, (long)desired, (long)old);
+#else
+		unsigned int previous = __sync_val_compare_and_swap(word, old, desired);
+#endif
+		if (previous == old)
+		{
+			return;
+		}
+		old = previous;
+	}
+}
+
+unsigned int ReadAwakeBits(const unsigned int* awake, const unsigned int id, const unsigned int amount)
+{
+	const unsigned int word = id >> 5;
+	const unsigned int shift = id & 31;
+	unsigned long long bits = *(volatile const unsigned int*)(awake + word);
+	if (shift + amount > 32)
+	{
+		bits |= (unsigned long long)*(volatile const unsigned int*)(awake + word + 1) << 32;
+	}
+	return (unsigned int)(bits >> shift) & (unsigned int)((1ull << amount) - 1);
+}
+
+void WriteAwakeBits(unsigned int* awake, const unsigned int id, const unsigned int amount, const unsigned int bits)
+{
+	const unsigned int word = id >> 5;
+	const unsigned int shift = id & 31;
+	const unsigned long long mask = ((1ull << amount) - 1) << shift;
+	const unsigned long long shifted = (unsigned long long)bits << shift;
+	writeWordBits(awake + word, (unsigned int)mask, (unsigned int)shifted);
+	if (shift + amount > 32)
+	{
+		writeWordBits(awake + word + 1, (unsigned int)(mask >> 32), (unsigned int)(shifted >> 32));
+	}
+}
+
+float GrassHeightField::sample(const glm::vec2& xz) const
+{
+	if (samples == 0 || width == 0 || height == 0)
+	{
+		return 0.0f;
+	}
+
+	glm::vec2 uv = glm::clamp((xz - glm::vec2(bounds.x, bounds.y)) / glm::vec2(bounds.z, bounds.w), 0.0f, 1.0f);
+	glm::vec2 texel = uv * glm::vec2((float)width, (float)height) - 0.5f;
+	glm::vec2 base = glm::floor(texel);
+	glm::vec2 f = texel - base;
+
+	int x0 = glm::clamp((int)base.x, 0, (int)width - 1);
+	int y0 = glm::clamp((int)base.y, 0, (int)height - 1);
+	int x1 = glm::clamp((int)base.x + 1, 0, (int)width - 1);
+	int y1 = glm::clamp((int)base.y + 1, 0, (int)height - 1);
+
+	glm::vec2 s = glm::mix(glm::mix(samples[y0 * width + x0], samples[y0 * width + x1], f.x), glm::mix(samples[y1 * width + x0], samples[y1 * width + x1], f.x), f.y);
+	return s.x * s.y;
+}
+
+void UpdateForcesReference(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count)
+{
+	const glm::mat4& modelMatrix = params.modelMatrix;
+	const glm::mat4 invModelMatrix = glm::inverse(modelMatrix);
+	const glm::mat3 invTransModelMatrix = glm::inverse(glm::transpose(glm::mat3(modelMatrix)));
+	const float mdt = glm::min(params.dt, 1.0f);
+
+	const glm::vec4& gravityVec = params.gravityVec;
+	const glm::vec4& gravityPoint = params.gravityPoint;
+	const float useGravityPoint = params.useGravityPoint;
+	const glm::vec4& windData = params.windData;
+
+	for (unsigned int id = first; id < first + count; id++)
+	{
+		//a sleeping blade can only be woken by a collider
+		const bool asleep = params.awake != 0 && ReadAwakeBits(params.awake, id, 1) == 0;
+		if (asleep && params.amountSphereCollider == 0)
+		{
+			continue;
+		}
+
+		float dirAlpha = position[id].w;
+		float height = v1[id].w;
+		float invHeight = 1.0f / height;
+		float bendingFac = attr[id].w;
+		glm::vec3 groundPos = glm::vec3(modelMatrix * glm::vec4(glm::vec3(position[id]), 1.0f));
+
+		//direction of the blade
+		glm::vec3 bladeUp = glm::vec3(attr[id]);
+		float sd = glm::sin(dirAlpha);
+		float cd = glm::cos(dirAlpha);
+		glm::vec3 tmp = glm::normalize(glm::vec3(sd, sd + cd, cd)); //arbitrary vector for finding normal vector
+		glm::vec3 bladeDir = glm::normalize(glm::cross(bladeUp, tmp));
+		glm::vec3 bladeFront = glm::normalize(glm::cross(bladeUp, bladeDir));
+
+		bladeUp = glm::normalize(invTransModelMatrix * bladeUp);
+		bladeFront = glm::normalize(invTransModelMatrix * bladeFront);
+
+		float mapHeight = 0.0f;
+		if (params.heightField != 0)
+		{
+			mapHeight = params.heightField->sample(glm::vec2(groundPos.x, groundPos.z));
+			groundPos += bladeUp * mapHeight;
+		}
+
+		glm::vec3 idleV2 = groundPos + bladeUp * height;
+
+		//read pressure map
+		glm::vec4 oldPressure = pressure[id];
+		float collisionForce = glm::max(oldPressure.w - (1.0f - bendingFac) * 0.5f * mdt, 0.0f);
+
+		//apply old pressure
+		glm::vec3 bV2 = idleV2 + glm::vec3(oldPressure);
+		glm::vec3 groundPosV2 = bV2 - groundPos;
+
+		//gravity
+		const float h = height;
+		glm::vec3 grav = glm::normalize(glm::vec3(gravityVec)) * gravityVec.w * (1.0f - useGravityPoint) + glm::normalize(glm::vec3(gravityPoint) - bV2) * gravityPoint.w * useGravityPoint;
+		float sign = (glm::dot(glm::normalize(grav), bladeFront) < -0.01f) ? -1.0f : 1.0f;
+		grav += sign * bladeFront * h * (gravityVec.w * (1.0f - useGravityPoint) + gravityPoint.w * useGravityPoint) * 0.25f;
+		grav = grav * h * bendingFac * mdt;
+
+		//wind
+		glm::vec3 w(0.0f);
+		float windBound = 0.0f; //Largest length of w / (bendingFac * mdt) over time, for the sleep test
+		float windageHeight = glm::abs(glm::dot(groundPosV2, bladeUp)) * invHeight;
+		switch (params.windType)
+		{
+		case 0:
+			{
+				float windageDir = 1.0f - glm::abs(glm::dot(glm::normalize(glm::vec3(windData)), glm::normalize(groundPosV2)));
+				float windPos = 1.0f - glm::max((glm::cos((groundPos.x + groundPos.z) * 0.75f + windData.w) + glm::sin((groundPos.x + groundPos.y) * 0.5f + windData.w) + glm::sin((groundPos.y + groundPos.z) * 0.25f + windData.w)) / 3.0f, 0.0f);
+				w = glm::vec3(windData) * windageDir * windageHeight * windPos * windPos * bendingFac * mdt;
+				windBound = glm::length(glm::vec3(windData));
+			}
+			break;
+		case 1:
+			{
+				glm::vec3 windDir = groundPos - glm::vec3(windData);
+				float windDist = glm::length(windDir);
+				windDir /= windDist;
+				float windageDir = 1.0f;
+				windDir *= 100.0f;
+				float windAtten = glm::max(1.0f - glm::log2(windDist * 0.2f + 1.0f) * 0.25f, 0.0f);
+				float windPos = 1.0f - glm::max(glm::sin(windDist * 0.4f - windData.w * 4.0f), 0.0f);
+				w = windDir * windageDir * windAtten * windageHeight * windPos * bendingFac * mdt;
+				windBound = 100.0f * windAtten;
+			}
+			break;
+		case 2:
+			{
+				glm::vec3 windDir = groundPos - glm::vec3(windData);
+				float windDist = glm::length(windDir);
+				windDir /= windDist;
+				glm::vec3 windTangent = glm::normalize(glm::cross(windDir, bladeUp)) * 6.0f;
+				float windageDir = 1.0f - glm::abs(glm::dot(windDir, glm::normalize(groundPosV2)));
+				windDir *= 40.0f;
+				float windAtten = glm::max(1.0f - glm::log2(windDist * 0.5f + 1.0f) * 0.25f, 0.0f);
+				float windPos = glm::sin(windDist * 0.1f - windData.w * 1.5f);
+				windPos = windPos * windPos * windPos;
+				windDir += windTangent * (1.0f - windAtten * windAtten) * 10.0f;
+				w = windDir * windageDir * windAtten * windageHeight * windPos * bendingFac * mdt;
+				windBound = (40.0f + 60.0f * (1.0f - windAtten * windAtten)) * windAtten;
+			}
+			break;
+		}
+
+		//stiffness
+		glm::vec3 stiffness = (idleV2 - bV2) * (1.0f - bendingFac * 0.25f) * glm::max(1.0f - collisionForce, 0.1f) * mdt;
+
+		//apply new forces
+		bV2 += grav + w + stiffness;
+		glm::vec3 bV1;
+		correctBlade(groundPos, bladeUp, height, invHeight, bV1, bV2);
+
+		//Collision with SphereColliders
+		bool dataDirty = false;
+		bool inReach = false;
+		for (unsigned int colli = 0; colli < params.amountSphereCollider; colli++)
+		{
+			float r = params.sphereCollider[colli].w;
+			glm::vec3 cPos = glm::vec3(params.sphereCollider[colli]);
+
+			float d1 = glm::distance(groundPos, cPos) - r;
+			if (d1 >= height)
+			{
+				continue;
+			}
+			inReach = true;
+
+			//Case 1: v2 in sphere => move v2 to the nearest border
+			glm::vec3 v2cPos = cPos - bV2;
+			float l = glm::length(v2cPos);
+			float d2 = l - r;
+			if (d2 < 0.0f)
+			{
+				glm::vec3 collVec = (v2cPos / l) * d2;
+				collisionForce += glm::dot(collVec, collVec);
+				bV2 += collVec;
+				dataDirty = true;
+			}
+
+			//Case 2: Curve in sphere
+			glm::vec3 halfPoint = groundPos * 0.25f + 0.5f * bV1 + 0.25f * bV2;
+			glm::vec3 halfPointCPos = cPos - halfPoint;
+			float lh = glm::length(halfPointCPos);
+			float dHalf = lh - r;
+			if (dHalf < 0.0f)
+			{
+				glm::vec3 collVec = (halfPointCPos / lh) * dHalf * 4.0f;
+				collisionForce += glm::dot(collVec, collVec);
+				bV2 += collVec;
+				dataDirty = true;
+			}
+		}
+
+		//Set v1 and correct grass length if collision happened
+		if (dataDirty)
+		{
+			correctBlade(groundPos, bladeUp, height, invHeight, bV1, bV2);
+		}
+
+		if (asleep && !inReach)
+		{
+			continue;
+		}
+
+		//Save v1 and v2 and update pressure map
+		glm::vec3 newPressure = bV2 - idleV2;
+		glm::vec3 localV1 = glm::vec3(invModelMatrix * glm::vec4(bV1 - bladeUp * mapHeight, 1.0f));
+		glm::vec3 localV2 = glm::vec3(invModelMatrix * glm::vec4(bV2 - bladeUp * mapHeight, 1.0f));
+		float v2Speed = glm::length(localV2 - glm::vec3(v2[id]));
+		v1[id] = glm::vec4(localV1, v1[id].w);
+		v2[id] = glm::vec4(localV2, v2[id].w);
+		pressure[id] = glm::vec4(newPressure, collisionForce);
+
+		if (params.awake != 0)
+		{
+			bool calm = v2Speed < FORCE_SLEEP_SPEED * height * params.dt && windBound * bendingFac < FORCE_SLEEP_WIND * height
+				&& collisionForce < FORCE_SLEEP_COLLISION && !inReach;
+			WriteAwakeBits(params.awake, id, 1, calm ? 0u : 1u);
+		}
+	}
+}
+
+static GrassForceIsa detectForceIsaOnce()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	__cpuid(info, 1);
+	const bool sse4 = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) //the OS saves the ymm registers
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	const bool sse4 = __builtin_cpu_supports("sse4.1") != 0;
+	const bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+
+	if (avx2)
+	{
+		return FORCE_ISA_AVX2;
+	}
+	if (sse4)
+	{
+		return FORCE_ISA_SSE4;
+	}
+	return FORCE_ISA_SCALAR;
+}
+
+//Initialized before main, function local statics are not thread safe in VS2013 and the force update runs on the worker threads
+static const GrassForceIsa detectedForceIsa = detectForceIsaOnce();
+
+GrassForceIsa DetectForceIsa()
+{
+	return detectedForceIsa;
+}
+
+void UpdateForces(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count, const GrassForceIsa isa)
+{
+	switch (isa)
+	{
+	case FORCE_ISA_AVX2:
+		UpdateForcesAVX2(params, position, v1, v2, attr, pressure, first, count);
+		break;
+	case FORCE_ISA_SSE4:
+		UpdateForcesSSE4(params, position, v1, v2, attr, pressure, first, count);
+		break;
+	default:
+		UpdateForcesReference(params, position, v1, v2, attr, pressure, first, count);
+		break;
+	}
+}
+
+void UpdateForces(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count)
+{
+	UpdateForces(params, position, v1, v2, attr, pressure, first, count, DetectForceIsa());
+}
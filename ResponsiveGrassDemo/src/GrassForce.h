@@ -0,0 +1,101 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef GRASSFORCE_H
+#define GRASSFORCE_H
+
+#include <string>
+#include "Common.h"
+
+//A blade falls asleep when its update is below all three thresholds, it is woken by a collider in reach or by GrassPatch
+#define FORCE_SLEEP_SPEED 0.005f //Speed of v2 in blade heights per second
+#define FORCE_SLEEP_WIND 0.05f //Largest wind offset the blade can get at its position, in blade heights per second
+#define FORCE_SLEEP_COLLISION 0.001f //Collision force of the pressure map
+
+//CPU copy of a height map texture (RG32F, height = x * y), sampled bilinear with clamped coordinates like the GL sampler
+struct GrassHeightField
+{
+	const glm::vec2* samples = 0;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	glm::vec4 bounds = glm::vec4(0.0f); //xMin zMin xLength zLength
+
+	float sample(const glm::vec2& xz) const;
+};
+
+//The uniforms of GrassUpdateForcesShader
+struct GrassForceParams
+{
+	float dt = 0.0f;
+	glm::mat4 modelMatrix = glm::mat4(1.0f);
+
+	unsigned int windType = 99; //No wind
+	glm::vec4 windData = glm::vec4(0.0f);
+	glm::vec4 gravityVec = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+	glm::vec4 gravityPoint = glm::vec4(0.0f);
+	float useGravityPoint = 0.0f;
+
+	const glm::vec4* sphereCollider = 0;
+	unsigned int amountSphereCollider = 0;
+
+	const GrassHeightField* heightField = 0; //0 if the field has no height map
+
+	//Activity bitmask of the blades, bit i of word i / 32 is set while blade i is awake. 0 updates every blade like the shader.
+	//A sleeping blade keeps v1, v2 and its pressure until a collider reaches it, colliders are tested for all blades.
+	unsigned int* awake = 0;
+};
+
+//Bits [id, id + amount) of an activity mask, amount <= 32. The words are read and written atomically,
+//because neighbouring ranges that are updated concurrently can share a word.
+unsigned int ReadAwakeBits(const unsigned int* awake, const unsigned int id, const unsigned int amount);
+void WriteAwakeBits(unsigned int* awake, const unsigned int id, const unsigned int amount, const unsigned int bits);
+
+/**
+*  Scalar port of GrassUpdateForcesShader for the blades [first, first + count): gravity, stiffness recovery, wind,
+*  sphere colliders, length and ground correction. Works on the SoA layout of the patch buffers, v1 and v2 are updated in place.
+*  pressure holds the pressure map block of the patch, one texel per blade: offset of v2 from its idle position and collision force.
+*  Every blade only touches its own data, so ranges can be updated concurrently.
+*  With params.awake, sleeping blades without a collider in reach are skipped and the mask is updated.
+*/
+void UpdateForcesReference(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count);
+
+//Instruction sets of UpdateForces, ordered by preference
+enum GrassForceIsa
+{
+	FORCE_ISA_SCALAR, FORCE_ISA_SSE4, FORCE_ISA_AVX2
+};
+
+#pragma region GrassForceIsaMethods
+static std::string toString(GrassForceIsa isa)
+{
+	switch (isa)
+	{
+	case FORCE_ISA_SCALAR: return "Scalar";
+	case FORCE_ISA_SSE4: return "SSE4.1";
+	case FORCE_ISA_AVX2: return "AVX2";
+	}
+	return "No string added for this instruction set";
+}
+#pragma endregion
+
+//The best instruction set supported by the CPU and the OS, detected once
+GrassForceIsa DetectForceIsa();
+
+/**
+*  Vectorized UpdateForcesReference: 4 (SSE4.1) or 8 (AVX2) blades per iteration, the remaining count % width blades go through the scalar port.
+*  The lanes are gathered from the vec4 arrays by 4x4 transposes, so any first works; it is fastest with first a multiple of the width.
+*  sin, cos and log2 are polynomials and some operations are reordered, so the results differ from the reference.
+*  Tolerance: after one step, v1 and v2 are within 1e-4 * blade height of the reference (measured about 5e-5 on a field of 200 units),
+*  asserted by ResponsiveGrassDemo --force-check.
+*  A blade that lies within that tolerance of a branch threshold (collider border, gravity sign) may take the other branch.
+*/
+void UpdateForces(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count, const GrassForceIsa isa);
+//Uses DetectForceIsa
+void UpdateForces(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count);
+
+#endif
@@ -0,0 +1,107 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include <immintrin.h>
+#include "GrassForceKernel.h"
+
+//8 blades per iteration. The file is compiled without /arch:AVX2, only the intrinsics are VEX encoded,
+//so the inline code shared with other translation units (glm) can never end up with AVX instructions.
+struct FloatAVX2
+{
+	static const unsigned int WIDTH = 8;
+	__m256 v;
+
+	FloatAVX2() { }
+	FloatAVX2(const __m256 v) : v(v) { }
+	FloatAVX2(const float f) : v(_mm256_set1_ps(f)) { }
+
+	//The scalar tail and the caller are SSE code, clearing the upper halves avoids the AVX-SSE transition penalty
+	static void leave() { _mm256_zeroupper(); }
+};
+
+inline FloatAVX2 operator+(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_add_ps(a.v, b.v); }
+inline FloatAVX2 operator-(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_sub_ps(a.v, b.v); }
+inline FloatAVX2 operator*(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_mul_ps(a.v, b.v); }
+inline FloatAVX2 operator/(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_div_ps(a.v, b.v); }
+inline FloatAVX2 operator-(const FloatAVX2& a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+
+inline FloatAVX2 vmin(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_min_ps(a.v, b.v); }
+inline FloatAVX2 vmax(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_max_ps(a.v, b.v); }
+inline FloatAVX2 vabs(const FloatAVX2& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline FloatAVX2 vsqrt(const FloatAVX2& a) { return _mm256_sqrt_ps(a.v); }
+inline FloatAVX2 vfloor(const FloatAVX2& a) { return _mm256_floor_ps(a.v); }
+
+inline FloatAVX2 vless(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline FloatAVX2 vand(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_and_ps(a.v, b.v); }
+inline FloatAVX2 vor(const FloatAVX2& a, const FloatAVX2& b) { return _mm256_or_ps(a.v, b.v); }
+inline FloatAVX2 vselect(const FloatAVX2& mask, const FloatAVX2& a, const FloatAVX2& b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+inline bool vany(const FloatAVX2& mask) { return _mm256_movemask_ps(mask.v) != 0; }
+inline unsigned int vbits(const FloatAVX2& mask) { return (unsigned int)_mm256_movemask_ps(mask.v); }
+
+inline void vfromBits(const unsigned int bits, FloatAVX2& mask)
+{
+	__m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	mask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)bits), lanes), lanes));
+}
+
+inline FloatAVX2 vexponent(const FloatAVX2& a)
+{
+	__m256i e = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(a.v), 23), _mm256_set1_epi32(127));
+	return _mm256_cvtepi32_ps(e);
+}
+
+inline FloatAVX2 vmantissa(const FloatAVX2& a)
+{
+	__m256i m = _mm256_or_si256(_mm256_and_si256(_mm256_castps_si256(a.v), _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000));
+	return _mm256_castsi256_ps(m);
+}
+
+inline void vload(const float* p, FloatAVX2& a) { a = _mm256_loadu_ps(p); }
+inline void vstore(float* p, const FloatAVX2& a) { _mm256_storeu_ps(p, a.v); }
+
+//Blade i goes to the low half for i < 4 and to the high half otherwise, then both halves are transposed like _MM_TRANSPOSE4_PS
+inline void vloadTransposed(const glm::vec4* p, FloatAVX2& x, FloatAVX2& y, FloatAVX2& z, FloatAVX2& w)
+{
+	__m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&p[0].x)), _mm_loadu_ps(&p[4].x), 1);
+	__m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&p[1].x)), _mm_loadu_ps(&p[5].x), 1);
+	__m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&p[2].x)), _mm_loadu_ps(&p[6].x), 1);
+	__m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&p[3].x)), _mm_loadu_ps(&p[7].x), 1);
+
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+	__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+	__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+	x = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	y = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	z = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	w = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+inline void vstoreTransposed(glm::vec4* p, const FloatAVX2& x, const FloatAVX2& y, const FloatAVX2& z, const FloatAVX2& w)
+{
+	__m256 t0 = _mm256_unpacklo_ps(x.v, y.v);
+	__m256 t1 = _mm256_unpackhi_ps(x.v, y.v);
+	__m256 t2 = _mm256_unpacklo_ps(z.v, w.v);
+	__m256 t3 = _mm256_unpackhi_ps(z.v, w.v);
+	__m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+	_mm_storeu_ps(&p[0].x, _mm256_castps256_ps128(r0));
+	_mm_storeu_ps(&p[1].x, _mm256_castps256_ps128(r1));
+	_mm_storeu_ps(&p[2].x, _mm256_castps256_ps128(r2));
+	_mm_storeu_ps(&p[3].x, _mm256_castps256_ps128(r3));
+	_mm_storeu_ps(&p[4].x, _mm256_extractf128_ps(r0, 1));
+	_mm_storeu_ps(&p[5].x, _mm256_extractf128_ps(r1, 1));
+	_mm_storeu_ps(&p[6].x, _mm256_extractf128_ps(r2, 1));
+	_mm_storeu_ps(&p[7].x, _mm256_extractf128_ps(r3, 1));
+}
+
+void UpdateForcesAVX2(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count)
+{
+	UpdateForcesSimd<FloatAVX2>(params, position, v1, v2, attr, pressure, first, count);
+}
@@ -0,0 +1,379 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef GRASSFORCEKERNEL_H
+#define GRASSFORCEKERNEL_H
+
+#include "GrassForce.h"
+
+/**
+*  UpdateForcesReference written once for a SIMD float type V that holds V::WIDTH blades, one blade per lane.
+*  Only included by the instruction set specific translation units, which define V and these functions for it:
+*  arithmetic operators, vmin, vmax, vabs, vsqrt, vfloor, the comparison vless returning a lane mask,
+*  vand, vor, vselect(mask, a, b), vany(mask), vbits(mask) and vfromBits(bits, mask) for one bit per lane,
+*  vexponent and vmantissa (x = mantissa * 2^exponent with mantissa in [1, 2)),
+*  vload and vstore for one float per lane and vloadTransposed and vstoreTransposed for one glm::vec4 per lane.
+*  V::leave() runs after the vector loop, before the scalar tail, to leave a clean register state for the scalar code.
+*  Uniform branches (wind type, colliders without any blade in reach) stay scalar, per blade branches become masks.
+*/
+
+template<typename V>
+struct SimdVec3
+{
+	V x, y, z;
+
+	SimdVec3() { }
+	SimdVec3(const V& x, const V& y, const V& z) : x(x), y(y), z(z) { }
+	explicit SimdVec3(const glm::vec3& v) : x(v.x), y(v.y), z(v.z) { }
+
+	SimdVec3 operator+(const SimdVec3& o) const { return SimdVec3(x + o.x, y + o.y, z + o.z); }
+	SimdVec3 operator-(const SimdVec3& o) const { return SimdVec3(x - o.x, y - o.y, z - o.z); }
+	SimdVec3 operator*(const V& s) const { return SimdVec3(x * s, y * s, z * s); }
+	SimdVec3 operator/(const V& s) const { return SimdVec3(x / s, y / s, z / s); }
+};
+
+template<typename V>
+inline V dot(const SimdVec3<V>& a, const SimdVec3<V>& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template<typename V>
+inline SimdVec3<V> cross(const SimdVec3<V>& a, const SimdVec3<V>& b)
+{
+	return SimdVec3<V>(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+template<typename V>
+inline V length(const SimdVec3<V>& a)
+{
+	return vsqrt(dot(a, a));
+}
+
+template<typename V>
+inline SimdVec3<V> normalize(const SimdVec3<V>& a)
+{
+	return a / length(a);
+}
+
+template<typename V>
+inline SimdVec3<V> select(const V& mask, const SimdVec3<V>& a, const SimdVec3<V>& b)
+{
+	return SimdVec3<V>(vselect(mask, a.x, b.x), vselect(mask, a.y, b.y), vselect(mask, a.z, b.z));
+}
+
+template<typename V>
+inline SimdVec3<V> transformPoint(const glm::mat4& m, const SimdVec3<V>& p)
+{
+	return SimdVec3<V>(
+		V(m[0][0]) * p.x + V(m[1][0]) * p.y + V(m[2][0]) * p.z + V(m[3][0]),
+		V(m[0][1]) * p.x + V(m[1][1]) * p.y + V(m[2][1]) * p.z + V(m[3][1]),
+		V(m[0][2]) * p.x + V(m[1][2]) * p.y + V(m[2][2]) * p.z + V(m[3][2]));
+}
+
+template<typename V>
+inline SimdVec3<V> transformVector(const glm::mat3& m, const SimdVec3<V>& p)
+{
+	return SimdVec3<V>(
+		V(m[0][0]) * p.x + V(m[1][0]) * p.y + V(m[2][0]) * p.z,
+		V(m[0][1]) * p.x + V(m[1][1]) * p.y + V(m[2][1]) * p.z,
+		V(m[0][2]) * p.x + V(m[1][2]) * p.y + V(m[2][2]) * p.z);
+}
+
+//Reduces to [-pi/2, pi/2] and evaluates the Taylor polynomial up to x^11: absolute error below 1e-6 plus the rounding of the reduction, about one ulp of x
+template<typename V>
+inline V simdSin(const V& x)
+{
+	V r = x - V(2.0f * PI_F) * vfloor(x * V(0.5f / PI_F) + V(0.5f)); //[-pi, pi)
+	V fold = vselect(vless(r, V(0.0f)), V(-PI_F), V(PI_F)) - r;
+	r = vselect(vless(V(0.5f * PI_F), vabs(r)), fold, r);
+
+	V r2 = r * r;
+	V p = V(-1.0f / 39916800.0f);
+	p = p * r2 + V(1.0f / 362880.0f);
+	p = p * r2 + V(-1.0f / 5040.0f);
+	p = p * r2 + V(1.0f / 120.0f);
+	p = p * r2 + V(-1.0f / 6.0f);
+	p = p * r2 + V(1.0f);
+	return p * r;
+}
+
+template<typename V>
+inline V simdCos(const V& x)
+{
+	return simdSin(x + V(0.5f * PI_F));
+}
+
+//log2(m) with t = (m - 1) / (m + 1) <= 1/3 from the series of atanh up to t^11, absolute error below 5e-7 (measured 4.1e-7 as m approaches 2)
+template<typename V>
+inline V simdLog2(const V& x)
+{
+	V m = vmantissa(x);
+	V t = (m - V(1.0f)) / (m + V(1.0f));
+	V t2 = t * t;
+	V p = V(1.0f / 11.0f);
+	p = p * t2 + V(1.0f / 9.0f);
+	p = p * t2 + V(1.0f / 7.0f);
+	p = p * t2 + V(1.0f / 5.0f);
+	p = p * t2 + V(1.0f / 3.0f);
+	p = p * t2 + V(1.0f);
+	return vexponent(x) + p * t * V(2.0f / 0.69314718f);
+}
+
+template<typename V>
+inline SimdVec3<V> simdCalculateV1(const SimdVec3<V>& groundPos, const SimdVec3<V>& groundPosV2, const SimdVec3<V>& bladeUp, const V& height, const V& invHeight)
+{
+	SimdVec3<V> g = groundPosV2 - bladeUp * dot(groundPosV2, bladeUp);
+	V v2ratio = vabs(length(g) * invHeight);
+	V fac = vmax(V(1.0f) - v2ratio, V(0.05f) * vmax(v2ratio, V(1.0f)));
+	return groundPos + bladeUp * (height * fac);
+}
+
+template<typename V>
+inline void simdCorrectBlade(const SimdVec3<V>& groundPos, const SimdVec3<V>& bladeUp, const V& height, const V& invHeight, SimdVec3<V>& v1, SimdVec3<V>& v2)
+{
+	SimdVec3<V> groundPosV2 = v2 - groundPos;
+	v2 = v2 + bladeUp * -vmin(dot(bladeUp, groundPosV2), V(0.0f));
+	v1 = simdCalculateV1(groundPos, groundPosV2, bladeUp, height, invHeight);
+
+	SimdVec3<V> v01 = v1 - groundPos;
+	SimdVec3<V> v12 = v2 - v1;
+	V L1 = length(v01) + length(v12);
+	V L0 = length(groundPosV2);
+	V ldiff = height / ((V(2.0f) * L0 + L1) * V(1.0f / 3.0f));
+	v1 = groundPos + v01 * ldiff;
+	v2 = v1 + v12 * ldiff;
+}
+
+template<typename V>
+void UpdateForcesSimd(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count)
+{
+	typedef SimdVec3<V> Vec3;
+	const unsigned int end = first + count - count % V::WIDTH;
+
+	const glm::mat4& modelMatrix = params.modelMatrix;
+	const glm::mat4 invModelMatrix = glm::inverse(modelMatrix);
+	const glm::mat3 invTransModelMatrix = glm::inverse(glm::transpose(glm::mat3(modelMatrix)));
+	const V mdt(glm::min(params.dt, 1.0f));
+
+	const glm::vec4& gravityVec = params.gravityVec;
+	const glm::vec4& gravityPoint = params.gravityPoint;
+	const float useGravityPoint = params.useGravityPoint;
+	const glm::vec4& windData = params.windData;
+
+	const Vec3 gravityDir(glm::normalize(glm::vec3(gravityVec)) * gravityVec.w * (1.0f - useGravityPoint));
+	const Vec3 gravityPos((glm::vec3(gravityPoint)));
+	const V gravityPointScale(gravityPoint.w * useGravityPoint);
+	const V gravityFrontScale((gravityVec.w * (1.0f - useGravityPoint) + gravityPoint.w * useGravityPoint) * 0.25f);
+	const Vec3 windVec((glm::vec3(windData)));
+	const Vec3 windDirection(glm::normalize(glm::vec3(windData)));
+	const V windTime(windData.w);
+	const V windStrength(glm::length(glm::vec3(windData)));
+
+	const bool sleeping = params.awake != 0;
+	const unsigned int allLanes = (1u << V::WIDTH) - 1;
+	const V sleepSpeed(FORCE_SLEEP_SPEED * params.dt);
+
+	for (unsigned int id = first; id < end; id += V::WIDTH)
+	{
+		//a group of sleeping blades can only be woken by a collider
+		unsigned int awakeBits = allLanes;
+		if (sleeping)
+		{
+			awakeBits = ReadAwakeBits(params.awake, id, V::WIDTH);
+			if (awakeBits == 0 && params.amountSphereCollider == 0)
+			{
+				continue;
+			}
+		}
+
+		Vec3 localPos, localV1, localV2, bladeUp, oldPressure;
+		V dirAlpha, height, width, bendingFac, oldCollisionForce;
+		vloadTransposed(position + id, localPos.x, localPos.y, localPos.z, dirAlpha);
+		vloadTransposed(v1 + id, localV1.x, localV1.y, localV1.z, height);
+		vloadTransposed(v2 + id, localV2.x, localV2.y, localV2.z, width);
+		vloadTransposed(attr + id, bladeUp.x, bladeUp.y, bladeUp.z, bendingFac);
+		vloadTransposed(pressure + id, oldPressure.x, oldPressure.y, oldPressure.z, oldCollisionForce);
+
+		V invHeight = V(1.0f) / height;
+		Vec3 groundPos = transformPoint(modelMatrix, localPos);
+
+		//direction of the blade
+		V sd = simdSin(dirAlpha);
+		V cd = simdCos(dirAlpha);
+		Vec3 tmp = normalize(Vec3(sd, sd + cd, cd));
+		Vec3 bladeDir = normalize(cross(bladeUp, tmp));
+		Vec3 bladeFront = normalize(cross(bladeUp, bladeDir));
+
+		bladeUp = normalize(transformVector(invTransModelMatrix, bladeUp));
+		bladeFront = normalize(transformVector(invTransModelMatrix, bladeFront));
+
+		//the height map is a gather, it is sampled per lane
+		V mapHeight(0.0f);
+		if (params.heightField != 0)
+		{
+			float x[V::WIDTH], z[V::WIDTH], sampled[V::WIDTH];
+			vstore(x, groundPos.x);
+			vstore(z, groundPos.z);
+			for (unsigned int i = 0; i < V::WIDTH; i++)
+			{
+				sampled[i] = params.heightField->sample(glm::vec2(x[i], z[i]));
+			}
+			vload(sampled, mapHeight);
+			groundPos = groundPos + bladeUp * mapHeight;
+		}
+
+		Vec3 idleV2 = groundPos + bladeUp * height;
+
+		//read pressure map
+		V collisionForce = vmax(oldCollisionForce - (V(1.0f) - bendingFac) * V(0.5f) * mdt, V(0.0f));
+
+		//apply old pressure
+		Vec3 bV2 = idleV2 + oldPressure;
+		Vec3 groundPosV2 = bV2 - groundPos;
+
+		//gravity
+		Vec3 grav = gravityDir + normalize(gravityPos - bV2) * gravityPointScale;
+		V sign = vselect(vless(dot(normalize(grav), bladeFront), V(-0.01f)), V(-1.0f), V(1.0f));
+		grav = grav + bladeFront * (sign * height * gravityFrontScale);
+		grav = grav * (height * bendingFac * mdt);
+
+		//wind
+		Vec3 w(V(0.0f), V(0.0f), V(0.0f));
+		V windBound(0.0f); //Largest length of w / (bendingFac * mdt) over time, for the sleep test
+		V windageHeight = vabs(dot(groundPosV2, bladeUp)) * invHeight;
+		switch (params.windType)
+		{
+		case 0:
+			{
+				V windageDir = V(1.0f) - vabs(dot(windDirection, normalize(groundPosV2)));
+				V wave = simdCos((groundPos.x + groundPos.z) * V(0.75f) + windTime) + simdSin((groundPos.x + groundPos.y) * V(0.5f) + windTime) + simdSin((groundPos.y + groundPos.z) * V(0.25f) + windTime);
+				V windPos = V(1.0f) - vmax(wave * V(1.0f / 3.0f), V(0.0f));
+				w = windVec * (windageDir * windageHeight * windPos * windPos * bendingFac * mdt);
+				windBound = windStrength;
+			}
+			break;
+		case 1:
+			{
+				Vec3 windDir = groundPos - windVec;
+				V windDist = length(windDir);
+				windDir = windDir * (V(100.0f) / windDist);
+				V windAtten = vmax(V(1.0f) - simdLog2(windDist * V(0.2f) + V(1.0f)) * V(0.25f), V(0.0f));
+				V windPos = V(1.0f) - vmax(simdSin(windDist * V(0.4f) - windTime * V(4.0f)), V(0.0f));
+				w = windDir * (windAtten * windageHeight * windPos * bendingFac * mdt);
+				windBound = V(100.0f) * windAtten;
+			}
+			break;
+		case 2:
+			{
+				Vec3 windDir = groundPos - windVec;
+				V windDist = length(windDir);
+				windDir = windDir / windDist;
+				Vec3 windTangent = normalize(cross(windDir, bladeUp)) * V(6.0f);
+				V windageDir = V(1.0f) - vabs(dot(windDir, normalize(groundPosV2)));
+				windDir = windDir * V(40.0f);
+				V windAtten = vmax(V(1.0f) - simdLog2(windDist * V(0.5f) + V(1.0f)) * V(0.25f), V(0.0f));
+				V windPos = simdSin(windDist * V(0.1f) - windTime * V(1.5f));
+				windPos = windPos * windPos * windPos;
+				windDir = windDir + windTangent * ((V(1.0f) - windAtten * windAtten) * V(10.0f));
+				w = windDir * (windageDir * windAtten * windageHeight * windPos * bendingFac * mdt);
+				windBound = (V(40.0f) + V(60.0f) * (V(1.0f) - windAtten * windAtten)) * windAtten;
+			}
+			break;
+		}
+
+		//stiffness
+		Vec3 stiffness = (idleV2 - bV2) * ((V(1.0f) - bendingFac * V(0.25f)) * vmax(V(1.0f) - collisionForce, V(0.1f)) * mdt);
+
+		//apply new forces
+		bV2 = bV2 + grav + w + stiffness;
+		Vec3 bV1;
+		simdCorrectBlade(groundPos, bladeUp, height, invHeight, bV1, bV2);
+
+		//Collision with SphereColliders, lanes out of reach of a collider are masked
+		V dataDirty(0.0f);
+		V anyInReach(0.0f);
+		for (unsigned int colli = 0; colli < params.amountSphereCollider; colli++)
+		{
+			V r(params.sphereCollider[colli].w);
+			Vec3 cPos((glm::vec3(params.sphereCollider[colli])));
+
+			V inReach = vless(length(groundPos - cPos) - r, height);
+			if (!vany(inReach))
+			{
+				continue;
+			}
+			anyInReach = vor(anyInReach, inReach);
+
+			//Case 1: v2 in sphere => move v2 to the nearest border
+			Vec3 v2cPos = cPos - bV2;
+			V l = length(v2cPos);
+			V d2 = l - r;
+			V hit = vand(inReach, vless(d2, V(0.0f)));
+			Vec3 collVec = v2cPos * (d2 / l);
+			collisionForce = collisionForce + vselect(hit, dot(collVec, collVec), V(0.0f));
+			bV2 = select(hit, bV2 + collVec, bV2);
+			dataDirty = vor(dataDirty, hit);
+
+			//Case 2: Curve in sphere
+			Vec3 halfPoint = groundPos * V(0.25f) + bV1 * V(0.5f) + bV2 * V(0.25f);
+			Vec3 halfPointCPos = cPos - halfPoint;
+			V lh = length(halfPointCPos);
+			V dHalf = lh - r;
+			hit = vand(inReach, vless(dHalf, V(0.0f)));
+			collVec = halfPointCPos * (dHalf * V(4.0f) / lh);
+			collisionForce = collisionForce + vselect(hit, dot(collVec, collVec), V(0.0f));
+			bV2 = select(hit, bV2 + collVec, bV2);
+			dataDirty = vor(dataDirty, hit);
+		}
+
+		//Set v1 and correct grass length if collision happened
+		if (vany(dataDirty))
+		{
+			Vec3 correctedV1, correctedV2 = bV2;
+			simdCorrectBlade(groundPos, bladeUp, height, invHeight, correctedV1, correctedV2);
+			bV1 = select(dataDirty, correctedV1, bV1);
+			bV2 = select(dataDirty, correctedV2, bV2);
+		}
+
+		//Save v1 and v2 and update pressure map
+		Vec3 newPressure = bV2 - idleV2;
+		Vec3 newV1 = transformPoint(invModelMatrix, bV1 - bladeUp * mapHeight);
+		Vec3 newV2 = transformPoint(invModelMatrix, bV2 - bladeUp * mapHeight);
+		if (sleeping)
+		{
+			//sleeping lanes without a collider in reach keep their data
+			V active;
+			vfromBits(awakeBits, active);
+			active = vor(active, anyInReach);
+			V calm = vand(vand(vless(length(newV2 - localV2), sleepSpeed * height), vless(windBound * bendingFac, V(FORCE_SLEEP_WIND) * height)),
+				vless(collisionForce, V(FORCE_SLEEP_COLLISION)));
+			unsigned int newAwakeBits = vbits(vselect(vor(calm, anyInReach), anyInReach, active));
+			if (newAwakeBits != awakeBits)
+			{
+				WriteAwakeBits(params.awake, id, V::WIDTH, newAwakeBits);
+			}
+
+			newV1 = select(active, newV1, localV1);
+			newV2 = select(active, newV2, localV2);
+			newPressure = select(active, newPressure, oldPressure);
+			collisionForce = vselect(active, collisionForce, oldCollisionForce);
+		}
+		vstoreTransposed(v1 + id, newV1.x, newV1.y, newV1.z, height);
+		vstoreTransposed(v2 + id, newV2.x, newV2.y, newV2.z, width);
+		vstoreTransposed(pressure + id, newPressure.x, newPressure.y, newPressure.z, collisionForce);
+	}
+
+	V::leave();
+
+	//scalar tail
+	if (end < first + count)
+	{
+		UpdateForcesReference(params, position, v1, v2, attr, pressure, end, first + count - end);
+	}
+}
+
+#endif
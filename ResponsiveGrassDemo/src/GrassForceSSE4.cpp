@@ -0,0 +1,92 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include <smmintrin.h>
+#include "GrassForceKernel.h"
+
+//4 blades per iteration, SSE4.1 is needed for floor and blend
+struct FloatSSE4
+{
+	static const unsigned int WIDTH = 4;
+	__m128 v;
+
+	FloatSSE4() { }
+	FloatSSE4(const __m128 v) : v(v) { }
+	FloatSSE4(const float f) : v(_mm_set1_ps(f)) { }
+
+	static void leave() { }
+};
+
+inline FloatSSE4 operator+(const FloatSSE4& a, const FloatSSE4& b) { return _mm_add_ps(a.v, b.v); }
+inline FloatSSE4 operator-(const FloatSSE4& a, const FloatSSE4& b) { return _mm_sub_ps(a.v, b.v); }
+inline FloatSSE4 operator*(const FloatSSE4& a, const FloatSSE4& b) { return _mm_mul_ps(a.v, b.v); }
+inline FloatSSE4 operator/(const FloatSSE4& a, const FloatSSE4& b) { return _mm_div_ps(a.v, b.v); }
+inline FloatSSE4 operator-(const FloatSSE4& a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+
+inline FloatSSE4 vmin(const FloatSSE4& a, const FloatSSE4& b) { return _mm_min_ps(a.v, b.v); }
+inline FloatSSE4 vmax(const FloatSSE4& a, const FloatSSE4& b) { return _mm_max_ps(a.v, b.v); }
+inline FloatSSE4 vabs(const FloatSSE4& a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline FloatSSE4 vsqrt(const FloatSSE4& a) { return _mm_sqrt_ps(a.v); }
+inline FloatSSE4 vfloor(const FloatSSE4& a) { return _mm_floor_ps(a.v); }
+
+inline FloatSSE4 vless(const FloatSSE4& a, const FloatSSE4& b) { return _mm_cmplt_ps(a.v, b.v); }
+inline FloatSSE4 vand(const FloatSSE4& a, const FloatSSE4& b) { return _mm_and_ps(a.v, b.v); }
+inline FloatSSE4 vor(const FloatSSE4& a, const FloatSSE4& b) { return _mm_or_ps(a.v, b.v); }
+inline FloatSSE4 vselect(const FloatSSE4& mask, const FloatSSE4& a, const FloatSSE4& b) { return _mm_blendv_ps(b.v, a.v, mask.v); }
+inline bool vany(const FloatSSE4& mask) { return _mm_movemask_ps(mask.v) != 0; }
+inline unsigned int vbits(const FloatSSE4& mask) { return (unsigned int)_mm_movemask_ps(mask.v); }
+
+inline void vfromBits(const unsigned int bits, FloatSSE4& mask)
+{
+	__m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+	mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)bits), lanes), lanes));
+}
+
+inline FloatSSE4 vexponent(const FloatSSE4& a)
+{
+	__m128i e = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(a.v), 23), _mm_set1_epi32(127));
+	return _mm_cvtepi32_ps(e);
+}
+
+inline FloatSSE4 vmantissa(const FloatSSE4& a)
+{
+	__m128i m = _mm_or_si128(_mm_and_si128(_mm_castps_si128(a.v), _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000));
+	return _mm_castsi128_ps(m);
+}
+
+inline void vload(const float* p, FloatSSE4& a) { a = _mm_loadu_ps(p); }
+inline void vstore(float* p, const FloatSSE4& a) { _mm_storeu_ps(p, a.v); }
+
+inline void vloadTransposed(const glm::vec4* p, FloatSSE4& x, FloatSSE4& y, FloatSSE4& z, FloatSSE4& w)
+{
+	__m128 r0 = _mm_loadu_ps(&p[0].x);
+	__m128 r1 = _mm_loadu_ps(&p[1].x);
+	__m128 r2 = _mm_loadu_ps(&p[2].x);
+	__m128 r3 = _mm_loadu_ps(&p[3].x);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	x = r0;
+	y = r1;
+	z = r2;
+	w = r3;
+}
+
+inline void vstoreTransposed(glm::vec4* p, const FloatSSE4& x, const FloatSSE4& y, const FloatSSE4& z, const FloatSSE4& w)
+{
+	__m128 r0 = x.v;
+	__m128 r1 = y.v;
+	__m128 r2 = z.v;
+	__m128 r3 = w.v;
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(&p[0].x, r0);
+	_mm_storeu_ps(&p[1].x, r1);
+	_mm_storeu_ps(&p[2].x, r2);
+	_mm_storeu_ps(&p[3].x, r3);
+}
+
+void UpdateForcesSSE4(const GrassForceParams& params, const glm::vec4* position, glm::vec4* v1, glm::vec4* v2, const glm::vec4* attr, glm::vec4* pressure,
+	const unsigned int first, const unsigned int count)
+{
+	UpdateForcesSimd<FloatSSE4>(params, position, v1, v2, attr, pressure, first, count);
+}
@@ -21,6 +21,10 @@ public:
 	void draw(const Camera& cam) override;
 	void drawGrass(const Camera& cam, const Clock& time);
 
+	//Replaces the faces after the mesh was deformed, blades generated with attachToFaces follow without regeneration
+	void deformFaces(const std::vector<Geometry::TriangleFace>& deformedFaces);
+	const std::vector<Geometry::TriangleFace>& getFaces() const { return faces; }
+
 	Grass* grass;
 
 private:
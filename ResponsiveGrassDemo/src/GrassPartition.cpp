@@ -0,0 +1,772 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "GrassPartition.h"
+
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+#include <cfloat>
+#include "Parallel.h"
+#include "Clock.h"
+#include "RadixSort.h"
+#include "SpaceFillingCurve.h"
+#include "Random.h"
+#include "glm\gtc\matrix_transform.hpp"
+
+#define PARTITION_CHUNK_SIZE 16384
+#define USE_MANHATTEN_DISTANCE false
+#define REFINE_NEIGHBORS 8
+
+//Auto tuning of the tile size
+#define AUTO_TUNE_PATCH_OVERHEAD_BLADES 4096 //Force, visibility and copy dispatch, indirect draw and their uniforms, in blades of work
+#define AUTO_TUNE_EYE_HEIGHT 1.7f
+#define AUTO_TUNE_FOV 60.0f
+#define AUTO_TUNE_ASPECT (16.0f / 9.0f)
+#define AUTO_TUNE_RANDOM_STREAM 0xFFFFFFFFu //Beyond the generation streams of any realistic amount of parameter sets and face groups
+
+float manDist(const glm::vec3& p1, const glm::vec3& p2)
+{
+	glm::vec3 dif = glm::abs(p1 - p2);
+	return dif.x + dif.y + dif.z;
+}
+
+struct {
+	bool operator()(const std::pair<unsigned int, float>& a, const std::pair<unsigned int, float>& b) const
+	{
+		return a.second < b.second;
+	}
+} sortingFunc;
+
+/**
+*  Equal-size spatial clustering: every tile starts from the nearest blades of a seed blade, remaining blades join the nearest tile.
+*  Fills order with the blade indices grouped by tile, tile i is [tileStart[i], tileStart[i + 1]).
+*/
+void PartitionByClustering(const glm::vec4* bladePositions, const unsigned int amountBlades, const unsigned int amountTiles, const unsigned int bladesPerTile, const glm::vec3& range,
+	std::vector<unsigned int>& order, std::vector<unsigned int>& tileStart)
+{
+	//Idee von http://statistical-research.com/spatial-clustering-with-equal-sizes/
+	int* clusterId = new int[amountBlades];
+	std::fill_n(clusterId, amountBlades, -1);
+
+	//Assign initial clusters
+	std::vector<std::pair<unsigned int, float>> sortedCandidates;
+	sortedCandidates.reserve(amountBlades);
+	float xRange = range.x;
+	float yRange = range.y;
+	float zRange = range.z;
+	for (unsigned int i = 0; i < amountBlades; i++)
+	{
+		if (xRange >= yRange && xRange >= zRange)
+			sortedCandidates.push_back(std::pair<unsigned int, float>(i, bladePositions[i].x));
+		else if (yRange >= xRange && yRange >= zRange)
+			sortedCandidates.push_back(std::pair<unsigned int, float>(i, bladePositions[i].y));
+		else 
+			sortedCandidates.push_back(std::pair<unsigned int, float>(i, bladePositions[i].z));
+	}
+	std::sort(sortedCandidates.begin(), sortedCandidates.end(), sortingFunc);
+	
+	int currentCluster = 0;
+	std::vector<std::pair<unsigned int, float>> clusterCandidates;
+	clusterCandidates.reserve(amountBlades - 1);
+	glm::vec3* clusterMeans = new glm::vec3[amountTiles];
+	for (unsigned int i = 0; i < amountBlades && (unsigned int)currentCluster < amountTiles; i++)
+	{
+		//if (clusterId[i] == -1)
+		if (clusterId[sortedCandidates[i].first] == -1)
+		{
+			//clusterId[i] = currentCluster;
+			clusterId[sortedCandidates[i].first] = currentCluster;
+			//clusterMeans[currentCluster] += glm::vec3(bladePositions[i].xyz) / (float)(bladesPerTile - 1);
+			clusterMeans[currentCluster] += glm::vec3(bladePositions[sortedCandidates[i].first].xyz) / (float)(bladesPerTile - 1);
+			clusterCandidates.clear();
+			for (unsigned int j = 0; j < amountBlades; j++)
+			{
+				//if (i != j && clusterId[j] == -1)
+				if (i != j && clusterId[sortedCandidates[j].first] == -1)
+				{
+					if (USE_MANHATTEN_DISTANCE)
+					{
+						//clusterCandidates.push_back(std::pair<unsigned int, float>(j, manDist(bladePositions[j].xyz, bladePositions[i].xyz)));
+						float d = manDist(bladePositions[sortedCandidates[j].first].xyz, bladePositions[sortedCandidates[i].first].xyz);
+						clusterCandidates.push_back(std::pair<unsigned int, float>(j, d*d));
+					}
+					else
+					{
+						//glm::vec3 vec = bladePositions[j].xyz - bladePositions[i].xyz;
+						glm::vec3 vec = bladePositions[sortedCandidates[j].first].xyz - bladePositions[sortedCandidates[i].first].xyz;
+						clusterCandidates.push_back(std::pair<unsigned int, float>(j, glm::dot(vec,vec)));
+					}
+				}
+			}
+			std::sort(clusterCandidates.begin(), clusterCandidates.end(), sortingFunc);
+
+
+			for (unsigned int c = 0; c < bladesPerTile-1; c++)
+			{
+				//clusterId[clusterCandidates[c].first] = currentCluster;
+				clusterId[sortedCandidates[clusterCandidates[c].first].first] = currentCluster;
+			}
+			currentCluster++;
+			//std::cout << "Cluster " << currentCluster << " initially finished" << std::endl;
+		}
+	}
+
+	for (unsigned int rest = 0; rest < amountBlades; rest++)
+	{
+		if (clusterId[rest] == -1)
+		{
+			unsigned int minCluster;
+			float minDist = FLT_MAX;
+			for (unsigned int i = 0; i < amountTiles; i++)
+			{
+				float dist;
+				if (USE_MANHATTEN_DISTANCE)
+				{
+					dist = manDist(clusterMeans[i], bladePositions[rest].xyz);
+				}
+				else
+				{
+					glm::vec3 vec = clusterMeans[i] - bladePositions[rest].xyz;
+					dist = glm::dot(vec, vec);
+				}
+				if (dist < minDist)
+				{
+					minDist = dist;
+					minCluster = i;
+				}
+			}
+			clusterId[rest] = minCluster;
+		}
+	}
+
+	delete[] clusterMeans;
+
+	//Counting sort by tile, so every tile is a contiguous range after a single gather
+	tileStart.assign(amountTiles + 1, 0);
+	for (unsigned int b = 0; b < amountBlades; b++)
+	{
+		tileStart[clusterId[b] + 1]++;
+	}
+	for (unsigned int i = 0; i < amountTiles; i++)
+	{
+		tileStart[i + 1] += tileStart[i];
+	}
+	order.resize(amountBlades);
+	std::vector<unsigned int> cursor(tileStart.begin(), tileStart.end() - 1);
+	for (unsigned int b = 0; b < amountBlades; b++)
+	{
+		order[cursor[clusterId[b]]++] = b;
+	}
+
+	delete[] clusterId;
+}
+
+/**
+*  Constrained (equal-size) k-means refinement of a partition, tile i is order[tileStart[i], tileStart[i + 1]).
+*  Every iteration recomputes the means of the changed tiles, pairs each tile with the neighboring tile it has the most blades to
+*  exchange with and swaps blades between the paired tiles in parallel, as long as a swap lowers the squared distances to the means.
+*  Nearest means and exchange counts are only recomputed for dirty tiles: tiles that changed, that have a changed neighbor, or that
+*  a changed mean moved closer to than their farthest neighbor. All other tiles keep them, so the cost follows the changes.
+*  Tile sizes never change. Stops without swaps or when the iteration or time budget is used up, so with a time budget
+*  the result depends on the machine. Prints the mean squared distance to the tile means per iteration.
+*/
+void RefinePartition(const glm::vec4* bladePositions, const unsigned int amountTiles, const std::vector<unsigned int>& tileStart, const unsigned int maxIterations, const float maxSeconds,
+	std::vector<unsigned int>& order)
+{
+	const unsigned int amountBlades = tileStart[amountTiles];
+	const unsigned int amountNeighbors = glm::min(amountTiles - 1, (unsigned int)REFINE_NEIGHBORS);
+	if (amountNeighbors == 0 || amountBlades == 0)
+	{
+		return;
+	}
+
+	std::vector<glm::vec3> means(amountTiles);
+	std::vector<double> squaredErrors(amountTiles);
+	std::vector<unsigned char> changed(amountTiles, 1);
+	std::vector<unsigned int> neighbors(amountTiles * amountNeighbors);
+	std::vector<unsigned int> closerCounts(amountTiles * amountNeighbors);
+	std::vector<float> farthestNeighbor(amountTiles); //Squared distance to the last of the nearest means
+	std::vector<unsigned int> changedTiles;
+	std::vector<int> partner(amountTiles);
+	std::vector<unsigned int> swapCounts(amountTiles);
+
+	Clock clock;
+	clock.Tick();
+	double elapsed = 0.0;
+	unsigned int iteration = 0;
+	while (true)
+	{
+		//Means and squared errors of the tiles that changed
+		parallelFor(amountTiles, 4, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+		{
+			for (unsigned int t = begin; t < end; t++)
+			{
+				if (!changed[t])
+				{
+					continue;
+				}
+				const unsigned int first = tileStart[t];
+				const unsigned int count = tileStart[t + 1] - first;
+				glm::dvec3 sum(0.0);
+				for (unsigned int i = 0; i < count; i++)
+				{
+					sum += glm::dvec3(glm::vec3(bladePositions[order[first + i]].xyz));
+				}
+				means[t] = glm::vec3(sum / (double)glm::max(count, 1u));
+				double error = 0.0;
+				for (unsigned int i = 0; i < count; i++)
+				{
+					glm::vec3 d = glm::vec3(bladePositions[order[first + i]].xyz) - means[t];
+					error += glm::dot(d, d);
+				}
+				squaredErrors[t] = error;
+			}
+		});
+
+		double meanSquaredError = 0.0;
+		for (unsigned int t = 0; t < amountTiles; t++)
+		{
+			meanSquaredError += squaredErrors[t];
+		}
+		meanSquaredError /= (double)amountBlades;
+		std::cout << "Refinement iteration " << iteration << ": MSE = " << std::to_string(meanSquaredError) << std::endl;
+
+		clock.Tick();
+		elapsed += clock.LastFrameTime();
+		if (iteration >= maxIterations || elapsed >= maxSeconds)
+		{
+			break;
+		}
+
+		changedTiles.clear();
+		for (unsigned int t = 0; t < amountTiles; t++)
+		{
+			if (changed[t])
+			{
+				changedTiles.push_back(t);
+			}
+		}
+
+		//Nearest tile means, and how many blades of a tile are closer to each of them than to their own mean
+		parallelFor(amountTiles, 4, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+		{
+			std::vector<std::pair<unsigned int, float>> candidates;
+			for (unsigned int t = begin; t < end; t++)
+			{
+				unsigned int* tileNeighbors = &neighbors[t * amountNeighbors];
+				unsigned int* tileCounts = &closerCounts[t * amountNeighbors];
+
+				bool dirty = changed[t] != 0;
+				for (unsigned int n = 0; n < amountNeighbors && !dirty; n++)
+				{
+					dirty = changed[tileNeighbors[n]] != 0;
+				}
+				for (unsigned int c = 0; c < changedTiles.size() && !dirty; c++)
+				{
+					glm::vec3 d = means[changedTiles[c]] - means[t];
+					dirty = glm::dot(d, d) < farthestNeighbor[t];
+				}
+				if (!dirty)
+				{
+					continue;
+				}
+
+				candidates.resize(amountTiles);
+				for (unsigned int s = 0; s < amountTiles; s++)
+				{
+					glm::vec3 d = means[s] - means[t];
+					candidates[s] = std::pair<unsigned int, float>(s, (s == t) ? FLT_MAX : glm::dot(d, d));
+				}
+				std::partial_sort(candidates.begin(), candidates.begin() + amountNeighbors, candidates.end(), sortingFunc);
+				farthestNeighbor[t] = candidates[amountNeighbors - 1].second;
+
+				for (unsigned int n = 0; n < amountNeighbors; n++)
+				{
+					tileNeighbors[n] = candidates[n].first;
+					tileCounts[n] = 0;
+				}
+				for (unsigned int i = tileStart[t]; i < tileStart[t + 1]; i++)
+				{
+					glm::vec3 pos = bladePositions[order[i]].xyz;
+					glm::vec3 dOwn = pos - means[t];
+					float own = glm::dot(dOwn, dOwn);
+					for (unsigned int n = 0; n < amountNeighbors; n++)
+					{
+						glm::vec3 d = pos - means[tileNeighbors[n]];
+						if (glm::dot(d, d) < own)
+						{
+							tileCounts[n]++;
+						}
+					}
+				}
+			}
+		});
+
+		//Greedy matching, tile pairs with the most possible exchanges first
+		std::vector<std::pair<unsigned int, float>> pairs;
+		for (unsigned int t = 0; t < amountTiles; t++)
+		{
+			for (unsigned int n = 0; n < amountNeighbors; n++)
+			{
+				const unsigned int s = neighbors[t * amountNeighbors + n];
+				if (s <= t)
+				{
+					continue;
+				}
+				unsigned int back = 0;
+				for (unsigned int m = 0; m < amountNeighbors; m++)
+				{
+					if (neighbors[s * amountNeighbors + m] == t)
+					{
+						back = closerCounts[s * amountNeighbors + m];
+					}
+				}
+				unsigned int exchanges = glm::min(closerCounts[t * amountNeighbors + n], back);
+				if (exchanges > 0)
+				{
+					pairs.push_back(std::pair<unsigned int, float>(t * amountTiles + s, -(float)exchanges));
+				}
+			}
+		}
+		std::stable_sort(pairs.begin(), pairs.end(), sortingFunc);
+		std::fill(partner.begin(), partner.end(), -1);
+		std::vector<unsigned int> matched;
+		for (unsigned int i = 0; i < pairs.size(); i++)
+		{
+			const unsigned int t = pairs[i].first / amountTiles;
+			const unsigned int s = pairs[i].first % amountTiles;
+			if (partner[t] < 0 && partner[s] < 0)
+			{
+				partner[t] = s;
+				partner[s] = t;
+				matched.push_back(t);
+			}
+		}
+
+		//Exchange the blades that gain most, the paired tiles are disjoint
+		std::fill(swapCounts.begin(), swapCounts.end(), 0);
+		parallelFor((unsigned int)matched.size(), 1, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+		{
+			for (unsigned int m = begin; m < end; m++)
+			{
+				const unsigned int t = matched[m];
+				const unsigned int s = partner[t];
+				std::vector<std::pair<unsigned int, float>> gainT, gainS;
+				for (unsigned int k = 0; k < 2; k++)
+				{
+					const unsigned int from = (k == 0) ? t : s;
+					const unsigned int to = (k == 0) ? s : t;
+					std::vector<std::pair<unsigned int, float>>& gain = (k == 0) ? gainT : gainS;
+					gain.reserve(tileStart[from + 1] - tileStart[from]);
+					for (unsigned int i = tileStart[from]; i < tileStart[from + 1]; i++)
+					{
+						glm::vec3 pos = bladePositions[order[i]].xyz;
+						glm::vec3 dTo = pos - means[to];
+						glm::vec3 dFrom = pos - means[from];
+						gain.push_back(std::pair<unsigned int, float>(i, glm::dot(dTo, dTo) - glm::dot(dFrom, dFrom)));
+					}
+					std::sort(gain.begin(), gain.end(), sortingFunc);
+				}
+
+				unsigned int swaps = 0;
+				while (swaps < gainT.size() && swaps < gainS.size() && gainT[swaps].second + gainS[swaps].second < 0.0f)
+				{
+					std::swap(order[gainT[swaps].first], order[gainS[swaps].first]);
+					swaps++;
+				}
+				swapCounts[t] = swaps;
+			}
+		});
+
+		unsigned int totalSwaps = 0;
+		std::fill(changed.begin(), changed.end(), 0);
+		for (unsigned int i = 0; i < matched.size(); i++)
+		{
+			const unsigned int t = matched[i];
+			if (swapCounts[t] > 0)
+			{
+				changed[t] = 1;
+				changed[partner[t]] = 1;
+				totalSwaps += swapCounts[t];
+			}
+		}
+
+		iteration++;
+		std::cout << "Refinement iteration " << iteration << ": " << totalSwaps << " swaps between " << matched.size() << " tile pairs" << std::endl;
+		if (totalSwaps == 0)
+		{
+			break;
+		}
+	}
+
+	std::cout << "Refinement finished after " << iteration << " iterations in " << std::to_string(elapsed) << " seconds." << std::endl;
+}
+
+/**
+*  Sorts the blades along a Morton or Hilbert curve through the bounds and cuts the sequence into amountTiles runs of equal size.
+*  Keys are computed and radix sorted in parallel, so this is linear in the amount of blades.
+*/
+void PartitionByCurve(const glm::vec4* bladePositions, const unsigned int amountBlades, const unsigned int amountTiles, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const bool hilbert,
+	std::vector<unsigned int>& order, std::vector<unsigned int>& tileStart)
+{
+	const glm::vec3 invExtent = SpaceFillingCurve::inverseExtent(boundsMin, boundsMax);
+	std::vector<unsigned long long> keys(amountBlades);
+	order.resize(amountBlades);
+	parallelFor(amountBlades, PARTITION_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			glm::uvec3 cell = SpaceFillingCurve::quantize(glm::vec3(bladePositions[i].xyz), boundsMin, invExtent);
+			keys[i] = hilbert ? SpaceFillingCurve::hilbert(cell) : SpaceFillingCurve::morton(cell);
+			order[i] = i;
+		}
+	});
+
+	parallelRadixSort(keys, order);
+
+	tileStart.resize(amountTiles + 1);
+	for (unsigned int i = 0; i <= amountTiles; i++)
+	{
+		tileStart[i] = (unsigned int)((unsigned long long)i * amountBlades / amountTiles);
+	}
+}
+
+/**
+*  k-d partitioning: every node is split along the longest axis of its blade bounds with nth_element, the two halves get
+*  half of the tiles each. The split position is proportional to the tiles, so with a power of two amount of tiles every split is at the median.
+*  All nodes of a tree level are split in parallel.
+*/
+void PartitionByMedianSplit(const glm::vec4* bladePositions, const unsigned int amountBlades, const unsigned int amountTiles, std::vector<unsigned int>& order, std::vector<unsigned int>& tileStart)
+{
+	struct Node
+	{
+		unsigned int begin, end;
+		unsigned int firstTile, amountTiles;
+	};
+
+	order.resize(amountBlades);
+	std::iota(order.begin(), order.end(), 0);
+	tileStart.resize(amountTiles + 1);
+	tileStart[amountTiles] = amountBlades;
+
+	std::vector<Node> level;
+	Node root = { 0, amountBlades, 0, amountTiles };
+	level.push_back(root);
+	while (!level.empty())
+	{
+		std::vector<Node> children(level.size() * 2);
+		parallelFor((unsigned int)level.size(), 1, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+		{
+			for (unsigned int n = begin; n < end; n++)
+			{
+				const Node node = level[n];
+				Node& left = children[2 * n];
+				Node& right = children[2 * n + 1];
+				left.amountTiles = 0;
+				right.amountTiles = 0;
+
+				if (node.amountTiles == 1)
+				{
+					tileStart[node.firstTile] = node.begin;
+					continue;
+				}
+
+				glm::vec3 bMin(FLT_MAX);
+				glm::vec3 bMax(-FLT_MAX);
+				for (unsigned int i = node.begin; i < node.end; i++)
+				{
+					glm::vec3 pos = bladePositions[order[i]].xyz;
+					bMin = glm::min(bMin, pos);
+					bMax = glm::max(bMax, pos);
+				}
+				glm::vec3 extent = bMax - bMin;
+				const unsigned int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+
+				const unsigned int leftTiles = node.amountTiles / 2;
+				const unsigned int mid = node.begin + (unsigned int)((unsigned long long)(node.end - node.begin) * leftTiles / node.amountTiles);
+				std::nth_element(order.begin() + node.begin, order.begin() + mid, order.begin() + node.end, [&](const unsigned int a, const unsigned int b)
+				{
+					return bladePositions[a][axis] < bladePositions[b][axis];
+				});
+
+				left.begin = node.begin;
+				left.end = mid;
+				left.firstTile = node.firstTile;
+				left.amountTiles = leftTiles;
+				right.begin = mid;
+				right.end = node.end;
+				right.firstTile = node.firstTile + leftTiles;
+				right.amountTiles = node.amountTiles - leftTiles;
+			}
+		});
+
+		level.clear();
+		for (unsigned int i = 0; i < children.size(); i++)
+		{
+			if (children[i].amountTiles > 0)
+			{
+				level.push_back(children[i]);
+			}
+		}
+	}
+}
+
+void PartitionBlades(const GrassPartitionStrategy strategy, const glm::vec4* bladePositions, const unsigned int amountBlades, const unsigned int amountTiles,
+	const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<unsigned int>& order, std::vector<unsigned int>& tileStart)
+{
+	switch (strategy)
+	{
+	case GrassPartitionStrategy::PARTITION_MORTON:
+	case GrassPartitionStrategy::PARTITION_HILBERT:
+		PartitionByCurve(bladePositions, amountBlades, amountTiles, boundsMin, boundsMax, strategy == GrassPartitionStrategy::PARTITION_HILBERT, order, tileStart);
+		break;
+	case GrassPartitionStrategy::PARTITION_MEDIAN_SPLIT:
+		PartitionByMedianSplit(bladePositions, amountBlades, amountTiles, order, tileStart);
+		break;
+	case GrassPartitionStrategy::PARTITION_CLUSTERING:
+	default:
+		PartitionByClustering(bladePositions, amountBlades, amountTiles, amountBlades / amountTiles, boundsMax - boundsMin, order, tileStart);
+		break;
+	}
+}
+
+PartitionQuality EvaluatePartition(const glm::vec4* bladePositions, const glm::vec4* bladeV1, const std::vector<unsigned int>& order, const std::vector<unsigned int>& tileStart)
+{
+	const unsigned int amountTiles = (unsigned int)tileStart.size() - 1;
+	const unsigned int amountBlades = tileStart[amountTiles];
+
+	std::vector<glm::vec3> tileMin(amountTiles);
+	std::vector<glm::vec3> tileMax(amountTiles);
+	std::vector<double> squaredErrors(amountTiles);
+	parallelFor(amountTiles, 4, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		for (unsigned int t = begin; t < end; t++)
+		{
+			glm::vec3 bMin(FLT_MAX);
+			glm::vec3 bMax(-FLT_MAX);
+			glm::dvec3 sum(0.0);
+			for (unsigned int i = tileStart[t]; i < tileStart[t + 1]; i++)
+			{
+				glm::vec3 pos = bladePositions[order[i]].xyz;
+				float height = (bladeV1 != 0) ? bladeV1[order[i]].w : 0.0f;
+				bMin = glm::min(bMin, pos - height);
+				bMax = glm::max(bMax, pos + height);
+				sum += glm::dvec3(pos);
+			}
+			const unsigned int count = tileStart[t + 1] - tileStart[t];
+			glm::vec3 mean = glm::vec3(sum / (double)glm::max(count, 1u));
+			double error = 0.0;
+			for (unsigned int i = tileStart[t]; i < tileStart[t + 1]; i++)
+			{
+				glm::vec3 d = glm::vec3(bladePositions[order[i]].xyz) - mean;
+				error += glm::dot(d, d);
+			}
+			tileMin[t] = bMin;
+			tileMax[t] = bMax;
+			squaredErrors[t] = error;
+		}
+	});
+
+	//All pairs, each chunk sums the intersections of its tiles with all later tiles
+	const unsigned int overlapChunkSize = 16;
+	std::vector<double> chunkOverlap((amountTiles + overlapChunkSize - 1) / overlapChunkSize, 0.0);
+	parallelFor(amountTiles, overlapChunkSize, [&](const unsigned int begin, const unsigned int end, const unsigned int chunk)
+	{
+		double overlap = 0.0;
+		for (unsigned int t = begin; t < end; t++)
+		{
+			for (unsigned int s = t + 1; s < amountTiles; s++)
+			{
+				glm::vec3 extent = glm::min(tileMax[t], tileMax[s]) - glm::max(tileMin[t], tileMin[s]);
+				if (extent.x > 0.0f && extent.y > 0.0f && extent.z > 0.0f)
+				{
+					overlap += (double)extent.x * (double)extent.y * (double)extent.z;
+				}
+			}
+		}
+		chunkOverlap[chunk] = overlap;
+	});
+
+	PartitionQuality quality;
+	quality.meanSquaredError = 0.0;
+	quality.boundsVolume = 0.0;
+	quality.overlapRatio = 0.0;
+	quality.bladesPerTileVariance = 0.0;
+	const double meanBladesPerTile = (double)amountBlades / (double)amountTiles;
+	for (unsigned int t = 0; t < amountTiles; t++)
+	{
+		glm::vec3 extent = tileMax[t] - tileMin[t];
+		quality.meanSquaredError += squaredErrors[t];
+		quality.boundsVolume += (double)extent.x * (double)extent.y * (double)extent.z;
+		double deviation = (double)(tileStart[t + 1] - tileStart[t]) - meanBladesPerTile;
+		quality.bladesPerTileVariance += deviation * deviation;
+	}
+	for (unsigned int c = 0; c < chunkOverlap.size(); c++)
+	{
+		quality.overlapRatio += chunkOverlap[c];
+	}
+	quality.meanSquaredError /= (double)glm::max(amountBlades, 1u);
+	quality.overlapRatio = (quality.boundsVolume > 0.0) ? quality.overlapRatio / quality.boundsVolume : 0.0;
+	quality.bladesPerTileVariance /= (double)amountTiles;
+	return quality;
+}
+
+void SortTilesByMorton(const glm::vec4* bladePositions, const std::vector<unsigned int>& tileStart, std::vector<unsigned int>& order)
+{
+	const unsigned int amountTiles = (unsigned int)tileStart.size() - 1;
+	parallelFor(amountTiles, 1, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		std::vector<std::pair<unsigned long long, unsigned int>> keys;
+		for (unsigned int t = begin; t < end; t++)
+		{
+			glm::vec3 bMin(FLT_MAX);
+			glm::vec3 bMax(-FLT_MAX);
+			for (unsigned int i = tileStart[t]; i < tileStart[t + 1]; i++)
+			{
+				glm::vec3 pos = bladePositions[order[i]].xyz;
+				bMin = glm::min(bMin, pos);
+				bMax = glm::max(bMax, pos);
+			}
+			const glm::vec3 invExtent = SpaceFillingCurve::inverseExtent(bMin, bMax);
+
+			keys.clear();
+			for (unsigned int i = tileStart[t]; i < tileStart[t + 1]; i++)
+			{
+				glm::uvec3 cell = SpaceFillingCurve::quantize(glm::vec3(bladePositions[order[i]].xyz), bMin, invExtent);
+				keys.push_back(std::pair<unsigned long long, unsigned int>(SpaceFillingCurve::morton(cell), order[i]));
+			}
+			//Ties keep the generation order, so the result never depends on the sort implementation
+			std::sort(keys.begin(), keys.end());
+			for (unsigned int i = 0; i < keys.size(); i++)
+			{
+				order[tileStart[t] + i] = keys[i].second;
+			}
+		}
+	});
+}
+
+//Frustum planes (xyz normal, w distance) of a view projection matrix, normals point inside
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::mat4 rows = glm::transpose(viewProjection);
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i].xyz));
+	}
+}
+
+unsigned int TuneBladesPerTile(const glm::vec4* bladePositions, const glm::vec4* bladeV1, const unsigned int amountBlades, const std::vector<unsigned int>& candidates,
+	const unsigned int amountCameras, const float viewDistance, const unsigned long long seed)
+{
+	if (candidates.empty() || amountBlades == 0 || amountCameras == 0)
+	{
+		return candidates.empty() ? amountBlades : candidates[0];
+	}
+
+	//Camera poses above random blades, looking along the ground and slightly down, some of them from higher up
+	std::vector<glm::vec4> frustums(amountCameras * 6);
+	RandomStream rng(seed, AUTO_TUNE_RANDOM_STREAM);
+	for (unsigned int c = 0; c < amountCameras; c++)
+	{
+		glm::vec4 u = rng.uniform4(c, 0);
+		unsigned int blade = glm::min((unsigned int)(u.x * amountBlades), amountBlades - 1);
+		glm::vec3 ground = bladePositions[blade].xyz;
+		glm::vec3 up = glm::vec3(bladeV1[blade].xyz) - ground;
+		up = (glm::dot(up, up) > 0.0f) ? glm::normalize(up) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::vec3 tangent = glm::normalize(glm::cross(up, (glm::abs(up.y) < 0.99f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+		glm::vec3 bitangent = glm::cross(up, tangent);
+
+		glm::vec3 eye = ground + up * (AUTO_TUNE_EYE_HEIGHT + u.y * u.y * 0.5f * viewDistance);
+		float yaw = u.z * 2.0f * PI_F;
+		float pitch = -u.w * 0.5f;
+		glm::vec3 direction = glm::cos(pitch) * (glm::cos(yaw) * tangent + glm::sin(yaw) * bitangent) + glm::sin(pitch) * up;
+
+		glm::mat4 viewProjection = glm::perspective(glm::radians(AUTO_TUNE_FOV), AUTO_TUNE_ASPECT, 0.1f, viewDistance) * glm::lookAt(eye, eye + direction, up);
+		extractFrustumPlanes(viewProjection, &frustums[c * 6]);
+	}
+
+	unsigned int best = candidates[0];
+	double bestCost = DBL_MAX;
+	std::vector<unsigned int> order, tileStart;
+	for (unsigned int k = 0; k < candidates.size(); k++)
+	{
+		const unsigned int amountTiles = glm::max(1u, (unsigned int)glm::ceil(amountBlades / (float)glm::max(candidates[k], 1u)));
+		PartitionByMedianSplit(bladePositions, amountBlades, amountTiles, order, tileStart);
+
+		std::vector<glm::vec3> tileMin(amountTiles);
+		std::vector<glm::vec3> tileMax(amountTiles);
+		parallelFor(amountTiles, 4, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+		{
+			for (unsigned int t = begin; t < end; t++)
+			{
+				glm::vec3 bMin(FLT_MAX);
+				glm::vec3 bMax(-FLT_MAX);
+				for (unsigned int i = tileStart[t]; i < tileStart[t + 1]; i++)
+				{
+					glm::vec3 pos = bladePositions[order[i]].xyz;
+					float height = bladeV1[order[i]].w;
+					bMin = glm::min(bMin, pos - height);
+					bMax = glm::max(bMax, pos + height);
+				}
+				tileMin[t] = bMin;
+				tileMax[t] = bMax;
+			}
+		});
+
+		std::vector<double> cameraCost(amountCameras);
+		std::vector<unsigned int> cameraTiles(amountCameras);
+		parallelFor(amountCameras, 1, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+		{
+			for (unsigned int c = begin; c < end; c++)
+			{
+				const glm::vec4* planes = &frustums[c * 6];
+				double cost = 0.0;
+				unsigned int visibleTiles = 0;
+				for (unsigned int t = 0; t < amountTiles; t++)
+				{
+					bool outside = false;
+					for (unsigned int p = 0; p < 6 && !outside; p++)
+					{
+						glm::vec3 positive = glm::mix(tileMin[t], tileMax[t], glm::step(glm::vec3(0.0f), glm::vec3(planes[p].xyz)));
+						outside = glm::dot(glm::vec3(planes[p].xyz), positive) + planes[p].w < 0.0f;
+					}
+					if (!outside)
+					{
+						cost += (double)(AUTO_TUNE_PATCH_OVERHEAD_BLADES + tileStart[t + 1] - tileStart[t]);
+						visibleTiles++;
+					}
+				}
+				cameraCost[c] = cost;
+				cameraTiles[c] = visibleTiles;
+			}
+		});
+
+		double cost = 0.0;
+		double visibleTiles = 0.0;
+		for (unsigned int c = 0; c < amountCameras; c++)
+		{
+			cost += cameraCost[c];
+			visibleTiles += cameraTiles[c];
+		}
+		cost /= (double)amountCameras;
+		visibleTiles /= (double)amountCameras;
+		std::cout << "Tile size " << candidates[k] << ": " << amountTiles << " tiles, " << std::to_string(visibleTiles) << " visible per view, cost " << std::to_string(cost) << std::endl;
+
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			best = candidates[k];
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,70 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef GRASSPARTITION_H
+#define GRASSPARTITION_H
+
+#include <string>
+#include <vector>
+#include "Common.h"
+
+//How large fields are cut into patches
+enum GrassPartitionStrategy
+{
+	PARTITION_CLUSTERING, PARTITION_MORTON, PARTITION_HILBERT, PARTITION_MEDIAN_SPLIT
+};
+
+#pragma region GrassPartitionStrategyMethods
+static std::string toString(GrassPartitionStrategy s)
+{
+	switch (s)
+	{
+	case PARTITION_CLUSTERING: return "Clustering";
+	case PARTITION_MORTON: return "Morton";
+	case PARTITION_HILBERT: return "Hilbert";
+	case PARTITION_MEDIAN_SPLIT: return "MedianSplit";
+	}
+	return "No string added for this strategy";
+}
+#pragma endregion
+
+//Quality of a partition, the bounds are the patch bounds: blade positions extended by the blade height
+struct PartitionQuality
+{
+	double meanSquaredError; //Squared distance of the blades to the mean of their tile
+	double boundsVolume; //Sum of the tile bounds volumes
+	double overlapRatio; //Summed volume of all pairwise tile bounds intersections, relative to boundsVolume
+	double bladesPerTileVariance;
+};
+
+/**
+*  Partitioning of blades into amountTiles tiles, without any GPU resources, so the benchmark runs the same code as Grass.
+*  All functions work on the blade order: tile i is order[tileStart[i], tileStart[i + 1]).
+*/
+
+//boundsMin and boundsMax enclose all blade positions
+void PartitionBlades(const GrassPartitionStrategy strategy, const glm::vec4* bladePositions, const unsigned int amountBlades, const unsigned int amountTiles,
+	const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<unsigned int>& order, std::vector<unsigned int>& tileStart);
+
+void RefinePartition(const glm::vec4* bladePositions, const unsigned int amountTiles, const std::vector<unsigned int>& tileStart, const unsigned int maxIterations, const float maxSeconds,
+	std::vector<unsigned int>& order);
+
+//bladeV1 may be 0, then the bounds only enclose the blade positions
+PartitionQuality EvaluatePartition(const glm::vec4* bladePositions, const glm::vec4* bladeV1, const std::vector<unsigned int>& order, const std::vector<unsigned int>& tileStart);
+
+//Sorts the blades of every tile along a Morton curve through the bounds of the tile, so blades that are close get close indices
+void SortTilesByMorton(const glm::vec4* bladePositions, const std::vector<unsigned int>& tileStart, std::vector<unsigned int>& order);
+
+/**
+*  Picks the candidate amount of blades per tile with the lowest estimated frame cost. The cost is summed over amountCameras camera poses,
+*  sampled above random blades of the field and looking along the ground. Every tile in the view frustum costs its blades
+*  plus AUTO_TUNE_PATCH_OVERHEAD_BLADES for its dispatches and draw call. The blades that really are in view are the same for all
+*  candidates, so this ranks the candidates by patch overhead plus the blades that are processed in vain.
+*  Candidates are partitioned by median split, which is fast and close to the other strategies in tile shape.
+*/
+unsigned int TuneBladesPerTile(const glm::vec4* bladePositions, const glm::vec4* bladeV1, const unsigned int amountBlades, const std::vector<unsigned int>& candidates,
+	const unsigned int amountCameras, const float viewDistance, const unsigned long long seed);
+
+#endif
@@ -10,6 +10,7 @@
 #include "Shader.h"
 #include "OpenGLState.h"
 #include "ImageProcess.h"
+#include "Random.h"
 
 HeightMap::HeightMap(const std::string& fileName, const std::string& fileName_normal, const float heightScale) : HeightMap()
 {
@@ -90,7 +91,7 @@ HeightMap::HeightMap() : Texture2D(GL_RG32F, GL_RG, false, false, GL_CLAMP_TO_ED
 {
 }
 
-HeightMap* HeightMap::GenerateHeightMap(const unsigned int width, const unsigned int height, const unsigned int method, const unsigned int iterations, const float heightScale, const std::string& filename, const std::string& filename_normal, const float normal_smoothness)
+HeightMap* HeightMap::GenerateHeightMap(const unsigned int width, const unsigned int height, const unsigned int method, const unsigned int iterations, const float heightScale, const std::string& filename, const std::string& filename_normal, const float normal_smoothness, const unsigned long long seed)
 {
 	//Init OpenGL State
 	OpenGLState::Instance().enable(GL_BLEND);
@@ -120,13 +121,12 @@ HeightMap* HeightMap::GenerateHeightMap(const unsigned int width, const unsigned
 	glGenBuffers(1, &vbo);
 
 	//Init VBO
-	std::vector<glm::vec2> randomNumbers;
-	randomNumbers.reserve(iterations);
+	std::vector<glm::vec2> randomNumbers(iterations);
+	RandomStream(seed, 0).fillUniform((float*)randomNumbers.data(), iterations * 2);
 
 	for (unsigned int i = 0; i < iterations; i++)
 	{
-		glm::vec2 rnd = glm::vec2(random() * 2.0f * PI_F, random() * 2.0f - 1.0f);
-		randomNumbers.push_back(rnd);
+		randomNumbers[i] = glm::vec2(randomNumbers[i].x * 2.0f * PI_F, randomNumbers[i].y * 2.0f - 1.0f);
 	}
 
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
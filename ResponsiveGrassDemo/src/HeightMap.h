@@ -18,7 +18,7 @@ public:
 	Texture2D* normalMap;
 	float heightScale;
 
-	static HeightMap* GenerateHeightMap(const unsigned int width, const unsigned int height, const unsigned int method, const unsigned int iterations, const float heightScale, const std::string& filename, const std::string& filename_normal, const float normal_smoothness = 0.5f);
+	static HeightMap* GenerateHeightMap(const unsigned int width, const unsigned int height, const unsigned int method, const unsigned int iterations, const float heightScale, const std::string& filename, const std::string& filename_normal, const float normal_smoothness = 0.5f, const unsigned long long seed = 0);
 private:
 	HeightMap();
 };
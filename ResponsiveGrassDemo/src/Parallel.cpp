@@ -0,0 +1,97 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "Parallel.h"
+#include <algorithm>
+
+std::atomic<ParallelPool*> ParallelPool::instance(0);
+std::mutex ParallelPool::instanceMutex;
+
+ParallelPool& ParallelPool::Instance()
+{
+	//The first parallelFor may come from several threads at once
+	ParallelPool* pool = instance.load();
+	if (pool == 0)
+	{
+		std::lock_guard<std::mutex> lock(instanceMutex);
+		pool = instance.load();
+		if (pool == 0)
+		{
+			pool = new ParallelPool(parallelThreadCount());
+			instance.store(pool);
+		}
+	}
+	return *pool;
+}
+
+ParallelPool::ParallelPool(const unsigned int threadCount)
+{
+	//Thread 0 is the calling thread, the workers live as long as the process
+	workers.reserve(threadCount - 1);
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		workers.push_back(std::thread(&ParallelPool::workerLoop, this));
+	}
+}
+
+unsigned int ParallelPool::claim(Run& r)
+{
+	unsigned int chunk = r.nextChunk++;
+	if (r.nextChunk == r.amountChunks)
+	{
+		runs.erase(std::find(runs.begin(), runs.end(), &r));
+	}
+	return chunk;
+}
+
+void ParallelPool::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		workAvailable.wait(lock, [&]() { return !runs.empty(); });
+		Run& r = *runs.back();
+		unsigned int chunk = claim(r);
+
+		lock.unlock();
+		(*r.func)(chunk);
+		lock.lock();
+
+		//r may be gone as soon as the mutex is released after the last chunk
+		if (++r.doneChunks == r.amountChunks)
+		{
+			chunkDone.notify_all();
+		}
+	}
+}
+
+void ParallelPool::run(const unsigned int amountChunks, const std::function<void(const unsigned int)>& func)
+{
+	if (amountChunks == 0)
+	{
+		return;
+	}
+
+	Run r;
+	r.func = &func;
+	r.amountChunks = amountChunks;
+	r.nextChunk = 0;
+	r.doneChunks = 0;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	runs.push_back(&r);
+	workAvailable.notify_all();
+
+	//Only chunks of this run, so a nested run never waits for an unrelated outer chunk
+	while (r.nextChunk < r.amountChunks)
+	{
+		unsigned int chunk = claim(r);
+		lock.unlock();
+		func(chunk);
+		lock.lock();
+		r.doneChunks++;
+	}
+	chunkDone.wait(lock, [&]() { return r.doneChunks == r.amountChunks; });
+}
@@ -0,0 +1,90 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+inline unsigned int parallelThreadCount()
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	return count == 0 ? 4 : count;
+}
+
+/**
+*  The persistent worker threads behind parallelFor, parallelThreadCount() - 1 of them plus the calling thread.
+*  Unlike the job queue of ThreadPool, where WaitAll waits for every job of the pool, a run only waits for its own chunks.
+*  A thread that waits for its chunks keeps running them itself, so run may be nested and may block inside a chunk,
+*  the amount of threads never grows with the nesting. Idle workers take chunks of the newest run first, so nested loops finish before new outer chunks start.
+*/
+class ParallelPool
+{
+public:
+	static ParallelPool& Instance();
+
+	//Calls func(chunk) for every chunk in [0, amountChunks) and returns when all are done
+	void run(const unsigned int amountChunks, const std::function<void(const unsigned int)>& func);
+
+	unsigned int amountThreads() const { return (unsigned int)workers.size() + 1; }
+private:
+	ParallelPool(const unsigned int threadCount);
+
+	static std::atomic<ParallelPool*> instance;
+	static std::mutex instanceMutex;
+
+	//Lives on the stack of run, only touched under mutex. A run is in runs while it has unclaimed chunks.
+	struct Run
+	{
+		const std::function<void(const unsigned int)>* func;
+		unsigned int amountChunks;
+		unsigned int nextChunk;
+		unsigned int doneChunks;
+	};
+
+	unsigned int claim(Run& r);
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::vector<Run*> runs;
+	std::mutex mutex;
+	std::condition_variable workAvailable, chunkDone;
+};
+
+/**
+*  Splits [0, count) into chunks of chunkSize elements and calls func(begin, end, chunkIndex) for every chunk.
+*  Chunks are pulled dynamically by the threads of the ParallelPool, the calling thread takes part in the work.
+*  The chunk layout only depends on count and chunkSize, never on the amount of threads.
+*/
+template<typename Func>
+void parallelFor(const unsigned int count, const unsigned int chunkSize, const Func& func)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	const unsigned int amountChunks = (count + chunkSize - 1) / chunkSize;
+	std::function<void(const unsigned int)> chunkFunc = [&](const unsigned int chunk)
+	{
+		unsigned int begin = chunk * chunkSize;
+		unsigned int end = (count - begin < chunkSize) ? count : begin + chunkSize;
+		func(begin, end, chunk);
+	};
+
+	if (amountChunks == 1)
+	{
+		chunkFunc(0);
+		return;
+	}
+	ParallelPool::Instance().run(amountChunks, chunkFunc);
+}
+
+#endif
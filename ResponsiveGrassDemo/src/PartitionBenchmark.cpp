@@ -0,0 +1,331 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "PartitionBenchmark.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include "Clock.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "AliasTable.h"
+#include "FaceExtractor.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#define BENCHMARK_TERRAIN_RESOLUTION 128
+#define BENCHMARK_TERRAIN_SIZE 100.0f
+#define BENCHMARK_CHUNK_SIZE 16384
+
+std::vector<unsigned int> parseList(const std::string& list)
+{
+	std::vector<unsigned int> values;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		values.push_back((unsigned int)std::stoul(item));
+	}
+	return values;
+}
+
+std::string toLower(std::string s)
+{
+	std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+	return s;
+}
+
+int PartitionBenchmark::run(const std::vector<std::string>& args)
+{
+	std::string modelFile;
+	std::string outFile = GENERATEDFILESPATH + "PartitionBenchmark.csv";
+	std::vector<unsigned int> bladeCounts;
+	std::vector<unsigned int> tileSizes;
+	std::vector<GrassPartitionStrategy> strategies;
+	unsigned int refineIterations = 0;
+	unsigned long long seed = 0;
+
+	for (unsigned int i = 0; i < args.size(); i++)
+	{
+		if (i + 1 >= args.size())
+		{
+			std::cout << "ERROR PartitionBenchmark: Missing value for " << args[i] << std::endl;
+			return 1;
+		}
+		const std::string& value = args[++i];
+		const std::string& option = args[i - 1];
+		if (option == "--model") { modelFile = value; }
+		else if (option == "--out") { outFile = value; }
+		else if (option == "--blades") { bladeCounts = parseList(value); }
+		else if (option == "--tile-sizes") { tileSizes = parseList(value); }
+		else if (option == "--refine") { refineIterations = (unsigned int)std::stoul(value); }
+		else if (option == "--seed") { seed = std::stoull(value); }
+		else if (option == "--strategies")
+		{
+			std::stringstream stream(value);
+			std::string name;
+			while (std::getline(stream, name, ','))
+			{
+				bool found = false;
+				for (unsigned int s = PARTITION_CLUSTERING; s <= PARTITION_MEDIAN_SPLIT; s++)
+				{
+					if (toLower(name) == toLower(toString((GrassPartitionStrategy)s)))
+					{
+						strategies.push_back((GrassPartitionStrategy)s);
+						found = true;
+					}
+				}
+				if (!found)
+				{
+					std::cout << "ERROR PartitionBenchmark: Unknown strategy " << name << std::endl;
+					return 1;
+				}
+			}
+		}
+		else
+		{
+			std::cout << "ERROR PartitionBenchmark: Unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+
+	if (bladeCounts.empty())
+	{
+		bladeCounts.push_back(100000);
+		bladeCounts.push_back(500000);
+		bladeCounts.push_back(1000000);
+	}
+	if (tileSizes.empty())
+	{
+		tileSizes.push_back(10240);
+	}
+	if (strategies.empty())
+	{
+		for (unsigned int s = PARTITION_CLUSTERING; s <= PARTITION_MEDIAN_SPLIT; s++)
+		{
+			strategies.push_back((GrassPartitionStrategy)s);
+		}
+	}
+
+	std::vector<Geometry::TriangleFace> faces;
+	if (modelFile.empty())
+	{
+		synthesizeTerrain(faces);
+	}
+	else
+	{
+		AssimpImporter::ImportModel* model = AssimpImporter::importModel(modelFile);
+		if (model == 0)
+		{
+			std::cout << "ERROR PartitionBenchmark: Could not load model!" << std::endl;
+			return 1;
+		}
+		glm::vec3 facesMin, facesMax;
+		FaceExtractor::extract(model, FaceExtractor::Params(), faces, facesMin, facesMax);
+	}
+	if (faces.empty())
+	{
+		std::cout << "ERROR PartitionBenchmark: No faces to grow blades on!" << std::endl;
+		return 1;
+	}
+	std::cout << "Partition benchmark on " << faces.size() << " faces" << std::endl;
+
+	std::vector<Result> results;
+	std::vector<glm::vec4> positions, v1;
+	std::vector<unsigned int> order, tileStart;
+	for (unsigned int b = 0; b < bladeCounts.size(); b++)
+	{
+		const unsigned int amountBlades = bladeCounts[b];
+		spreadBlades(faces, amountBlades, seed, positions, v1);
+
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+		for (unsigned int i = 0; i < amountBlades; i++)
+		{
+			boundsMin = glm::min(boundsMin, glm::vec3(positions[i].xyz) - v1[i].w);
+			boundsMax = glm::max(boundsMax, glm::vec3(positions[i].xyz) + v1[i].w);
+		}
+
+		for (unsigned int t = 0; t < tileSizes.size(); t++)
+		{
+			const unsigned int amountTiles = glm::max(1u, (unsigned int)glm::ceil(amountBlades / (float)glm::max(tileSizes[t], 1u)));
+			for (unsigned int s = 0; s < strategies.size(); s++)
+			{
+				Result r;
+				r.strategy = strategies[s];
+				r.amountBlades = amountBlades;
+				r.bladesPerTile = tileSizes[t];
+				r.amountTiles = amountTiles;
+				r.refineSeconds = 0.0;
+
+				Clock clock;
+				clock.Tick();
+				PartitionBlades(r.strategy, positions.data(), amountBlades, amountTiles, boundsMin, boundsMax, order, tileStart);
+				clock.Tick();
+				r.partitionSeconds = clock.LastFrameTime();
+
+				if (refineIterations > 0)
+				{
+					RefinePartition(positions.data(), amountTiles, tileStart, refineIterations, FLT_MAX, order);
+					clock.Tick();
+					r.refineSeconds = clock.LastFrameTime();
+				}
+
+				r.peakMemoryMB = peakMemoryMB();
+				r.quality = EvaluatePartition(positions.data(), v1.data(), order, tileStart);
+				results.push_back(r);
+
+				std::cout << toString(r.strategy) << ": " << amountBlades << " blades, " << amountTiles << " tiles, " << std::to_string(r.partitionSeconds) << " s, MSE = " << std::to_string(r.quality.meanSquaredError) << std::endl;
+			}
+		}
+	}
+
+	return write(outFile, results) ? 0 : 1;
+}
+
+void PartitionBenchmark::synthesizeTerrain(std::vector<Geometry::TriangleFace>& faces)
+{
+	const unsigned int n = BENCHMARK_TERRAIN_RESOLUTION;
+	const float cellSize = BENCHMARK_TERRAIN_SIZE / n;
+
+	//Rolling hills, so the partitioners also have to deal with height
+	std::vector<Geometry::Vertex> vertices((n + 1) * (n + 1));
+	for (unsigned int z = 0; z <= n; z++)
+	{
+		for (unsigned int x = 0; x <= n; x++)
+		{
+			float px = x * cellSize;
+			float pz = z * cellSize;
+			Geometry::Vertex& v = vertices[z * (n + 1) + x];
+			v.position = glm::vec3(px, 4.0f * glm::sin(px * 0.07f) * glm::cos(pz * 0.05f), pz);
+			v.normal = glm::normalize(glm::vec3(-0.28f * glm::cos(px * 0.07f) * glm::cos(pz * 0.05f), 1.0f, 0.2f * glm::sin(px * 0.07f) * glm::sin(pz * 0.05f)));
+			v.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+			v.bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
+			v.uv = glm::vec2(x, z) / (float)n;
+		}
+	}
+
+	faces.clear();
+	faces.reserve(2 * n * n);
+	for (unsigned int z = 0; z < n; z++)
+	{
+		for (unsigned int x = 0; x < n; x++)
+		{
+			unsigned int i = z * (n + 1) + x;
+			faces.push_back(Geometry::TriangleFace(vertices[i], vertices[i + n + 1], vertices[i + 1]));
+			faces.push_back(Geometry::TriangleFace(vertices[i + 1], vertices[i + n + 1], vertices[i + n + 2]));
+		}
+	}
+}
+
+void PartitionBenchmark::spreadBlades(const std::vector<Geometry::TriangleFace>& faces, const unsigned int amountBlades, const unsigned long long seed, std::vector<glm::vec4>& positions, std::vector<glm::vec4>& v1)
+{
+	std::vector<float> areas(faces.size());
+	for (unsigned int f = 0; f < faces.size(); f++)
+	{
+		areas[f] = faces[f].area;
+	}
+	AliasTable table(areas);
+	RandomStream rng(seed, 0);
+
+	positions.resize(amountBlades);
+	v1.resize(amountBlades);
+	parallelFor(amountBlades, BENCHMARK_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			glm::uvec4 bits = rng.bits(i, 0);
+			glm::vec4 u = rng.uniform4(i, 1);
+			const Geometry::TriangleFace& face = faces[table.sample(bits.x, u.x)];
+			glm::vec3 barycentric = Geometry::uniformBarycentric(u.y, u.z);
+			glm::vec3 pos = face.vertices[0].position * barycentric.x + face.vertices[1].position * barycentric.y + face.vertices[2].position * barycentric.z;
+			float height = 0.5f + u.w;
+			positions[i] = glm::vec4(pos, 0.0f);
+			v1[i] = glm::vec4(pos + face.faceNormal * height, height);
+		}
+	});
+}
+
+double PartitionBenchmark::peakMemoryMB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0.0;
+	}
+	return (double)counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0.0;
+	}
+	return (double)usage.ru_maxrss / 1024.0;
+#endif
+}
+
+bool PartitionBenchmark::write(const std::string& file, const std::vector<Result>& results)
+{
+	std::ofstream out(file.c_str(), std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cout << "Could not open file to write benchmark results. Filename = " << file << std::endl;
+		return false;
+	}
+	const bool json = file.size() >= 5 && toLower(file.substr(file.size() - 5)) == ".json";
+
+	if (json)
+	{
+		out << "[" << std::endl;
+	}
+	else
+	{
+		out << "strategy,blades,bladesPerTile,tiles,partitionSeconds,refineSeconds,peakMemoryMB,mse,boundsVolume,overlapRatio,bladesPerTileVariance" << std::endl;
+	}
+
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		if (json)
+		{
+			out << "  { \"strategy\": \"" << toString(r.strategy) << "\", \"blades\": " << r.amountBlades << ", \"bladesPerTile\": " << r.bladesPerTile << ", \"tiles\": " << r.amountTiles
+				<< ", \"partitionSeconds\": " << std::to_string(r.partitionSeconds) << ", \"refineSeconds\": " << std::to_string(r.refineSeconds) << ", \"peakMemoryMB\": " << std::to_string(r.peakMemoryMB)
+				<< ", \"mse\": " << std::to_string(r.quality.meanSquaredError) << ", \"boundsVolume\": " << std::to_string(r.quality.boundsVolume) << ", \"overlapRatio\": " << std::to_string(r.quality.overlapRatio)
+				<< ", \"bladesPerTileVariance\": " << std::to_string(r.quality.bladesPerTileVariance) << " }" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+		}
+		else
+		{
+			out << toString(r.strategy) << "," << r.amountBlades << "," << r.bladesPerTile << "," << r.amountTiles << "," << std::to_string(r.partitionSeconds) << "," << std::to_string(r.refineSeconds)
+				<< "," << std::to_string(r.peakMemoryMB) << "," << std::to_string(r.quality.meanSquaredError) << "," << std::to_string(r.quality.boundsVolume) << "," << std::to_string(r.quality.overlapRatio)
+				<< "," << std::to_string(r.quality.bladesPerTileVariance) << std::endl;
+		}
+	}
+
+	if (json)
+	{
+		out << "]" << std::endl;
+	}
+
+	bool success = out.good();
+	out.close();
+	if (!success)
+	{
+		std::cout << "Could not write benchmark results. Filename = " << file << std::endl;
+		return false;
+	}
+	std::cout << "Saved " << results.size() << " benchmark results to " << file << std::endl;
+	return true;
+}
@@ -0,0 +1,53 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef PARTITIONBENCHMARK_H
+#define PARTITIONBENCHMARK_H
+
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "Geometry.h"
+#include "GrassPartition.h"
+
+/**
+*  Headless comparison of the partition strategies, no window or GL context is created.
+*  Started with: ResponsiveGrassDemo --partition-benchmark [options]
+*    --model <file>              faces to grow the blades on, default is a synthesized hilly terrain
+*    --blades <n,n,...>          amounts of blades, default 100000,500000,1000000
+*    --tile-sizes <n,n,...>      blades per patch, default 10240
+*    --strategies <name,...>     Clustering, Morton, Hilbert and/or MedianSplit, default all
+*    --refine <iterations>       constrained k-means refinement after every partitioning, default 0
+*    --seed <n>                  seed of the blade positions
+*    --out <file.csv|file.json>  default is PartitionBenchmark.csv in the generated files
+*  Blades are spread area weighted over the faces with heights between 0.5 and 1.5, like uniform grass.
+*  Peak memory is the peak of the whole process so far, for isolated numbers run one strategy and one amount of blades per call.
+*/
+class PartitionBenchmark
+{
+public:
+	struct Result
+	{
+		GrassPartitionStrategy strategy;
+		unsigned int amountBlades;
+		unsigned int bladesPerTile;
+		unsigned int amountTiles;
+		double partitionSeconds;
+		double refineSeconds;
+		double peakMemoryMB;
+		PartitionQuality quality;
+	};
+
+	//args are the arguments after --partition-benchmark, returns the exit code
+	static int run(const std::vector<std::string>& args);
+
+private:
+	static void synthesizeTerrain(std::vector<Geometry::TriangleFace>& faces);
+	static void spreadBlades(const std::vector<Geometry::TriangleFace>& faces, const unsigned int amountBlades, const unsigned long long seed, std::vector<glm::vec4>& positions, std::vector<glm::vec4>& v1);
+	static double peakMemoryMB();
+	static bool write(const std::string& file, const std::vector<Result>& results);
+};
+
+#endif
@@ -0,0 +1,328 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "PatchHierarchy.h"
+
+#include <algorithm>
+#include "Grass.h"
+
+//Frustum plane in grass space, distances are still measured in world space
+struct LocalPlane
+{
+	glm::vec3 normal;
+	float d;
+};
+
+/**
+*  Largest distance of the box behind a plane, positive when the box is completely outside of at least one plane.
+*  inside is set when the box lies completely in front of all planes.
+*/
+inline float outsideDistance(const LocalPlane planes[6], const glm::vec3& min, const glm::vec3& max, bool& inside)
+{
+	glm::vec3 center = (min + max) * 0.5f;
+	glm::vec3 halfSize = (max - min) * 0.5f;
+	float outside = -FLT_MAX;
+	inside = true;
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		float d = glm::dot(planes[i].normal, center) + planes[i].d;
+		float r = glm::dot(glm::abs(planes[i].normal), halfSize);
+		outside = glm::max(outside, -(d + r));
+		if (d - r < 0.0f)
+		{
+			inside = false;
+		}
+	}
+	return outside;
+}
+
+//Axis aligned box around the transformed box
+inline void transformBox(const glm::mat4& m, const glm::vec3& min, const glm::vec3& max, glm::vec3& outMin, glm::vec3& outMax)
+{
+	outMin = glm::vec3(FLT_MAX);
+	outMax = glm::vec3(-FLT_MAX);
+	for (unsigned int c = 0; c < 8; c++)
+	{
+		glm::vec4 corner((c & 1) ? max.x : min.x, (c & 2) ? max.y : min.y, (c & 4) ? max.z : min.z, 1.0f);
+		glm::vec3 transformed = glm::vec3(m * corner);
+		outMin = glm::min(outMin, transformed);
+		outMax = glm::max(outMax, transformed);
+	}
+}
+
+inline float boxDistance(const glm::vec3& p, const glm::vec3& min, const glm::vec3& max)
+{
+	return glm::length(glm::max(glm::max(min - p, p - max), glm::vec3(0.0f)));
+}
+
+//Patches that can share their state within a merged batch
+inline bool sameState(const GrassPatchInfo& a, const GrassPatchInfo& b)
+{
+	return a.modelMatrix == b.modelMatrix && a.tessellationProps == b.tessellationProps && a.patch->bladeShape == b.patch->bladeShape;
+}
+
+PatchHierarchy::PatchHierarchy() : nodes(), patchOrder(), patchMin(), patchMax(), segmentStart(), segmentMin(), segmentMax(), unboundedPatches()
+{
+}
+
+PatchHierarchy::~PatchHierarchy()
+{
+}
+
+void PatchHierarchy::build(const std::vector<GrassPatchInfo>& patches)
+{
+	nodes.clear();
+	patchOrder.clear();
+	segmentStart.clear();
+	segmentMin.clear();
+	segmentMax.clear();
+	unboundedPatches.clear();
+
+	std::vector<glm::vec3> boxMin(patches.size());
+	std::vector<glm::vec3> boxMax(patches.size());
+	std::vector<glm::vec3> centers(patches.size());
+	for (unsigned int i = 0; i < patches.size(); i++)
+	{
+		const GrassPatchInfo& p = patches[i];
+		if (p.bounds == 0)
+		{
+			unboundedPatches.push_back(i);
+			continue;
+		}
+
+		transformBox(p.modelMatrix, glm::vec3(p.bounds->xMin, p.bounds->yMin, p.bounds->zMin), glm::vec3(p.bounds->xMax, p.bounds->yMax, p.bounds->zMax), boxMin[i], boxMax[i]);
+		centers[i] = (boxMin[i] + boxMax[i]) * 0.5f;
+		patchOrder.push_back(i);
+	}
+
+	patchMin.resize(patchOrder.size());
+	patchMax.resize(patchOrder.size());
+	if (patchOrder.empty())
+	{
+		return;
+	}
+
+	nodes.reserve(2 * patchOrder.size() / PATCH_HIERARCHY_LEAF_SIZE + 1);
+	buildNode(0, (unsigned int)patchOrder.size(), centers);
+
+	segmentStart.resize(patchOrder.size() + 1);
+	for (unsigned int i = 0; i < patchOrder.size(); i++)
+	{
+		const GrassPatchInfo& p = patches[patchOrder[i]];
+		patchMin[i] = boxMin[patchOrder[i]];
+		patchMax[i] = boxMax[patchOrder[i]];
+
+		segmentStart[i] = (unsigned int)segmentMin.size();
+		for (unsigned int s = 0; s < p.patch->segments.size(); s++)
+		{
+			glm::vec3 sMin, sMax;
+			transformBox(p.modelMatrix, p.patch->segments[s].min, p.patch->segments[s].max, sMin, sMax);
+			segmentMin.push_back(sMin);
+			segmentMax.push_back(sMax);
+		}
+	}
+	segmentStart[patchOrder.size()] = (unsigned int)segmentMin.size();
+
+	for (int n = (int)nodes.size() - 1; n >= 0; n--)
+	{
+		Node& node = nodes[n];
+		if (node.right == 0)
+		{
+			node.min = glm::vec3(FLT_MAX);
+			node.max = glm::vec3(-FLT_MAX);
+			node.mergeable = true;
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				node.min = glm::min(node.min, patchMin[i]);
+				node.max = glm::max(node.max, patchMax[i]);
+				node.mergeable = node.mergeable && sameState(patches[patchOrder[node.first]], patches[patchOrder[i]]);
+			}
+		}
+		else
+		{
+			//Children always have larger indices than their parent
+			node.min = glm::min(nodes[n + 1].min, nodes[node.right].min);
+			node.max = glm::max(nodes[n + 1].max, nodes[node.right].max);
+			node.mergeable = nodes[n + 1].mergeable && nodes[node.right].mergeable && sameState(patches[patchOrder[node.first]], patches[patchOrder[nodes[node.right].first]]);
+		}
+	}
+}
+
+unsigned int PatchHierarchy::buildNode(const unsigned int first, const unsigned int count, std::vector<glm::vec3>& centers)
+{
+	unsigned int index = (unsigned int)nodes.size();
+	Node node;
+	node.first = first;
+	node.count = count;
+	node.right = 0;
+	nodes.push_back(node);
+
+	if (count <= PATCH_HIERARCHY_LEAF_SIZE)
+	{
+		return index;
+	}
+
+	glm::vec3 cMin(FLT_MAX);
+	glm::vec3 cMax(-FLT_MAX);
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		cMin = glm::min(cMin, centers[patchOrder[i]]);
+		cMax = glm::max(cMax, centers[patchOrder[i]]);
+	}
+	glm::vec3 extent = cMax - cMin;
+	const unsigned int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+
+	const unsigned int half = count / 2;
+	std::nth_element(patchOrder.begin() + first, patchOrder.begin() + first + half, patchOrder.begin() + first + count, [&](const unsigned int a, const unsigned int b)
+	{
+		return centers[a][axis] < centers[b][axis];
+	});
+
+	buildNode(first, half, centers);
+	unsigned int right = buildNode(first + half, count - half, centers);
+	nodes[index].right = right;
+	return index;
+}
+
+void PatchHierarchy::setRange(const Node& node, const bool visible, const bool forceVisible, std::vector<GrassPatchInfo>& patches) const
+{
+	for (unsigned int i = node.first; i < node.first + node.count; i++)
+	{
+		GrassPatchInfo& p = patches[patchOrder[i]];
+		p.visible = visible;
+		p.forceVisible = forceVisible;
+	}
+}
+
+void PatchHierarchy::addBatch(const unsigned int first, const unsigned int count, const bool merged, const glm::vec3& min, const glm::vec3& max, PatchFrame& frame) const
+{
+	PatchBatch batch;
+	batch.first = (unsigned int)frame.patches.size();
+	batch.count = count;
+	batch.merged = merged;
+	batch.split = false;
+	batch.firstForceRange = 0;
+	batch.amountForceRanges = 0;
+	batch.firstVisibleRange = 0;
+	batch.amountVisibleRanges = 0;
+	batch.min = min;
+	batch.max = max;
+	frame.patches.insert(frame.patches.end(), patchOrder.begin() + first, patchOrder.begin() + first + count);
+	frame.batches.push_back(batch);
+}
+
+//Appends the blade range, or extends the last range if it ends where the new one begins
+inline void appendRange(std::vector<glm::uvec2>& ranges, const unsigned int firstRange, const unsigned int first, const unsigned int count)
+{
+	if (ranges.size() > firstRange && ranges.back().x + ranges.back().y == first)
+	{
+		ranges.back().y += count;
+	}
+	else
+	{
+		ranges.push_back(glm::uvec2(first, count));
+	}
+}
+
+void PatchHierarchy::cull(const Camera& camera, const glm::mat4& transform, const float heightInflation, std::vector<GrassPatchInfo>& patches, PatchFrame& frame) const
+{
+	frame.clear();
+	for (unsigned int i = 0; i < unboundedPatches.size(); i++)
+	{
+		GrassPatchInfo& p = patches[unboundedPatches[i]];
+		p.visible = true;
+		p.forceVisible = true;
+
+		PatchBatch batch = { (unsigned int)frame.patches.size(), 1, false, false, 0, 0, 0, 0, glm::vec3(-FLT_MAX), glm::vec3(FLT_MAX) };
+		frame.patches.push_back(unboundedPatches[i]);
+		frame.batches.push_back(batch);
+	}
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	//Move the planes into grass space once, instead of transforming every box
+	LocalPlane planes[6];
+	glm::mat3 rotation = glm::mat3(transform);
+	glm::vec3 translation = glm::vec3(transform[3]);
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		const Plane& side = camera.frustumPlanes[i];
+		planes[i].normal = glm::transpose(rotation) * side.getNormal();
+		planes[i].d = side.getDistance(translation);
+	}
+	const glm::vec3 inflation(0.0f, heightInflation * 0.5f, 0.0f);
+	//The merge distance is measured in grass space
+	const glm::vec3 cameraPosition = glm::vec3(glm::inverse(transform) * glm::vec4(camera.position, 1.0f));
+
+	unsigned int stack[PATCH_HIERARCHY_MAX_DEPTH];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+
+		bool inside;
+		float outside = outsideDistance(planes, node.min - inflation, node.max + inflation, inside);
+		if (outside >= PATCH_FORCE_UPDATE_DISTANCE)
+		{
+			setRange(node, false, false, patches);
+		}
+		else if (inside && node.mergeable && node.count > 1 && boxDistance(cameraPosition, node.min - inflation, node.max + inflation) >= PATCH_MERGE_DISTANCE)
+		{
+			setRange(node, true, true, patches);
+			addBatch(node.first, node.count, true, node.min, node.max, frame);
+		}
+		else if (node.right == 0)
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				GrassPatchInfo& p = patches[patchOrder[i]];
+				bool patchInside;
+				float patchOutside = outsideDistance(planes, patchMin[i] - inflation, patchMax[i] + inflation, patchInside);
+				p.visible = patchOutside <= 0.0f;
+				p.forceVisible = patchOutside < PATCH_FORCE_UPDATE_DISTANCE;
+				if (!p.forceVisible)
+				{
+					continue;
+				}
+
+				addBatch(i, 1, false, patchMin[i], patchMax[i], frame);
+				if (!p.visible || patchInside || segmentStart[i] == segmentStart[i + 1] || boxDistance(cameraPosition, patchMin[i] - inflation, patchMax[i] + inflation) >= PATCH_MERGE_DISTANCE)
+				{
+					continue;
+				}
+
+				//Only partly visible and near, dispatch the surviving segments
+				PatchBatch& batch = frame.batches.back();
+				batch.split = true;
+				batch.firstForceRange = (unsigned int)frame.forceRanges.size();
+				batch.firstVisibleRange = (unsigned int)frame.visibleRanges.size();
+				const std::vector<GrassPatch::Segment>& segments = p.patch->segments;
+				for (unsigned int s = 0; s < segments.size(); s++)
+				{
+					bool segmentInside;
+					float segmentOutside = outsideDistance(planes, segmentMin[segmentStart[i] + s] - inflation, segmentMax[segmentStart[i] + s] + inflation, segmentInside);
+					if (segmentOutside < PATCH_FORCE_UPDATE_DISTANCE)
+					{
+						appendRange(frame.forceRanges, batch.firstForceRange, segments[s].first, segments[s].count);
+					}
+					if (segmentOutside <= 0.0f)
+					{
+						appendRange(frame.visibleRanges, batch.firstVisibleRange, segments[s].first, segments[s].count);
+					}
+				}
+				batch.amountForceRanges = (unsigned int)frame.forceRanges.size() - batch.firstForceRange;
+				batch.amountVisibleRanges = (unsigned int)frame.visibleRanges.size() - batch.firstVisibleRange;
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.right;
+			stack[stackSize++] = (unsigned int)(&node - &nodes[0]) + 1;
+		}
+	}
+}
@@ -0,0 +1,97 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef PATCHHIERARCHY_H
+#define PATCHHIERARCHY_H
+
+#include <vector>
+#include "Common.h"
+#include "Camera.h"
+
+#define PATCH_HIERARCHY_LEAF_SIZE 4
+#define PATCH_HIERARCHY_MAX_DEPTH 64
+
+//Patches that are less than this distance outside of the frustum still get their forces updated
+#define PATCH_FORCE_UPDATE_DISTANCE 2.0f
+
+//Subtrees at least this far away from the camera are merged into one batch, closer patches that are only partly visible are split
+#define PATCH_MERGE_DISTANCE 50.0f
+
+struct GrassPatchInfo;
+
+/**
+*  Patches that are processed together in one frame. A merged batch is a subtree that is far away and completely inside of the frustum,
+*  its patches share model matrix, tessellation and blade shape, so this state is only set once for the whole batch.
+*  A split batch is a single near patch that is only partly visible, only the blade ranges of its segments that survive culling are dispatched.
+*/
+struct PatchBatch
+{
+	unsigned int first, count; //Range in PatchFrame::patches
+	bool merged;
+	bool split;
+	unsigned int firstForceRange, amountForceRanges; //Split batches only, range in PatchFrame::forceRanges
+	unsigned int firstVisibleRange, amountVisibleRanges; //Split batches only, range in PatchFrame::visibleRanges
+	glm::vec3 min, max; //Bounds in grass space, without the height inflation
+};
+
+struct PatchFrame
+{
+	std::vector<unsigned int> patches; //Patch indices of all batches
+	std::vector<PatchBatch> batches;
+	std::vector<glm::uvec2> forceRanges, visibleRanges; //First blade and amount of blades
+
+	void clear()
+	{
+		patches.clear();
+		batches.clear();
+		forceRanges.clear();
+		visibleRanges.clear();
+	}
+};
+
+/**
+*  Bounding volume hierarchy over the patch bounds of one field, split at the median patch center along the longest axis.
+*  Every node covers a contiguous range of patches, so a subtree that is completely inside of the frustum or far enough outside
+*  gets the flags of all its patches at once. Only leaves test single patches.
+*  The outside distance of a box is its largest distance behind a frustum plane, this never shrinks from a node to its children.
+*  The same traversal rebalances the patches into batches every frame, without touching the patch buffers.
+*/
+class PatchHierarchy
+{
+public:
+	PatchHierarchy();
+	~PatchHierarchy();
+
+	//Boxes are taken in grass space, including the model matrix of every patch
+	void build(const std::vector<GrassPatchInfo>& patches);
+
+	/**
+	*  Sets visible and forceVisible of all patches, heightInflation is added to the y extent of every box.
+	*  frame receives the batches of all patches with at least one of the flags set.
+	*/
+	void cull(const Camera& camera, const glm::mat4& transform, const float heightInflation, std::vector<GrassPatchInfo>& patches, PatchFrame& frame) const;
+
+private:
+	struct Node
+	{
+		glm::vec3 min, max;
+		unsigned int first, count; //Range in patchOrder
+		unsigned int right; //Index of the right child, the left child directly follows its parent. 0 for leaves.
+		bool mergeable; //All patches share model matrix, tessellation and blade shape
+	};
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> patchOrder;
+	std::vector<glm::vec3> patchMin, patchMax; //In patchOrder
+	std::vector<unsigned int> segmentStart; //In patchOrder, range in segmentMin and segmentMax
+	std::vector<glm::vec3> segmentMin, segmentMax; //Segment boxes of all patches in grass space
+	std::vector<unsigned int> unboundedPatches;
+
+	unsigned int buildNode(const unsigned int first, const unsigned int count, std::vector<glm::vec3>& centers);
+	void setRange(const Node& node, const bool visible, const bool forceVisible, std::vector<GrassPatchInfo>& patches) const;
+	void addBatch(const unsigned int first, const unsigned int count, const bool merged, const glm::vec3& min, const glm::vec3& max, PatchFrame& frame) const;
+};
+
+#endif
@@ -0,0 +1,233 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "PatchScheduler.h"
+#include "Parallel.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cmath>
+
+PatchScheduler* PatchScheduler::instance = 0;
+
+PatchScheduler& PatchScheduler::Instance()
+{
+	if (instance == 0)
+	{
+		instance = new PatchScheduler(parallelThreadCount());
+	}
+	return *instance;
+}
+
+PatchScheduler::PatchScheduler(const unsigned int threadCount) : threadCount(threadCount), deques(new WorkDeque[threadCount]), steals(0)
+{
+	//Thread 0 is the calling thread
+	workers.reserve(threadCount - 1);
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		workers.push_back(std::thread(&PatchScheduler::workerLoop, this, t));
+	}
+}
+
+PatchScheduler::~PatchScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(runMutex);
+		quit = true;
+	}
+	runStart.notify_all();
+	for (unsigned int t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+}
+
+bool PatchScheduler::popFront(WorkDeque& deque, unsigned int& task)
+{
+	unsigned long long range = deque.range.load();
+	for (;;)
+	{
+		unsigned int front = (unsigned int)(range >> 32);
+		unsigned int back = (unsigned int)range;
+		if (front >= back)
+		{
+			return false;
+		}
+		if (deque.range.compare_exchange_weak(range, ((unsigned long long)(front + 1) << 32) | back))
+		{
+			task = order[front];
+			return true;
+		}
+	}
+}
+
+bool PatchScheduler::popBack(WorkDeque& deque, unsigned int& task)
+{
+	unsigned long long range = deque.range.load();
+	for (;;)
+	{
+		unsigned int front = (unsigned int)(range >> 32);
+		unsigned int back = (unsigned int)range;
+		if (front >= back)
+		{
+			return false;
+		}
+		if (deque.range.compare_exchange_weak(range, ((unsigned long long)front << 32) | (back - 1)))
+		{
+			task = order[back - 1];
+			return true;
+		}
+	}
+}
+
+void PatchScheduler::work(const unsigned int thread)
+{
+	Clock clock;
+	for (;;)
+	{
+		unsigned int task;
+		bool found = popFront(deques[thread], task);
+		for (unsigned int i = 1; i < threadCount && !found; i++)
+		{
+			found = popBack(deques[(thread + i) % threadCount], task);
+			if (found)
+			{
+				steals++;
+			}
+		}
+		//No task is added during a run, so all deques are empty
+		if (!found)
+		{
+			return;
+		}
+
+		clock.Tick();
+		(*taskFunc)(tasks[task]);
+		clock.Tick();
+		taskStats[task].seconds = clock.LastFrameTime();
+	}
+}
+
+void PatchScheduler::workerLoop(const unsigned int thread)
+{
+	unsigned long long lastGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(runMutex);
+			runStart.wait(lock, [&]() { return quit || generation != lastGeneration; });
+			if (quit)
+			{
+				return;
+			}
+			lastGeneration = generation;
+		}
+
+		work(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(runMutex);
+			workersDone++;
+		}
+		runDone.notify_one();
+	}
+}
+
+void PatchScheduler::run(const std::vector<PatchJob>& jobs, const std::function<void(const PatchTask&)>& func, std::vector<PatchTaskStats>& jobStats)
+{
+	jobStats.assign(jobs.size(), PatchTaskStats());
+
+	//Cut the jobs into tasks, the task lengths are multiples of PATCH_TASK_ALIGNMENT so only the last task of a job has a scalar tail
+	tasks.clear();
+	for (unsigned int j = 0; j < jobs.size(); j++)
+	{
+		const PatchJob& job = jobs[j];
+		if (job.count == 0)
+		{
+			continue;
+		}
+		float bladeCost = 1.0f + job.amountColliders * PATCH_TASK_COLLIDER_COST;
+		unsigned int amountTasks = (unsigned int)ceilf(job.count * bladeCost / PATCH_TASK_COST);
+		unsigned int taskBlades = (job.count + amountTasks - 1) / amountTasks;
+		taskBlades = (taskBlades + PATCH_TASK_ALIGNMENT - 1) / PATCH_TASK_ALIGNMENT * PATCH_TASK_ALIGNMENT;
+		for (unsigned int begin = 0; begin < job.count; begin += taskBlades)
+		{
+			PatchTask task;
+			task.job = j;
+			task.first = job.first + begin;
+			task.count = std::min(taskBlades, job.count - begin);
+			task.cost = task.count * bladeCost;
+			tasks.push_back(task);
+		}
+	}
+	if (tasks.empty())
+	{
+		return;
+	}
+
+	//Largest task first to the least loaded thread, ties go to the lower index
+	std::vector<unsigned int> byCost(tasks.size());
+	for (unsigned int t = 0; t < tasks.size(); t++)
+	{
+		byCost[t] = t;
+	}
+	std::stable_sort(byCost.begin(), byCost.end(), [&](const unsigned int a, const unsigned int b) { return tasks[a].cost > tasks[b].cost; });
+
+	std::vector<float> load(threadCount, 0.0f);
+	std::vector<unsigned int> owner(tasks.size());
+	std::vector<unsigned int> dequeStart(threadCount + 1, 0);
+	for (unsigned int i = 0; i < byCost.size(); i++)
+	{
+		unsigned int thread = (unsigned int)(std::min_element(load.begin(), load.end()) - load.begin());
+		load[thread] += tasks[byCost[i]].cost;
+		owner[byCost[i]] = thread;
+		dequeStart[thread + 1]++;
+	}
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		dequeStart[t + 1] += dequeStart[t];
+	}
+
+	//Every deque keeps the descending cost order, the owner starts with its largest task and thieves take the smallest
+	order.resize(tasks.size());
+	std::vector<unsigned int> fill(dequeStart.begin(), dequeStart.end() - 1);
+	for (unsigned int i = 0; i < byCost.size(); i++)
+	{
+		order[fill[owner[byCost[i]]]++] = byCost[i];
+	}
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		deques[t].range.store(((unsigned long long)dequeStart[t] << 32) | dequeStart[t + 1]);
+	}
+
+	taskStats.assign(tasks.size(), PatchTaskStats());
+	taskFunc = &func;
+	steals = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(runMutex);
+		workersDone = 0;
+		generation++;
+	}
+	runStart.notify_all();
+
+	work(0);
+
+	{
+		std::unique_lock<std::mutex> lock(runMutex);
+		runDone.wait(lock, [&]() { return workersDone == workers.size(); });
+	}
+	taskFunc = 0;
+
+	//Deterministic reduction: tasks are in job order and in blade order within a job
+	for (unsigned int t = 0; t < tasks.size(); t++)
+	{
+		const PatchTask& task = tasks[t];
+		PatchTaskStats& stats = taskStats[t];
+		stats.amountTasks = 1;
+		stats.amountBlades = task.count;
+		stats.amountColliderTests = (unsigned long long)task.count * jobs[task.job].amountColliders;
+		jobStats[task.job] += stats;
+	}
+}
@@ -0,0 +1,110 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef PATCHSCHEDULER_H
+#define PATCHSCHEDULER_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+#define PATCH_TASK_COST 16384.0f //Target cost of one task, in blade updates without colliders
+#define PATCH_TASK_COLLIDER_COST 0.05f //Cost of testing one blade against one collider, relative to the rest of its update
+#define PATCH_TASK_ALIGNMENT 8 //Task lengths are multiples of the widest SIMD width of UpdateForces
+
+//Blades [first, first + count) of one patch, tested against amountColliders colliders
+struct PatchJob
+{
+	unsigned int first;
+	unsigned int count;
+	unsigned int amountColliders;
+};
+
+//The blades [first, first + count) of job
+struct PatchTask
+{
+	unsigned int job;
+	unsigned int first;
+	unsigned int count;
+	float cost;
+};
+
+struct PatchTaskStats
+{
+	unsigned int amountTasks = 0;
+	unsigned int amountBlades = 0;
+	unsigned long long amountColliderTests = 0;
+	double seconds = 0.0; //Measured, the only member that changes between runs
+
+	PatchTaskStats& operator+=(const PatchTaskStats& s)
+	{
+		amountTasks += s.amountTasks;
+		amountBlades += s.amountBlades;
+		amountColliderTests += s.amountColliderTests;
+		seconds += s.seconds;
+		return *this;
+	}
+};
+
+/**
+*  Runs the per frame simulation of patches on persistent worker threads.
+*  Every job is cut into tasks of about PATCH_TASK_COST, weighted by blades and colliders, so the tasks only depend on the jobs.
+*  The tasks are dealt to one deque per thread, largest first to the least loaded thread. A thread pops from the front of its own deque
+*  and steals from the back of the others when it runs dry, so a thread that is slowed down hands its small tasks to the others.
+*  The stats of a job are summed in task order after all tasks finished, so they do not depend on which thread ran which task.
+*  Only for the thread that owns the GL context, run must not be nested.
+*/
+class PatchScheduler
+{
+public:
+	static PatchScheduler& Instance();
+
+	//Calls func(task) for every task and returns when all are done, the calling thread takes part. jobStats gets one entry per job.
+	void run(const std::vector<PatchJob>& jobs, const std::function<void(const PatchTask&)>& func, std::vector<PatchTaskStats>& jobStats);
+
+	unsigned int amountThreads() const { return threadCount; }
+	//Tasks the last run took from the deque of another thread
+	unsigned int amountSteals() const { return steals; }
+private:
+	PatchScheduler(const unsigned int threadCount);
+	~PatchScheduler();
+
+	static PatchScheduler* instance;
+
+	//[front, back) of the task indices of a thread, packed as front << 32 | back so owner and thieves claim tasks with one compare and swap
+	struct WorkDeque
+	{
+		std::atomic<unsigned long long> range;
+		WorkDeque() : range(0) { }
+	};
+
+	bool popFront(WorkDeque& deque, unsigned int& task);
+	bool popBack(WorkDeque& deque, unsigned int& task);
+	void work(const unsigned int thread);
+	void workerLoop(const unsigned int thread);
+
+	unsigned int threadCount;
+	std::vector<std::thread> workers;
+	std::unique_ptr<WorkDeque[]> deques;
+
+	//State of the current run
+	std::vector<PatchTask> tasks;
+	std::vector<unsigned int> order; //Task indices, the deque of a thread is a range of it
+	std::vector<PatchTaskStats> taskStats;
+	const std::function<void(const PatchTask&)>* taskFunc = 0;
+	std::atomic<unsigned int> steals;
+
+	std::mutex runMutex;
+	std::condition_variable runStart, runDone;
+	unsigned long long generation = 0;
+	unsigned int workersDone = 0;
+	bool quit = false;
+};
+
+#endif
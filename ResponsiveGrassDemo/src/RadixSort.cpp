@@ -0,0 +1,82 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "RadixSort.h"
+
+#include <iostream>
+#include "Parallel.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+void parallelRadixSort(std::vector<unsigned long long>& keys, std::vector<unsigned int>& values)
+{
+	if (keys.size() != values.size())
+	{
+		std::cout << "ERROR parallelRadixSort: Amount of keys and values differ!" << std::endl;
+		return;
+	}
+
+	const unsigned int count = (unsigned int)keys.size();
+	if (count < 2)
+	{
+		return;
+	}
+
+	const unsigned int amountChunks = (count + RADIX_SORT_CHUNK_SIZE - 1) / RADIX_SORT_CHUNK_SIZE;
+	std::vector<unsigned int> histogram(amountChunks * RADIX_BUCKETS);
+	std::vector<unsigned long long> keysTmp(count);
+	std::vector<unsigned int> valuesTmp(count);
+
+	for (unsigned int shift = 0; shift < 64; shift += RADIX_BITS)
+	{
+		std::fill(histogram.begin(), histogram.end(), 0);
+		parallelFor(count, RADIX_SORT_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int chunk)
+		{
+			unsigned int* h = &histogram[chunk * RADIX_BUCKETS];
+			for (unsigned int i = begin; i < end; i++)
+			{
+				h[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+			}
+		});
+
+		//Exclusive prefix sum in digit-major order, so the chunks of a digit follow each other
+		unsigned int sum = 0;
+		bool singleDigit = false;
+		for (unsigned int d = 0; d < RADIX_BUCKETS; d++)
+		{
+			unsigned int digitCount = 0;
+			for (unsigned int c = 0; c < amountChunks; c++)
+			{
+				unsigned int h = histogram[c * RADIX_BUCKETS + d];
+				histogram[c * RADIX_BUCKETS + d] = sum;
+				sum += h;
+				digitCount += h;
+			}
+			if (digitCount == count)
+			{
+				singleDigit = true;
+			}
+		}
+		if (singleDigit)
+		{
+			continue;
+		}
+
+		parallelFor(count, RADIX_SORT_CHUNK_SIZE, [&](const unsigned int begin, const unsigned int end, const unsigned int chunk)
+		{
+			unsigned int* offset = &histogram[chunk * RADIX_BUCKETS];
+			for (unsigned int i = begin; i < end; i++)
+			{
+				unsigned int dst = offset[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+				keysTmp[dst] = keys[i];
+				valuesTmp[dst] = values[i];
+			}
+		});
+
+		keys.swap(keysTmp);
+		values.swap(valuesTmp);
+	}
+}
@@ -0,0 +1,20 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <vector>
+
+#define RADIX_SORT_CHUNK_SIZE 65536
+
+/**
+*  Stable LSD radix sort of 64 bit keys with 8 bit digits, values are moved along with their keys.
+*  Every pass builds the digit histograms of all chunks in parallel and scatters the chunks in parallel,
+*  each chunk into its own precomputed ranges. Passes over digits that are equal for all keys are skipped.
+*/
+void parallelRadixSort(std::vector<unsigned long long>& keys, std::vector<unsigned int>& values);
+
+#endif
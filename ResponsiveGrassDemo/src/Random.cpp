@@ -0,0 +1,130 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "Random.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define RANDOM_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+RandomStream::RandomStream(const unsigned long long seed, const unsigned int stream) : stream(stream)
+{
+	key[0] = (unsigned int)(seed & 0xFFFFFFFFull);
+	key[1] = (unsigned int)(seed >> 32);
+}
+
+RandomStream::~RandomStream()
+{
+
+}
+
+void RandomStream::philox(const unsigned int counter[4], const unsigned int key[2], unsigned int out[4])
+{
+	unsigned int c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	unsigned int k0 = key[0], k1 = key[1];
+
+	for (unsigned int r = 0; r < PHILOX_ROUNDS; r++)
+	{
+		unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0;
+		unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2;
+		unsigned int hi0 = (unsigned int)(p0 >> 32), lo0 = (unsigned int)p0;
+		unsigned int hi1 = (unsigned int)(p1 >> 32), lo1 = (unsigned int)p1;
+
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+#ifdef RANDOM_USE_SSE2
+//Four 32x32->64 bit multiplications, returns the high and low words in separate registers
+inline void mulhilo4(const __m128i a, const __m128i m, __m128i& hi, __m128i& lo)
+{
+	__m128i even = _mm_mul_epu32(a, m);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+	lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 3, 1)));
+}
+#endif
+
+void RandomStream::fillUniform(float* out, const unsigned int count, const unsigned int firstElement, const unsigned int block) const
+{
+	unsigned int j = 0;
+
+#ifdef RANDOM_USE_SSE2
+	const __m128i m0 = _mm_set1_epi32((int)PHILOX_M0);
+	const __m128i m1 = _mm_set1_epi32((int)PHILOX_M1);
+	const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+	for (; j + 16 <= count; j += 16)
+	{
+		//Lane i holds the counter of element firstElement + j / 4 + i
+		unsigned int e = firstElement + j / 4;
+		__m128i c0 = _mm_setr_epi32((int)e, (int)(e + 1), (int)(e + 2), (int)(e + 3));
+		__m128i c1 = _mm_set1_epi32((int)block);
+		__m128i c2 = _mm_set1_epi32((int)stream);
+		__m128i c3 = _mm_setzero_si128();
+		__m128i k0 = _mm_set1_epi32((int)key[0]);
+		__m128i k1 = _mm_set1_epi32((int)key[1]);
+		const __m128i w0 = _mm_set1_epi32((int)PHILOX_W0);
+		const __m128i w1 = _mm_set1_epi32((int)PHILOX_W1);
+
+		for (unsigned int r = 0; r < PHILOX_ROUNDS; r++)
+		{
+			__m128i hi0, lo0, hi1, lo1;
+			mulhilo4(c0, m0, hi0, lo0);
+			mulhilo4(c2, m1, hi1, lo1);
+
+			c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+			c1 = lo1;
+			c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+			c3 = lo0;
+
+			k0 = _mm_add_epi32(k0, w0);
+			k1 = _mm_add_epi32(k1, w1);
+		}
+
+		//Transpose from component-major to element-major order
+		__m128i t0 = _mm_unpacklo_epi32(c0, c1);
+		__m128i t1 = _mm_unpacklo_epi32(c2, c3);
+		__m128i t2 = _mm_unpackhi_epi32(c0, c1);
+		__m128i t3 = _mm_unpackhi_epi32(c2, c3);
+		__m128i e0 = _mm_unpacklo_epi64(t0, t1);
+		__m128i e1 = _mm_unpackhi_epi64(t0, t1);
+		__m128i e2 = _mm_unpacklo_epi64(t2, t3);
+		__m128i e3 = _mm_unpackhi_epi64(t2, t3);
+
+		_mm_storeu_ps(out + j + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(e0, 8)), scale));
+		_mm_storeu_ps(out + j + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(e1, 8)), scale));
+		_mm_storeu_ps(out + j + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(e2, 8)), scale));
+		_mm_storeu_ps(out + j + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(e3, 8)), scale));
+	}
+#endif
+
+	//Scalar tail
+	for (; j < count; j += 4)
+	{
+		glm::vec4 u = uniform4(firstElement + j / 4, block);
+		for (unsigned int i = 0; i < 4 && j + i < count; i++)
+		{
+			out[j + i] = u[i];
+		}
+	}
+}
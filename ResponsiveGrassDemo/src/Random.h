@@ -0,0 +1,62 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include "Common.h"
+
+/**
+*  Stateless counter-based random number generator (Philox4x32-10).
+*  Every value is addressed by (seed, stream, element, block), so any element can be generated
+*  independently on any thread and the result never depends on the order or the amount of threads.
+*  Each (element, block) pair yields four independent 32 bit values.
+*/
+class RandomStream
+{
+public:
+	RandomStream(const unsigned long long seed, const unsigned int stream);
+	~RandomStream();
+
+	static void philox(const unsigned int counter[4], const unsigned int key[2], unsigned int out[4]);
+
+	inline glm::uvec4 bits(const unsigned int element, const unsigned int block = 0) const
+	{
+		unsigned int counter[4] = { element, block, stream, 0u };
+		unsigned int out[4];
+		philox(counter, key, out);
+		return glm::uvec4(out[0], out[1], out[2], out[3]);
+	}
+
+	//Four uniform floats in [0,1)
+	inline glm::vec4 uniform4(const unsigned int element, const unsigned int block = 0) const
+	{
+		glm::uvec4 b = bits(element, block);
+		return glm::vec4(toUniform(b.x), toUniform(b.y), toUniform(b.z), toUniform(b.w));
+	}
+
+	//The index-th uniform float in [0,1) of an element
+	inline float uniform(const unsigned int element, const unsigned int index = 0) const
+	{
+		return toUniform(bits(element, index >> 2)[index & 3]);
+	}
+
+	/**
+	*  Batch fill: out[j] = uniform4(firstElement + j / 4, block)[j % 4] for j in [0, count).
+	*  Uses SSE2 to evaluate four elements at once where available.
+	*/
+	void fillUniform(float* out, const unsigned int count, const unsigned int firstElement = 0, const unsigned int block = 0) const;
+
+	static inline float toUniform(const unsigned int bits)
+	{
+		return (float)(bits >> 8) * (1.0f / 16777216.0f);
+	}
+
+private:
+	unsigned int key[2];
+	unsigned int stream;
+};
+
+#endif
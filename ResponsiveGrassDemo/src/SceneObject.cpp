@@ -10,6 +10,8 @@
 #include "OpenGLState.h"
 #include "BoundingBox.h"
 #include "BoundingSphere.h"
+#include "Random.h"
+#include "FaceExtractor.h"
 
 #include "glm/gtc/matrix_transform.hpp"
 
@@ -724,52 +726,12 @@ void getIndizesPositions(const AssimpImporter::ImportModel* model, const glm::ve
 
 void generateFaceListFromInputModel(std::vector<Geometry::TriangleFace>& faceList, const AssimpImporter::ImportModel* model, const glm::vec3& scale, const glm::mat4& geometryMatrix)
 {
-	std::vector<const AssimpImporter::ImportModel*> models;
-	std::vector<glm::mat4> modelMatrices;
-	models.push_back(model);
-	modelMatrices.push_back(model->transform * geometryMatrix);
-	for (unsigned int i = 0; i<models.size(); i++)
-	{
-		const AssimpImporter::ImportModel* m = models[i];
-		glm::mat4 modelMatrix = modelMatrices[i];
-		if (m->position.size() > 0)
-		{
-			if (m->index.size() > 0)
-			{
-				for (unsigned int ind = 0; ind<m->index.size(); ind+=3)
-				{
-					glm::vec3 p1 = glm::vec3(modelMatrix * glm::vec4(m->position[m->index[ind + 0]] * scale, 1.0f));
-					glm::vec3 p2 = glm::vec3(modelMatrix * glm::vec4(m->position[m->index[ind + 1]] * scale, 1.0f));
-					glm::vec3 p3 = glm::vec3(modelMatrix * glm::vec4(m->position[m->index[ind + 2]] * scale, 1.0f));
-					if (m->tangent.size() > 0)
-					{
-						Geometry::Vertex v1 = { p1, m->normal[m->index[ind + 0]], m->tangent[m->index[ind + 0]], m->bitangent[m->index[ind + 0]] };
-						Geometry::Vertex v2 = { p2, m->normal[m->index[ind + 1]], m->tangent[m->index[ind + 1]], m->bitangent[m->index[ind + 1]] };
-						Geometry::Vertex v3 = { p3, m->normal[m->index[ind + 2]], m->tangent[m->index[ind + 2]], m->bitangent[m->index[ind + 2]] };
-						Geometry::TriangleFace face(v1, v2, v3);
-						faceList.push_back(face);
-					}
-					else
-					{
-						Geometry::Vertex v1 = { p1, m->normal[m->index[ind + 0]], glm::vec3(1.0f, 0.0f, 0.0f), glm::normalize(glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), m->normal[m->index[ind + 0]])) };
-						Geometry::Vertex v2 = { p2, m->normal[m->index[ind + 1]], glm::vec3(1.0f, 0.0f, 0.0f), glm::normalize(glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), m->normal[m->index[ind + 1]])) };
-						Geometry::Vertex v3 = { p3, m->normal[m->index[ind + 2]], glm::vec3(1.0f, 0.0f, 0.0f), glm::normalize(glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), m->normal[m->index[ind + 2]])) };
-						Geometry::TriangleFace face(v1, v2, v3);
-						faceList.push_back(face);
-					}
-				}
-			}
-		}
-
-		if (m->children.size() > 0)
-		{
-			for (unsigned int c = 0; c < m->children.size(); c++)
-			{
-				models.push_back(m->children[c]);
-				modelMatrices.push_back(m->children[c]->transform * modelMatrix);
-			}
-		}
-	}
+	FaceExtractor::Params extraction;
+	extraction.scale = scale;
+	extraction.rootMatrix = model->transform * geometryMatrix;
+	extraction.transformNormals = false;
+	glm::vec3 facesMin, facesMax;
+	FaceExtractor::extract(model, extraction, faceList, facesMin, facesMax);
 }
 
 SceneObjectGeometry::SceneObjectGeometry(const std::string filename, const BasicGeometry boundingType, const glm::vec3& scale, const bool generateFaceList, const bool calculateInnerSphere, const unsigned int innerSphereMethod, const bool generatePhysicalObject, const float staticFriction, const float dynamicFriction, const float restitution, const float angularDamping, const float density) : SceneObjectGeometry(AssimpImporter::importModel(filename), boundingType, scale, generateFaceList, calculateInnerSphere, innerSphereMethod, generatePhysicalObject, staticFriction, dynamicFriction, restitution, angularDamping, density)
@@ -1165,7 +1127,7 @@ struct PointSide
 };
 
 //http://www.blackpawn.com/texts/pointinpoly/ und https://www.ecse.rpi.edu/~wrf/Research/Short_Notes/pt_in_polyhedron.html
-bool isPointInPolyhedron(const glm::vec3& point, const std::vector<TriangleFace>& faces, const glm::vec3* certainPointForDirection, const float scale, const unsigned int method)
+bool isPointInPolyhedron(const glm::vec3& point, const std::vector<TriangleFace>& faces, const glm::vec3* certainPointForDirection, const RandomStream& rng, const unsigned int element, const float scale, const unsigned int method)
 {
 	double s = (double)scale;
 	glm::dvec3 pHP = glm::dvec3(point) * s;
@@ -1177,10 +1139,11 @@ bool isPointInPolyhedron(const glm::vec3& point, const std::vector<TriangleFace>
 	}
 	else
 	{
-		ray = glm::normalize(glm::dvec3(random(), random(), random()));
+		ray = glm::normalize(glm::dvec3(rng.uniform4(element)));
 	}
 
 	double insideNum = 0.0f;
+	unsigned int perturbation = 0;
 
 	std::vector<PointSide> trianglePointsFound;
 
@@ -1209,7 +1172,7 @@ bool isPointInPolyhedron(const glm::vec3& point, const std::vector<TriangleFace>
 			glm::dvec3 nRay;
 			while (glm::abs(denom) < 1e-5)
 			{
-				nRay = ray + glm::dvec3(random()-0.5, random()-0.5, random()-0.5) * 0.001;
+				nRay = ray + (glm::dvec3(rng.uniform4(element, ++perturbation)) - 0.5) * 0.001;
 				denom = glm::dot(nRay, normal);
 			}
 			t = glm::dot(vert1 - pHP, normal) / denom;
@@ -1335,7 +1298,7 @@ bool isPointInPolyhedron(const glm::vec3& point, const std::vector<TriangleFace>
 	return abs(insideNum) > 0.5f; //for arithmetic errors
 }
 
-void SceneObjectGeometry::calculateInnerSphereGreedy(const std::vector<unsigned int> index, const std::vector<glm::vec3> position, const unsigned int method, const unsigned int n)
+void SceneObjectGeometry::calculateInnerSphereGreedy(const std::vector<unsigned int> index, const std::vector<glm::vec3> position, const unsigned int method, const unsigned int n, const unsigned long long seed)
 {
 	//std::cout << "Calculate InnerSphere" << std::endl;
 	std::vector<TriangleFace> faces;
@@ -1373,15 +1336,18 @@ void SceneObjectGeometry::calculateInnerSphereGreedy(const std::vector<unsigned
 	glm::vec3 bestMeanPoint;
 	bool foundInnerSphere = false;
 
+	RandomStream rng(seed, 0);
+	RandomStream rayRng(seed, 1);
 	for (unsigned int iteration = 0; iteration < n; iteration++)
 	{
-		unsigned int i1 = (unsigned int)(rand() % position.size());
-		unsigned int i2 = (unsigned int)(rand() % position.size());
+		glm::uvec4 bits = rng.bits(iteration);
+		unsigned int i1 = (unsigned int)(bits.x % position.size());
+		unsigned int i2 = (unsigned int)(bits.y % position.size());
 
 		glm::vec3 meanPoint = (position[i1] + position[i2]) * 0.5f;
 
 		float scale = glm::min(1.0f / smallestArea, 1000.0f);
-		if (isPointInPolyhedron(meanPoint, faces, &largestFaceMeanPoint, scale, method))
+		if (isPointInPolyhedron(meanPoint, faces, &largestFaceMeanPoint, rayRng, iteration, scale, method))
 		{
 			foundInnerSphere = true;
 
@@ -46,7 +46,7 @@ public:
 	BoundingObject* getBoundingObject() const;
 	BasicGeometry getGeometryType() const;
 	const glm::vec3& getGeometryScale() const;
-	void calculateInnerSphereGreedy(const std::vector<unsigned int> index, const std::vector<glm::vec3> position, const unsigned int method, const unsigned int n = 100);
+	void calculateInnerSphereGreedy(const std::vector<unsigned int> index, const std::vector<glm::vec3> position, const unsigned int method, const unsigned int n = 100, const unsigned long long seed = 0);
 	std::vector<Geometry::TriangleFace>& getFaceList() { return faceList; }
 
 	glm::vec3 min, max;
@@ -0,0 +1,96 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef SPACEFILLINGCURVE_H
+#define SPACEFILLINGCURVE_H
+
+#include "Common.h"
+
+#define CURVE_BITS_PER_AXIS 21
+
+/**
+*  Keys of 3D space-filling curves on a grid of 2^21 cells per axis, so a key fits into 63 bits.
+*  Sorting points by their key keeps points that are close on the curve close in space.
+*/
+namespace SpaceFillingCurve
+{
+	//Spreads the lower 21 bits of v, so there are two zero bits between each of them
+	inline unsigned long long expandBits(const unsigned int v)
+	{
+		unsigned long long x = v & 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffffull;
+		x = (x | x << 16) & 0x1f0000ff0000ffull;
+		x = (x | x << 8) & 0x100f00f00f00f00full;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+		x = (x | x << 2) & 0x1249249249249249ull;
+		return x;
+	}
+
+	//Grid cell of p inside the box [min, min + 1 / invExtent]
+	inline glm::uvec3 quantize(const glm::vec3& p, const glm::vec3& min, const glm::vec3& invExtent)
+	{
+		const float cells = (float)((1u << CURVE_BITS_PER_AXIS) - 1);
+		glm::vec3 q = glm::clamp((p - min) * invExtent, 0.0f, 1.0f) * cells;
+		return glm::uvec3((unsigned int)q.x, (unsigned int)q.y, (unsigned int)q.z);
+	}
+
+	//Inverse of the box extent for quantize, flat axes map to cell 0
+	inline glm::vec3 inverseExtent(const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 extent = max - min;
+		return glm::vec3(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+	}
+
+	inline unsigned long long morton(const glm::uvec3& cell)
+	{
+		return expandBits(cell.x) | (expandBits(cell.y) << 1) | (expandBits(cell.z) << 2);
+	}
+
+	//Hilbert index after J. Skilling, "Programming the Hilbert curve" (2004)
+	inline unsigned long long hilbert(const glm::uvec3& cell)
+	{
+		unsigned int x[3] = { cell.x, cell.y, cell.z };
+		const unsigned int m = 1u << (CURVE_BITS_PER_AXIS - 1);
+
+		//Inverse undo
+		for (unsigned int q = m; q > 1; q >>= 1)
+		{
+			unsigned int p = q - 1;
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				if (x[i] & q)
+				{
+					x[0] ^= p;
+				}
+				else
+				{
+					unsigned int t = (x[0] ^ x[i]) & p;
+					x[0] ^= t;
+					x[i] ^= t;
+				}
+			}
+		}
+
+		//Gray encode
+		x[1] ^= x[0];
+		x[2] ^= x[1];
+		unsigned int t = 0;
+		for (unsigned int q = m; q > 1; q >>= 1)
+		{
+			if (x[2] & q)
+			{
+				t ^= q - 1;
+			}
+		}
+		x[0] ^= t;
+		x[1] ^= t;
+		x[2] ^= t;
+
+		//The transposed index interleaved, x[0] holds the most significant bit of every level
+		return morton(glm::uvec3(x[2], x[1], x[0]));
+	}
+}
+
+#endif
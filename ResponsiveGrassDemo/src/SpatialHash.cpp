@@ -0,0 +1,120 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "SpatialHash.h"
+
+#include <algorithm>
+
+SpatialHash::SpatialHash() : cellSize(1.0f), invCellSize(1.0f), maxW(0.0f), amountPoints(0), bucketMask(0)
+{
+	reset(1.0f);
+}
+
+SpatialHash::~SpatialHash()
+{
+
+}
+
+void SpatialHash::reset(const float _cellSize)
+{
+	cellSize = glm::max(_cellSize, FLT_MIN);
+	invCellSize = 1.0f / cellSize;
+	build(0, 0);
+}
+
+void SpatialHash::build(const glm::vec4* newPoints, const unsigned int count)
+{
+	amountPoints = count;
+	maxW = 0.0f;
+
+	unsigned int amountBuckets = SPATIAL_HASH_MIN_BUCKETS;
+	while (amountBuckets < 2 * count)
+	{
+		amountBuckets *= 2;
+	}
+	bucketMask = amountBuckets - 1;
+
+	//Counting sort by bucket
+	bucketStart.assign(amountBuckets + 1, 0);
+	scratchBuckets.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int b = bucketOf(cellOf(glm::vec3(newPoints[i])));
+		scratchBuckets[i] = b;
+		bucketStart[b + 1]++;
+		maxW = glm::max(maxW, newPoints[i].w);
+	}
+	for (unsigned int b = 0; b < amountBuckets; b++)
+	{
+		bucketStart[b + 1] += bucketStart[b];
+	}
+
+	points.resize(count);
+	indices.resize(count);
+	//overflowHead is used as insertion cursor before it is cleared
+	overflowHead.assign(bucketStart.begin(), bucketStart.end() - 1);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int pos = overflowHead[scratchBuckets[i]]++;
+		points[pos] = newPoints[i];
+		indices[pos] = i;
+	}
+	std::fill(overflowHead.begin(), overflowHead.end(), SPATIAL_HASH_EMPTY);
+
+	overflowNext.clear();
+	overflowPoints.clear();
+	overflowIndices.clear();
+}
+
+void SpatialHash::insert(const glm::vec4& point)
+{
+	unsigned int b = bucketOf(cellOf(glm::vec3(point)));
+	overflowNext.push_back(overflowHead[b]);
+	overflowHead[b] = (unsigned int)overflowPoints.size();
+	overflowPoints.push_back(point);
+	overflowIndices.push_back(amountPoints);
+	amountPoints++;
+	maxW = glm::max(maxW, point.w);
+
+	//Keeps the overflow chains short, amortized O(1) per insertion
+	if (overflowPoints.size() > glm::max((unsigned int)points.size(), (unsigned int)SPATIAL_HASH_MIN_BUCKETS))
+	{
+		merge();
+	}
+}
+
+void SpatialHash::merge()
+{
+	scratchPoints.resize(amountPoints);
+	for (unsigned int i = 0; i < points.size(); i++)
+	{
+		scratchPoints[indices[i]] = points[i];
+	}
+	for (unsigned int i = 0; i < overflowPoints.size(); i++)
+	{
+		scratchPoints[overflowIndices[i]] = overflowPoints[i];
+	}
+	build(scratchPoints.data(), (unsigned int)scratchPoints.size());
+}
+
+bool SpatialHash::anyWithin(const glm::vec3& position, const float radius) const
+{
+	const float radius2 = radius * radius;
+	return !query(position - glm::vec3(radius), position + glm::vec3(radius), [&](const unsigned int, const glm::vec4& p) -> bool
+	{
+		glm::vec3 d = glm::vec3(p) - position;
+		return glm::dot(d, d) >= radius2;
+	});
+}
+
+bool SpatialHash::anyIntersecting(const glm::vec4& sphere) const
+{
+	const glm::vec3 center = glm::vec3(sphere);
+	const float range = sphere.w + maxW;
+	return !query(center - glm::vec3(range), center + glm::vec3(range), [&](const unsigned int, const glm::vec4& p) -> bool
+	{
+		return glm::distance(center, glm::vec3(p)) >= sphere.w + p.w;
+	});
+}
@@ -0,0 +1,148 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <vector>
+#include "Common.h"
+
+#define SPATIAL_HASH_EMPTY 0xFFFFFFFFu
+#define SPATIAL_HASH_MIN_BUCKETS 64
+
+/**
+*  Uniform grid stored as a hash table in compressed (CSR) layout: the points of all cells that map to bucket b
+*  lie contiguous in [bucketStart[b], bucketStart[b+1]). Bulk insertion builds this layout with a counting sort,
+*  single insertions are chained into an overflow list that is merged into the layout once it gets too long.
+*  Queries never allocate. Points are vec4, w is free for a radius or payload.
+*/
+class SpatialHash
+{
+public:
+	SpatialHash();
+	~SpatialHash();
+
+	//Removes all points and sets the cell size, keeps the allocated memory
+	void reset(const float cellSize);
+
+	//Replaces the content with the given points, point i gets index i
+	void build(const glm::vec4* points, const unsigned int count);
+	void build(const std::vector<glm::vec4>& points) { build(points.data(), (unsigned int)points.size()); }
+
+	//Adds a point with index size()
+	void insert(const glm::vec4& point);
+
+	unsigned int size() const { return amountPoints; }
+	float getCellSize() const { return cellSize; }
+	float getMaxW() const { return maxW; }
+
+	/**
+	*  Calls visitor(index, point) for every point inside the cells overlapping [min, max] until the visitor returns false.
+	*  Returns false if the query was stopped by the visitor.
+	*/
+	template<typename Visitor>
+	bool query(const glm::vec3& min, const glm::vec3& max, const Visitor& visitor) const;
+
+	bool anyWithin(const glm::vec3& position, const float radius) const;
+
+	//Treats w as radius of the stored points and the query sphere
+	bool anyIntersecting(const glm::vec4& sphere) const;
+
+private:
+	float cellSize, invCellSize, maxW;
+	unsigned int amountPoints;
+	unsigned int bucketMask;
+
+	std::vector<unsigned int> bucketStart;
+	std::vector<glm::vec4> points;
+	std::vector<unsigned int> indices;
+
+	std::vector<unsigned int> overflowHead;
+	std::vector<unsigned int> overflowNext;
+	std::vector<glm::vec4> overflowPoints;
+	std::vector<unsigned int> overflowIndices;
+
+	std::vector<unsigned int> scratchBuckets;
+	std::vector<glm::vec4> scratchPoints;
+
+	void merge();
+
+	inline glm::ivec3 cellOf(const glm::vec3& p) const
+	{
+		return glm::ivec3(glm::floor(p * invCellSize));
+	}
+
+	inline unsigned int bucketOf(const glm::ivec3& cell) const
+	{
+		return (((unsigned int)cell.x * 73856093u) ^ ((unsigned int)cell.y * 19349663u) ^ ((unsigned int)cell.z * 83492791u)) & bucketMask;
+	}
+};
+
+template<typename Visitor>
+bool SpatialHash::query(const glm::vec3& min, const glm::vec3& max, const Visitor& visitor) const
+{
+	if (amountPoints == 0)
+	{
+		return true;
+	}
+
+	glm::ivec3 cMin = cellOf(min);
+	glm::ivec3 cMax = cellOf(max);
+	double amountCells = (double)(cMax.x - cMin.x + 1) * (double)(cMax.y - cMin.y + 1) * (double)(cMax.z - cMin.z + 1);
+
+	//Ranges larger than the table are cheaper to answer by a linear scan
+	if (amountCells > (double)(bucketMask + 1))
+	{
+		for (unsigned int i = 0; i < points.size(); i++)
+		{
+			glm::ivec3 c = cellOf(glm::vec3(points[i]));
+			if (glm::all(glm::greaterThanEqual(c, cMin)) && glm::all(glm::lessThanEqual(c, cMax)) && !visitor(indices[i], points[i]))
+			{
+				return false;
+			}
+		}
+		for (unsigned int i = 0; i < overflowPoints.size(); i++)
+		{
+			glm::ivec3 c = cellOf(glm::vec3(overflowPoints[i]));
+			if (glm::all(glm::greaterThanEqual(c, cMin)) && glm::all(glm::lessThanEqual(c, cMax)) && !visitor(overflowIndices[i], overflowPoints[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	for (int z = cMin.z; z <= cMax.z; z++)
+	{
+		for (int y = cMin.y; y <= cMax.y; y++)
+		{
+			for (int x = cMin.x; x <= cMax.x; x++)
+			{
+				glm::ivec3 cell(x, y, z);
+				unsigned int b = bucketOf(cell);
+
+				//Several cells can share a bucket, only report the points of the requested cell
+				for (unsigned int i = bucketStart[b]; i < bucketStart[b + 1]; i++)
+				{
+					if (cellOf(glm::vec3(points[i])) == cell && !visitor(indices[i], points[i]))
+					{
+						return false;
+					}
+				}
+				for (unsigned int i = overflowHead[b]; i != SPATIAL_HASH_EMPTY; i = overflowNext[i])
+				{
+					if (cellOf(glm::vec3(overflowPoints[i])) == cell && !visitor(overflowIndices[i], overflowPoints[i]))
+					{
+						return false;
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+#endif
@@ -110,20 +110,7 @@ void searchForOuterSphere(const unsigned int idx, const float fac, const std::ve
 	}
 }
 
-bool intersect(const glm::vec4& s, const std::vector<glm::vec4>& ls)
-{
-	for each(glm::vec4 sphere in ls)
-	{
-		if (glm::distance(glm::vec3(s), glm::vec3(sphere)) < s.w + sphere.w)
-		{
-			return true;
-		}
-	}
-
-	return false;
-}
-
-std::vector<glm::vec4> SpherePacker::packSpheres(const std::vector<Geometry::TriangleFace>& faces, const unsigned int maxIterations, const bool deleteInnerSpheres)
+std::vector<glm::vec4> SpherePacker::packSpheres(const std::vector<Geometry::TriangleFace>& faces, const unsigned int maxIterations, const bool deleteInnerSpheres, const unsigned long long seed)
 {
 	std::vector<glm::vec4> spheres;
 
@@ -213,13 +200,15 @@ std::vector<glm::vec4> SpherePacker::packSpheres(const std::vector<Geometry::Tri
 
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, protoBuffer);
 
+	RandomStream rng(seed, 0);
+	SpatialHash sphereHash;
 	for (unsigned int i = 0; i < maxIterations; i++)
 	{
-		//Generate 1 Prototype per face
+		//Generate 1 Prototype per face, the random values only depend on the seed, the face and the iteration
 		for (unsigned int f = 0; f < amountPrototypes; f++)
 		{
-			auto face = faces[f];
-			glm::vec3 barycentric = glm::vec3(random(), random(), random());
+			const Geometry::TriangleFace& face = faces[f];
+			glm::vec3 barycentric = glm::vec3(rng.uniform4(f, i));
 			barycentric /= barycentric.x + barycentric.y + barycentric.z;
 			glm::vec3 p = barycentric.x * face.vertices[0].position + barycentric.y * face.vertices[1].position + barycentric.z * face.vertices[2].position;
 			p += -face.faceNormal * glm::min(span.x, glm::min(span.y, span.z)) * 0.001f;
@@ -258,13 +247,27 @@ std::vector<glm::vec4> SpherePacker::packSpheres(const std::vector<Geometry::Tri
 			}
 		} compVec4W;
 		std::sort(potentialSpheres.begin(), potentialSpheres.end(), compVec4W);
+		if (i == 0)
+		{
+			//Spheres mostly get smaller over the iterations, cells of twice the first radius keep most queries within 27 cells
+			float largestRadius = 0.0f;
+			for (unsigned int s = 0; s < potentialSpheres.size(); s++)
+			{
+				if (isfinite(potentialSpheres[s].w))
+				{
+					largestRadius = glm::max(largestRadius, potentialSpheres[s].w);
+				}
+			}
+			sphereHash.reset(largestRadius > 0.0f ? 2.0f * largestRadius : glm::max(span.x, glm::max(span.y, span.z)) / 16.0f);
+		}
 		for (unsigned int s = 0; s < potentialSpheres.size(); s++)
 		{
 			glm::vec4 sphere = potentialSpheres[s];
-			if (isfinite(sphere.w) && !intersect(sphere, spheres))
+			if (isfinite(sphere.w) && !sphereHash.anyIntersecting(sphere))
 			{
 				newSpheres.push_back(sphere);
 				spheres.push_back(sphere);
+				sphereHash.insert(sphere);
 				//std::cout << "Add sphere at [" << sphere.x << "," << sphere.y << "," << sphere.z << "] with radius " << sphere.w << std::endl;
 			}
 			/*else if (!isfinite(sphere.w))
@@ -11,6 +11,8 @@
 #include "Clock.h"
 #include "ThreadPool.h"
 #include "Shader.h"
+#include "Random.h"
+#include "SpatialHash.h"
 
 #define SPHERE_PACKER_THREAD_COUNT 6
 
@@ -46,7 +48,7 @@ public:
 		return *instance;
 	}
 
-	static std::vector<glm::vec4> packSpheres(const std::vector<Geometry::TriangleFace>& faces, const unsigned int maxIterations, const bool deleteInnerSpheres);
+	static std::vector<glm::vec4> packSpheres(const std::vector<Geometry::TriangleFace>& faces, const unsigned int maxIterations, const bool deleteInnerSpheres, const unsigned long long seed = 0);
 };
 
 #endif
\ No newline at end of file
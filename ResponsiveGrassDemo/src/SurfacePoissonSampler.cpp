@@ -0,0 +1,305 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#include "SurfacePoissonSampler.h"
+
+#include <algorithm>
+#include <iostream>
+
+//Bridson's method places about 0.65 * area / r^2 samples, start below the requested distance so one pass is usually enough
+#define POISSON_RADIUS_FACTOR 0.78f
+#define POISSON_MAX_WALK_STEPS 64
+
+//Random blocks used per pass
+#define POISSON_BLOCK_SEED 0
+#define POISSON_BLOCK_CANDIDATE 1
+#define POISSON_BLOCK_ACTIVE 2
+#define POISSON_BLOCKS_PER_PASS 3
+
+struct EdgeKey
+{
+	glm::vec3 a, b;
+	unsigned int face, edge;
+};
+
+bool lessVec3(const glm::vec3& a, const glm::vec3& b)
+{
+	if (a.x != b.x) return a.x < b.x;
+	if (a.y != b.y) return a.y < b.y;
+	return a.z < b.z;
+}
+
+SurfacePoissonSampler::SurfacePoissonSampler(const std::vector<Geometry::TriangleFace>& faces) : faces(faces), frames(faces.size()), faceSampler()
+{
+	std::vector<float> areas(faces.size());
+	for (unsigned int i = 0; i < faces.size(); i++)
+	{
+		const Geometry::TriangleFace& f = faces[i];
+		areas[i] = f.area;
+
+		FaceFrame& frame = frames[i];
+		frame.edge0 = f.vertices[1].position - f.vertices[0].position;
+		frame.edge1 = f.vertices[2].position - f.vertices[0].position;
+		frame.d00 = glm::dot(frame.edge0, frame.edge0);
+		frame.d01 = glm::dot(frame.edge0, frame.edge1);
+		frame.d11 = glm::dot(frame.edge1, frame.edge1);
+		float denom = frame.d00 * frame.d11 - frame.d01 * frame.d01;
+		frame.invDenom = (denom > 0.0f) ? 1.0f / denom : 0.0f;
+		frame.neighbor[0] = frame.neighbor[1] = frame.neighbor[2] = -1;
+	}
+	faceSampler.build(areas);
+
+	buildAdjacency();
+}
+
+SurfacePoissonSampler::~SurfacePoissonSampler()
+{
+
+}
+
+void SurfacePoissonSampler::buildAdjacency()
+{
+	//Faces only store vertex copies, so shared edges are found by sorting the edges by their end points
+	std::vector<EdgeKey> edges;
+	edges.reserve(faces.size() * 3);
+	for (unsigned int i = 0; i < faces.size(); i++)
+	{
+		for (unsigned int j = 0; j < 3; j++)
+		{
+			EdgeKey e;
+			e.a = faces[i].vertices[(j + 1) % 3].position;
+			e.b = faces[i].vertices[(j + 2) % 3].position;
+			if (lessVec3(e.b, e.a))
+			{
+				std::swap(e.a, e.b);
+			}
+			e.face = i;
+			e.edge = j;
+			edges.push_back(e);
+		}
+	}
+
+	std::sort(edges.begin(), edges.end(), [](const EdgeKey& e1, const EdgeKey& e2)
+	{
+		if (e1.a != e2.a) return lessVec3(e1.a, e2.a);
+		return lessVec3(e1.b, e2.b);
+	});
+
+	for (unsigned int i = 0; i + 1 < edges.size(); i++)
+	{
+		const EdgeKey& e1 = edges[i];
+		const EdgeKey& e2 = edges[i + 1];
+		if (e1.a == e2.a && e1.b == e2.b)
+		{
+			//Non-manifold edges only connect the first two faces
+			if (frames[e1.face].neighbor[e1.edge] < 0 && frames[e2.face].neighbor[e2.edge] < 0)
+			{
+				frames[e1.face].neighbor[e1.edge] = (int)e2.face;
+				frames[e2.face].neighbor[e2.edge] = (int)e1.face;
+			}
+		}
+	}
+}
+
+glm::vec3 SurfacePoissonSampler::barycentric(const unsigned int face, const glm::vec3& position) const
+{
+	const FaceFrame& frame = frames[face];
+	glm::vec3 d = position - faces[face].vertices[0].position;
+	float d20 = glm::dot(d, frame.edge0);
+	float d21 = glm::dot(d, frame.edge1);
+	float v = (frame.d11 * d20 - frame.d01 * d21) * frame.invDenom;
+	float w = (frame.d00 * d21 - frame.d01 * d20) * frame.invDenom;
+	return glm::vec3(1.0f - v - w, v, w);
+}
+
+bool SurfacePoissonSampler::walk(unsigned int& face, glm::vec3& position, glm::vec3 direction, float length) const
+{
+	for (unsigned int step = 0; step < POISSON_MAX_WALK_STEPS; step++)
+	{
+		glm::vec3 target = position + direction * length;
+		glm::vec3 bTarget = barycentric(face, target);
+		if (bTarget.x >= 0.0f && bTarget.y >= 0.0f && bTarget.z >= 0.0f)
+		{
+			position = target;
+			return true;
+		}
+
+		//Find the edge where the path leaves the face
+		glm::vec3 bPosition = barycentric(face, position);
+		float s = 1.0f;
+		int exitEdge = -1;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			if (bTarget[i] < 0.0f)
+			{
+				float si = bPosition[i] / (bPosition[i] - bTarget[i]);
+				if (si < s)
+				{
+					s = si;
+					exitEdge = i;
+				}
+			}
+		}
+		if (exitEdge < 0)
+		{
+			position = target;
+			return true;
+		}
+
+		int next = frames[face].neighbor[exitEdge];
+		if (next < 0)
+		{
+			return false;
+		}
+
+		s = glm::clamp(s, 0.0f, 1.0f);
+		position += direction * length * s;
+		length -= length * s;
+
+		//Fold the direction into the plane of the next face
+		const glm::vec3& n = faces[next].faceNormal;
+		direction -= n * glm::dot(direction, n);
+		float l = glm::length(direction);
+		if (l < 1e-6f)
+		{
+			return false;
+		}
+		direction /= l;
+		face = (unsigned int)next;
+	}
+
+	return false;
+}
+
+unsigned int SurfacePoissonSampler::bridson(const float radius, const RandomStream& rng, const unsigned int pass, std::vector<Sample>& samples) const
+{
+	samples.clear();
+
+	const unsigned int seedBlock = pass * POISSON_BLOCKS_PER_PASS + POISSON_BLOCK_SEED;
+	const unsigned int candidateBlock = pass * POISSON_BLOCKS_PER_PASS + POISSON_BLOCK_CANDIDATE;
+	const unsigned int activeBlock = pass * POISSON_BLOCKS_PER_PASS + POISSON_BLOCK_ACTIVE;
+
+	SpatialHash grid;
+	grid.reset(radius);
+	std::vector<unsigned int> active;
+	unsigned int candidateCounter = 0;
+	unsigned int activeCounter = 0;
+
+	auto accept = [&](const unsigned int face, const glm::vec3& position)
+	{
+		const Geometry::TriangleFace& f = faces[face];
+		glm::vec3 b = glm::max(barycentric(face, position), glm::vec3(0.0f));
+		b /= b.x + b.y + b.z;
+
+		Sample s;
+		s.face = face;
+		s.barycentric = b;
+		s.position = f.vertices[0].position * b.x + f.vertices[1].position * b.y + f.vertices[2].position * b.z;
+
+		active.push_back((unsigned int)samples.size());
+		samples.push_back(s);
+		grid.insert(glm::vec4(s.position, 0.0f));
+	};
+
+	for (unsigned int seedFace = 0; seedFace < faces.size(); seedFace++)
+	{
+		if (faces[seedFace].area <= 0.0f)
+		{
+			continue;
+		}
+
+		const Geometry::TriangleFace& f = faces[seedFace];
+		glm::vec4 rnd = rng.uniform4(seedFace, seedBlock);
+		glm::vec3 b = Geometry::uniformBarycentric(rnd.x, rnd.y);
+		glm::vec3 seed = f.vertices[0].position * b.x + f.vertices[1].position * b.y + f.vertices[2].position * b.z;
+		if (grid.anyWithin(seed, radius))
+		{
+			continue;
+		}
+		accept(seedFace, seed);
+
+		//Grow from the seed until the reachable surface is covered
+		while (!active.empty())
+		{
+			unsigned int a = rng.bits(activeCounter++, activeBlock).x % active.size();
+			Sample cur = samples[active[a]];
+			const Geometry::TriangleFace& curFace = faces[cur.face];
+			glm::vec3 tangent = glm::normalize(frames[cur.face].edge0);
+			glm::vec3 bitangent = glm::cross(curFace.faceNormal, tangent);
+
+			bool found = false;
+			for (unsigned int k = 0; k < POISSON_CANDIDATES; k++)
+			{
+				glm::vec4 r = rng.uniform4(candidateCounter++, candidateBlock);
+				float angle = r.x * 2.0f * PI_F;
+				glm::vec3 direction = tangent * glm::cos(angle) + bitangent * glm::sin(angle);
+
+				unsigned int face = cur.face;
+				glm::vec3 position = cur.position;
+				if (walk(face, position, direction, radius * (1.0f + r.y)) && !grid.anyWithin(position, radius))
+				{
+					accept(face, position);
+					found = true;
+					break;
+				}
+			}
+
+			if (!found)
+			{
+				active[a] = active.back();
+				active.pop_back();
+			}
+		}
+	}
+
+	return (unsigned int)samples.size();
+}
+
+void SurfacePoissonSampler::generate(const unsigned int amount, const float minDistance, const RandomStream& rng, std::vector<Sample>& samples) const
+{
+	samples.clear();
+	if (amount == 0 || faces.empty())
+	{
+		return;
+	}
+
+	float radius = minDistance * POISSON_RADIUS_FACTOR;
+	for (unsigned int pass = 0; pass < POISSON_MAX_PASSES; pass++)
+	{
+		unsigned int count = bridson(radius, rng, pass, samples);
+		std::cout << "Poisson-disk pass " << pass << " with r=" << radius << " generated " << count << " out of " << amount << " samples" << std::endl;
+		if (count >= amount)
+		{
+			break;
+		}
+		radius *= glm::max(glm::sqrt((float)count / (float)amount), 0.5f) * 0.95f;
+	}
+
+	const unsigned int finalBlock = POISSON_MAX_PASSES * POISSON_BLOCKS_PER_PASS;
+	if (samples.size() > amount)
+	{
+		//Random thinning keeps the minimum distance
+		for (unsigned int i = 0; i < amount; i++)
+		{
+			unsigned int j = i + rng.bits(i, finalBlock).x % ((unsigned int)samples.size() - i);
+			std::swap(samples[i], samples[j]);
+		}
+		samples.resize(amount);
+	}
+	else
+	{
+		//Only happens on degenerated surfaces, the remaining samples are distributed by area
+		for (unsigned int i = (unsigned int)samples.size(); i < amount; i++)
+		{
+			glm::uvec4 bits = rng.bits(i, finalBlock);
+			Sample s;
+			s.face = faceSampler.sample(bits.x, RandomStream::toUniform(bits.y));
+			s.barycentric = Geometry::uniformBarycentric(RandomStream::toUniform(bits.z), RandomStream::toUniform(bits.w));
+			const Geometry::TriangleFace& f = faces[s.face];
+			s.position = f.vertices[0].position * s.barycentric.x + f.vertices[1].position * s.barycentric.y + f.vertices[2].position * s.barycentric.z;
+			samples.push_back(s);
+		}
+	}
+}
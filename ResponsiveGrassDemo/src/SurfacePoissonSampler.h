@@ -0,0 +1,62 @@
+/**
+* (c) Klemens Jahrmann
+* klemens.jahrmann@net1220.at
+*/
+
+#ifndef SURFACEPOISSONSAMPLER_H
+#define SURFACEPOISSONSAMPLER_H
+
+#include <vector>
+#include "Common.h"
+#include "Geometry.h"
+#include "AliasTable.h"
+#include "Random.h"
+#include "SpatialHash.h"
+
+#define POISSON_CANDIDATES 30
+#define POISSON_MAX_PASSES 4
+
+/**
+*  Poisson-disk sampling on a triangle mesh using Bridson's active list.
+*  Candidates are placed in the annulus [r, 2r] around an active sample by walking along the surface,
+*  crossing into neighboring faces over shared edges. Each face is used as seed once per pass,
+*  so disconnected parts of the mesh are covered as well.
+*/
+class SurfacePoissonSampler
+{
+public:
+	struct Sample
+	{
+		glm::vec3 position;
+		glm::vec3 barycentric;
+		unsigned int face;
+	};
+
+	SurfacePoissonSampler(const std::vector<Geometry::TriangleFace>& faces);
+	~SurfacePoissonSampler();
+
+	/**
+	*  Generates exactly amount samples. The minimum distance starts near minDistance and is
+	*  reduced between passes if the surface cannot hold enough samples. Surplus samples are thinned out randomly.
+	*/
+	void generate(const unsigned int amount, const float minDistance, const RandomStream& rng, std::vector<Sample>& samples) const;
+
+private:
+	struct FaceFrame
+	{
+		glm::vec3 edge0, edge1;
+		float d00, d01, d11, invDenom;
+		int neighbor[3]; //Neighbor across the edge opposite to vertex i, -1 for a boundary edge
+	};
+
+	const std::vector<Geometry::TriangleFace>& faces;
+	std::vector<FaceFrame> frames;
+	AliasTable faceSampler;
+
+	void buildAdjacency();
+	glm::vec3 barycentric(const unsigned int face, const glm::vec3& position) const;
+	bool walk(unsigned int& face, glm::vec3& position, glm::vec3 direction, float length) const;
+	unsigned int bridson(const float radius, const RandomStream& rng, const unsigned int pass, std::vector<Sample>& samples) const;
+};
+
+#endif
@@ -8,7 +8,7 @@
 
 float WindGenerator::maxMagnitude = 8.0f;
 
-WindGenerator::WindGenerator(const float _minFrequencyDir, const float _maxFrequencyDir, const float _minFrequencyMag, const float _maxFrequencyMag) : maxFrequencyDir(_maxFrequencyDir), minFrequencyDir(_minFrequencyDir), frequencyDir(0), shiftPeriodDir(0), maxFrequencyMag(_maxFrequencyMag), minFrequencyMag(_minFrequencyMag), frequencyMag(0), shiftPeriodMag(0), newDir(1.0f, 0.0f, 0.0f), newPos(0.0f), magnitude(0.5f), newMagnitude(0.5f), wave(0.0f), type(WindType::VECTOR), parentObject(0), parentObjectOffset(0.0f)
+WindGenerator::WindGenerator(const float _minFrequencyDir, const float _maxFrequencyDir, const float _minFrequencyMag, const float _maxFrequencyMag, const unsigned long long seed) : maxFrequencyDir(_maxFrequencyDir), minFrequencyDir(_minFrequencyDir), frequencyDir(0), shiftPeriodDir(0), maxFrequencyMag(_maxFrequencyMag), minFrequencyMag(_minFrequencyMag), frequencyMag(0), shiftPeriodMag(0), newDir(1.0f, 0.0f, 0.0f), newPos(0.0f), magnitude(0.5f), newMagnitude(0.5f), wave(0.0f), type(WindType::VECTOR), parentObject(0), parentObjectOffset(0.0f), rng(seed, 0), dirEvent(0), magEvent(0)
 {
 
 }
@@ -30,17 +30,19 @@ void WindGenerator::update(const double dt)
 		if (shiftPeriodDir >= frequencyDir)
 		{
 			shiftPeriodDir = 0;
-			frequencyDir = minFrequencyDir + random() * (maxFrequencyDir - minFrequencyDir);
-			float phi = random() * PI_F * 2.0f;
-			newDir = glm::normalize(glm::vec3(glm::sin(phi), random() - 0.5f, glm::cos(phi)));
+			glm::vec4 rnd = rng.uniform4(dirEvent++, 0);
+			frequencyDir = minFrequencyDir + rnd.x * (maxFrequencyDir - minFrequencyDir);
+			float phi = rnd.y * PI_F * 2.0f;
+			newDir = glm::normalize(glm::vec3(glm::sin(phi), rnd.z - 0.5f, glm::cos(phi)));
 			wind = newDir * newMagnitude;
 		}
 
 		if (shiftPeriodMag >= frequencyMag)
 		{
 			shiftPeriodMag = 0;
-			frequencyMag = minFrequencyMag + random() * (maxFrequencyMag - minFrequencyMag);
-			newMagnitude = random() * maxMagnitude;
+			glm::vec4 rnd = rng.uniform4(magEvent++, 1);
+			frequencyMag = minFrequencyMag + rnd.x * (maxFrequencyMag - minFrequencyMag);
+			newMagnitude = rnd.y * maxMagnitude;
 			wind = newDir * newMagnitude;
 		}
 		break;
@@ -8,6 +8,7 @@
 
 #include "Common.h"
 #include "SceneObject.h"
+#include "Random.h"
 
 enum WindType 
 {
@@ -17,7 +18,7 @@ enum WindType
 class WindGenerator
 {
 public:
-	WindGenerator(const float minFrequencyDir, const float maxFrequencyDir, const float minFrequencyMag, const float maxFrequencyMag);
+	WindGenerator(const float minFrequencyDir, const float maxFrequencyDir, const float minFrequencyMag, const float maxFrequencyMag, const unsigned long long seed = 0);
 	~WindGenerator();
 
 	void update(const double dt);
@@ -38,6 +39,9 @@ private:
 	float wave;
 	glm::vec4 windData;
 	WindType type;
+
+	RandomStream rng;
+	unsigned int dirEvent, magEvent;
 };
 
 #endif
\ No newline at end of file
@@ -13,6 +13,8 @@
 
 #include "DemoScene.h"
 #include "OpenGLState.h"
+#include "PartitionBenchmark.h"
+#include "ForceCheck.h"
 
 DemoScene * scene = 0;
 
@@ -157,8 +159,17 @@ void APIENTRY DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severi
 	}
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
+	if (argc > 1 && std::string(argv[1]) == "--partition-benchmark")
+	{
+		return PartitionBenchmark::run(std::vector<std::string>(argv + 2, argv + argc));
+	}
+	if (argc > 1 && std::string(argv[1]) == "--force-check")
+	{
+		return ForceCheck::run(std::vector<std::string>(argv + 2, argv + argc));
+	}
+
 	//glfw
 	GLFWwindow* window;
 	int width, height;